@@ -0,0 +1,346 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btree.h"
+#include "file.h"
+#include "node_search.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+/**
+ * @brief Multi-threaded throughput benchmark for thread-safe indexes.
+ *
+ * Builds an empty INTEGER index, switches it to thread-safe mode and runs the same mix of inserts
+ * and short range scans with 1, 2, 4 and 8 threads. Every thread inserts its own set of keys, so
+ * the index holds every key exactly once at the end and a full scan checks nothing was lost.
+ *
+ * The lookup mode instead builds the same INTEGER index once with the flat and once with the blocked
+ * non-leaf layout and times single-key lookups against each. It then times the search of a single
+ * full non-leaf node of each layout, in more nodes than the CPU caches hold.
+ *
+ * The scan mode writes an INTEGER index to disk and times full scans of it on a cold buffer pool,
+ * alternately with and without read-ahead.
+ *
+ * Usage: badgerdb_bench [operations per thread] [percent of operations that are scans]
+ *        badgerdb_bench lookup [keys] [lookups]
+ *        badgerdb_bench scan [keys] [rounds]
+ */
+
+using namespace badgerdb;
+
+const std::string benchRelationName = "benchRel";
+
+/**
+ * Key for the i-th insert of a thread. Spreads the keys of all threads over the whole key range.
+ */
+static int benchKey(const int thread, const int i)
+{
+	return (int)(((unsigned)(i * 8 + thread) * 2654435761u) & 0x3fffffff);
+}
+
+/**
+ * Runs opsPerThread operations, scanPercent of them reading up to 64 entries from a random key
+ * and the rest inserting the next key of the thread.
+ */
+static void benchWorker(BTreeIndex* index, const int thread, const int opsPerThread, const int scanPercent,
+		long* scanned, long* insertedOut)
+{
+	RecordId buf[64];
+	int inserted = 0;
+	for(int op = 0; op < opsPerThread; op++)
+	{
+		if((op * 37 + thread) % 100 < scanPercent && inserted > 0)
+		{
+			int low = benchKey(thread, op);
+			int high = INT_MAX;
+			try
+			{
+				BTreeScanCursor cursor = index->openScan(&low, GTE, &high, LTE);
+				*scanned += cursor.scanNextBatch(buf, 64);
+			}
+			catch(NoSuchKeyFoundException e)
+			{
+			}
+			continue;
+		}
+		int key = benchKey(thread, inserted);
+		RecordId rid;
+		rid.page_number = (PageId)(thread + 1);
+		rid.slot_number = (SlotId)(inserted % 1000 + 1);
+		index->insertEntry(&key, rid);
+		inserted++;
+	}
+	*insertedOut = inserted;
+}
+
+/**
+ * Runs one round with the given number of threads on a fresh index and prints its throughput.
+ */
+static void benchRound(const int numThreads, const int opsPerThread, const int scanPercent)
+{
+	BufMgr* bufMgr = new BufMgr(2000);
+	try
+	{
+		File::remove(benchRelationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+		PageId pageNum;
+		relation.allocatePage(pageNum);
+	}
+
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+	index->setThreadSafe(true);
+
+	std::vector<long> scanned(numThreads, 0);
+	std::vector<long> inserted(numThreads, 0);
+	std::vector<std::thread> threads;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int t = 0; t < numThreads; t++)
+		threads.push_back(std::thread(benchWorker, index, t, opsPerThread, scanPercent, &scanned[t],
+				&inserted[t]));
+	for(size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	///every insert must be found by a full scan
+	long expected = 0;
+	for(int t = 0; t < numThreads; t++)
+		expected += inserted[t];
+	long found = 0;
+	int low = INT_MIN;
+	int high = INT_MAX;
+	BTreeScanCursor cursor = index->openScan(&low, GTE, &high, LTE);
+	RecordId buf[512];
+	size_t n;
+	while((n = cursor.scanNextBatch(buf, 512)) > 0)
+		found += n;
+	cursor.endScan();
+
+	long total = (long)numThreads * opsPerThread;
+	std::cout << numThreads << " thread(s): " << (long)(total / seconds) << " ops/sec, "
+		<< found << " of " << expected << " entries found" << std::endl;
+	if(found != expected)
+		exit(1);
+
+	delete index;
+	delete bufMgr;
+	File::remove(indexName);
+	File::remove(benchRelationName);
+}
+
+/**
+ * Builds an index of the even keys below 2 * numKeys with the given non-leaf layout, looks up
+ * numLookups keys spread over the whole range, half of them missing, and prints the lookup rate.
+ */
+static void lookupRound(const bool blockedNonLeaves, const int numKeys, const int numLookups)
+{
+	///room for every node, so the lookups time node searches rather than page reads
+	BufMgr* bufMgr = new BufMgr(numKeys / 200 + 1000);
+	try
+	{
+		File::remove(benchRelationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+		PageId pageNum;
+		relation.allocatePage(pageNum);
+	}
+
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, BULKLOAD_FILL_FACTOR, 0,
+			false, blockedNonLeaves);
+	std::vector<int> keys(numKeys);
+	std::vector<KeyRidPair> pairs(numKeys);
+	for(int i = 0; i < numKeys; i++)
+	{
+		keys[i] = 2 * i;
+		pairs[i].key = &keys[i];
+		pairs[i].rid.page_number = (PageId)(i / 1000 + 1);
+		pairs[i].rid.slot_number = (SlotId)(i % 1000 + 1);
+	}
+	index->insertEntries(&pairs[0], pairs.size());
+
+	long found = 0;
+	RecordId rid;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++)
+	{
+		int key = (int)(((unsigned)i * 2654435761u) % (unsigned)(2 * numKeys));
+		found += index->lookup(&key, &rid, 1);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << (blockedNonLeaves ? "blocked" : "flat") << " non-leaf nodes: " << (long)(numLookups / seconds)
+		<< " lookups/sec, " << found << " of " << numLookups << " keys found" << std::endl;
+
+	delete index;
+	delete bufMgr;
+	File::remove(indexName);
+	File::remove(benchRelationName);
+}
+
+/**
+ * Searches numSearches random keys, each in a random one of numNodes full INTEGER non-leaf key arrays,
+ * once with and once without their block directories, and prints both search rates.
+ */
+static void nodeSearchRound(const int numNodes, const int numSearches)
+{
+	const int keyCount = INTBLOCKEDNONLEAFSIZE;
+	std::vector<int> nodes((size_t)numNodes * INTARRAYNONLEAFSIZE);
+	for(int n = 0; n < numNodes; n++)
+	{
+		int* keys = &nodes[(size_t)n * INTARRAYNONLEAFSIZE];
+		for(int i = 0; i < keyCount; i++)
+			keys[i] = 2 * i;
+		nodesearch::buildDirectory(keys, keyCount, nonLeafBlockKeys<int>(), keys + keyCount);
+	}
+
+	for(int blocked = 0; blocked < 2; blocked++)
+	{
+		long sum = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numSearches; i++)
+		{
+			unsigned r = (unsigned)i * 2654435761u;
+			const int* keys = &nodes[(size_t)(r % (unsigned)numNodes) * INTARRAYNONLEAFSIZE];
+			int key = (int)((r >> 7) % (unsigned)(2 * keyCount));
+			sum += blocked ? nodesearch::blockedLowerBound(keys, keyCount, keys + keyCount, nonLeafBlockKeys<int>(), key)
+			               : nodesearch::lowerBound(keys, keyCount, key);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << (blocked ? "blocked" : "flat") << " node search: " << (long)(numSearches / seconds)
+			<< " searches/sec (checksum " << sum << ")" << std::endl;
+	}
+}
+
+/**
+ * Builds an index of numKeys INTEGER keys and writes it out. Returns the name of the index file.
+ */
+static std::string buildScanIndex(const int numKeys)
+{
+	BufMgr* bufMgr = new BufMgr(numKeys / 200 + 1000);
+	try
+	{
+		File::remove(benchRelationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+		PageId pageNum;
+		relation.allocatePage(pageNum);
+	}
+
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+	std::vector<int> keys(numKeys);
+	std::vector<KeyRidPair> pairs(numKeys);
+	for(int i = 0; i < numKeys; i++)
+	{
+		keys[i] = i;
+		pairs[i].key = &keys[i];
+		pairs[i].rid.page_number = (PageId)(i / 1000 + 1);
+		pairs[i].rid.slot_number = (SlotId)(i % 1000 + 1);
+	}
+	index->insertEntries(&pairs[0], pairs.size());
+	delete index;
+	delete bufMgr;
+	return indexName;
+}
+
+/**
+ * Opens the index written by buildScanIndex with an empty buffer pool, scans every entry and prints
+ * the wall-clock time of the scan.
+ */
+static double coldScan(const int numKeys, const int readAheadPages)
+{
+	BufMgr* bufMgr = new BufMgr(numKeys / 200 + 1000);
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+	index->setReadAhead(readAheadPages);
+
+	long found = 0;
+	int low = INT_MIN;
+	int high = INT_MAX;
+	RecordId buf[512];
+	size_t n;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BTreeScanCursor cursor = index->openScan(&low, GTE, &high, LTE);
+	while((n = cursor.scanNextBatch(buf, 512)) > 0)
+		found += n;
+	cursor.endScan();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "read-ahead " << readAheadPages << ": " << seconds * 1000 << " ms, " << found << " entries"
+		<< std::endl;
+	if(found != numKeys)
+		exit(1);
+
+	delete index;
+	delete bufMgr;
+	return seconds;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1 && std::string(argv[1]) == "scan")
+	{
+		int numKeys = argc > 2 ? atoi(argv[2]) : 2000000;
+		int rounds = argc > 3 ? atoi(argv[3]) : 3;
+		std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+		std::cout << numKeys << " keys, cold buffer pool" << std::endl;
+		std::string indexName = buildScanIndex(numKeys);
+		double with = 0, without = 0;
+		for(int r = 0; r < rounds; r++)
+		{
+			without += coldScan(numKeys, 0);
+			with += coldScan(numKeys, READ_AHEAD_MAX_PAGES);
+		}
+		std::cout << "mean: " << without * 1000 / rounds << " ms without read-ahead, " << with * 1000 / rounds
+			<< " ms with" << std::endl;
+		File::remove(indexName);
+		File::remove(benchRelationName);
+		return 0;
+	}
+
+	if(argc > 1 && std::string(argv[1]) == "lookup")
+	{
+		int numKeys = argc > 2 ? atoi(argv[2]) : 1000000;
+		int numLookups = argc > 3 ? atoi(argv[3]) : 2000000;
+		std::cout << numKeys << " keys, " << numLookups << " lookups" << std::endl;
+		lookupRound(false, numKeys, numLookups);
+		lookupRound(true, numKeys, numLookups);
+		nodeSearchRound(20000, numLookups);
+		return 0;
+	}
+
+	int opsPerThread = argc > 1 ? atoi(argv[1]) : 200000;
+	int scanPercent = argc > 2 ? atoi(argv[2]) : 10;
+
+	std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << opsPerThread << " operations per thread, " << scanPercent << "% scans" << std::endl;
+	for(int numThreads = 1; numThreads <= 8; numThreads *= 2)
+		benchRound(numThreads, opsPerThread, scanPercent);
+
+	return 0;
+}
@@ -5,13 +5,27 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <numeric>
+#include <utility>
+
 #include "btree.h"
 #include "filescan.h"
+#include "node_search.h"
+#include "string_node.h"
+#include "read_ahead.h"
+#include "node_latch.h"
+#include "posting_list.h"
+#include "packed_leaf.h"
+#include "composite_key.h"
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
@@ -27,25 +41,93 @@ namespace badgerdb
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
 
+///whether an index file was built over the columns of keyColumns, none for an index on one attribute
+static bool sameColumns(const IndexMetaInfo* metaInfo, const std::vector<KeyColumn>& keyColumns)
+{
+    if(metaInfo->keyColumnCount != (int)keyColumns.size()) return false;
+    for(size_t c = 0; c < keyColumns.size(); c++){
+        if(metaInfo->keyColumns[c].offset != keyColumns[c].offset || metaInfo->keyColumns[c].type != keyColumns[c].type) return false;
+    }
+    return true;
+}
+
 BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const double fillFactor,
+		const int postingMinDuplicates,
+		const bool packedLeaves,
+		const bool blockedNonLeaves)
+{
+    openIndex(relationName, outIndexName, bufMgrIn, attrByteOffset, attrType, fillFactor, postingMinDuplicates, packedLeaves, blockedNonLeaves);
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<KeyColumn>& keyColumns,
+		const double fillFactor)
 {
-    scanExecuting = true;
+    if(!compositekey::validColumns(keyColumns.data(), (int)keyColumns.size())){
+        throw BadIndexInfoException("The key columns do not make up a composite key");
+    }
+    this->keyColumns = keyColumns;
+    openIndex(relationName, outIndexName, bufMgrIn, keyColumns[0].offset, STRING, fillFactor, 0, false, false);
+}
 
+void BTreeIndex::openIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const double fillFactor,
+		const int postingMinDuplicates,
+		const bool packedLeaves,
+		const bool blockedNonLeaves)
+{
     this->attrByteOffset = attrByteOffset;
     this->attributeType = attrType;
+    this->fillFactor = fillFactor;
+    this->postingMinDuplicates = std::max(postingMinDuplicates, 0);
+    this->packedLeaves = packedLeaves && attrType == INTEGER;
+    this->blockedNonLeaves = blockedNonLeaves && attrType != STRING;
+    lowWaterFill = DELETE_LOW_WATER_FILL;
+    freePageNum = 0;
+    readAheadPages = READ_AHEAD_MAX_PAGES;
+    readAhead = NULL;
+    threadSafe = false;
+    writeBufferMessages = 0;
+    nodeLatches = NULL;
+    activeWriters = 0;
+    upperCachePages = UPPER_CACHE_MAX_PAGES;
+    upperCache.resize(upperCachePages);
+    upperCacheSize = 0;
+    upperCacheStale = false;
 
-    ///Description indicates that only Integer Datatypes will be used
-    leafOccupancy = INTARRAYLEAFSIZE;
-    nodeOccupancy = INTARRAYNONLEAFSIZE;
+    ///node capacities depend on the width of the key. STRING nodes hold at least this many
+    if(attrType == DOUBLE){
+        leafOccupancy = DOUBLEARRAYLEAFSIZE;
+        nodeOccupancy = this->blockedNonLeaves ? DOUBLEBLOCKEDNONLEAFSIZE : DOUBLEARRAYNONLEAFSIZE;
+    }else if(attrType == STRING){
+        leafOccupancy = stringnode::leafCapacity(STRINGSIZE);
+        nodeOccupancy = stringnode::nonLeafCapacity(STRINGSIZE);
+    }else{
+        leafOccupancy = INTARRAYLEAFSIZE;
+        nodeOccupancy = this->blockedNonLeaves ? INTBLOCKEDNONLEAFSIZE : INTARRAYNONLEAFSIZE;
+    }
     ///define bufMgr for Btree
     bufMgr = bufMgrIn;
     
     std::ostringstream idxStr;
-    idxStr << relationName << '.' << attrByteOffset;
+    if(keyColumns.empty()){
+        idxStr << relationName << '.' << attrByteOffset;
+    }else{
+        ///a composite index is named after all of its columns, so it never takes the file of an index on its first one
+        idxStr << relationName << ".key";
+        for(size_t c = 0; c < keyColumns.size(); c++) idxStr << '.' << keyColumns[c].offset;
+    }
     std::string indexName = idxStr.str();
     outIndexName = indexName;
     ///instance of IndexMeta
@@ -61,470 +143,4017 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
         file = new BlobFile(indexName, true);
         ///file didn't exist and it now needs to be created.
         
-        ///write the constructor arguments into IndexMetaInfo, then write to file.
-        
-        ///allocate space for Meta Info page
+        ///allocate space for Meta Info page and the root, which becomes the first leaf of the bulk load
         bufMgr->allocPage(file, headerPageNum, metaHeaderPage);
         bufMgr->allocPage(file, rPageNum, rootPage);
-        
-        metaInfo = (IndexMetaInfo*)metaHeaderPage;
-        
         rootPageNum = rPageNum;
+        unPinNode(rootPageNum, true);
         
-        metaInfo->rootPageNo = rPageNum;
+        ///write the constructor arguments into IndexMetaInfo
+        metaInfo = (IndexMetaInfo*)metaHeaderPage;
+        strncpy(metaInfo->relationName, relationName.c_str(), sizeof(metaInfo->relationName) - 1);
         metaInfo->attrByteOffset = attrByteOffset;
         metaInfo->attrType = attrType;
-        strcpy((char*)&(metaInfo->relationName), (const char*)&relationName);
-        std::cout << metaInfo->relationName << " " << relationName.c_str() << std::endl;
-        
-        ///Insert the entries related to the relation into the index file.
-        FileScan fScan = FileScan(relationName, bufMgr);
-        LeafNodeInt *rootNode;
-        rootNode = (LeafNodeInt*)rootPage;
-        ///Initialize rootNode as nonLeafNodeInt, set all pages to 0
-        
-        
-        metaInfo->isRootALeaf = true;
-        isRootALeaf = true;
+        metaInfo->formatVersion = INDEX_FORMAT_VERSION;
+        metaInfo->freePageNo = 0;
+        metaInfo->packedLeaves = this->packedLeaves;
+        metaInfo->blockedNonLeaves = this->blockedNonLeaves;
+        metaInfo->keyColumnCount = (int)keyColumns.size();
+        std::copy(keyColumns.begin(), keyColumns.end(), metaInfo->keyColumns);
         bufMgr->unPinPage(file, headerPageNum, true);
-        bufMgr->unPinPage(file, rootPageNum, true);
-        
-        ///read all records through filescan->scanNext, prepare entry, call insertEntry
-        RecordId tmpRec;
-        std::string tmpStr;
-        int* key;
         
-        try{
-            int tracker = 0;
-            while(1){
-                std::cout << tracker << std::endl;
-                tracker++;
-                fScan.scanNext(tmpRec);
-                tmpStr = fScan.getRecord();
-                key = (int*)&tmpStr + attrByteOffset;
-                insertEntry(key, tmpRec);
-            }
-            
-        }catch(EndOfFileException e){
-    
-            std::cout << "Finished creating index file" << std::endl;
-            
+        ///read all records through filescan->scanNext and bulk load their keys
+        switch(attributeType){
+        case INTEGER: loadRelation<int>(relationName); break;
+        case DOUBLE: loadRelation<double>(relationName); break;
+        case STRING: loadRelation<StringKey>(relationName); break;
         }
+        
+        ///root is only known once the upper levels are built, record it in the meta page
+        setRoot(rootPageNum, isRootALeaf);
+        
+        ///the new root was cached by setRoot, it is cached again below once the file is flushed
+        releaseUpperCache();
         bufMgr->flushFile(file);
-        //fScan.~FileScan();
     }catch(FileExistsException e){ ///file already exists. Check meta file and load entries
         
         file = new BlobFile(indexName, false);
         
         ///read the first page of the file. This will conatin the IndexMetaInfo
-        bufMgr->readPage(file, 1, metaHeaderPage);
+        bufMgr->readPage(file, headerPageNum, metaHeaderPage);
         
         metaInfo = (IndexMetaInfo*)metaHeaderPage;
-        std::cout << metaInfo->relationName << " " << relationName << std::endl;
-        ///Datatype will always be int. Check attrByteOffset and relation name to make sure this is the correct index
-        if(strcmp((char *)&(metaInfo->relationName),(const char *)&relationName) != 0){
+        ///node layout differs between format versions, older files have to be rebuilt
+        if(metaInfo->formatVersion != INDEX_FORMAT_VERSION){
+            bufMgr->unPinPage(file, headerPageNum, false);
+            bufMgr->flushFile(file);
+            delete file;
+            throw BadIndexInfoException("The indexFile was written with an unsupported format version, rebuild the index");
+        }
+        ///check relation name, attrByteOffset and type to make sure this is the correct index
+        if(strcmp(metaInfo->relationName, relationName.c_str()) != 0
+           || metaInfo->attrByteOffset != attrByteOffset
+           || metaInfo->attrType != attrType
+           || !sameColumns(metaInfo, keyColumns)){
+            bufMgr->unPinPage(file, headerPageNum, false);
+            bufMgr->flushFile(file);
+            delete file;
             throw BadIndexInfoException("The Relation in the indexFile is not the same as the tree");
         }
         rootPageNum = metaInfo->rootPageNo;
         isRootALeaf = metaInfo->isRootALeaf;
-        bufMgr->unPinPage(file, 1, false);
+        freePageNum = metaInfo->freePageNo;
+        this->packedLeaves = metaInfo->packedLeaves;
+        ///the nodes already in the file decide the layout, and with it how many keys a non-leaf takes
+        if(metaInfo->blockedNonLeaves != this->blockedNonLeaves){
+            this->blockedNonLeaves = metaInfo->blockedNonLeaves;
+            if(attrType == DOUBLE){
+                nodeOccupancy = this->blockedNonLeaves ? DOUBLEBLOCKEDNONLEAFSIZE : DOUBLEARRAYNONLEAFSIZE;
+            }else{
+                nodeOccupancy = this->blockedNonLeaves ? INTBLOCKEDNONLEAFSIZE : INTARRAYNONLEAFSIZE;
+            }
+        }
+        bufMgr->unPinPage(file, headerPageNum, false);
     }
-
+    
+    refreshUpperCache();
 }
 
-
 // -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
+// Key conversion
 // -----------------------------------------------------------------------------
 
-BTreeIndex::~BTreeIndex()
-{ ///call destructor of blobfile and flush the indexfile from buffer
-    
-    file->~File();
-}
-
-///newNodeInfo will contain the pageId and key, level will indicate whether or not the new root node is just above the leafs
-void BTreeIndex::rootSplit(PageKeyPair<int> newNodeInfo, int level)
+///key of type T at attrByteOffset of a record. The attribute need not be aligned inside the record.
+///Composite indexes are STRING indexes, so only StringKey looks at keyColumns
+template <class T>
+static void recordKey(const std::string& record, int attrByteOffset, const std::vector<KeyColumn>&, T& key)
 {
- 
-    PageId newPageNum;
-    Page * tmpPage;
-    bufMgr->allocPage(file, newPageNum, tmpPage);
-    
-    NonLeafNodeInt* newRootNode = (NonLeafNodeInt*)tmpPage;
-    newRootNode->level = level;
-    
-    ///set NonLeafNode info for RootNode
-    newRootNode->keyArray[0] = newNodeInfo.key;
-    ///left of key is the root, right is the newNode
-    newRootNode->pageNoArray[0] = rootPageNum;
-    newRootNode->pageNoArray[1] = newNodeInfo.pageNo;
-    
-    ///update rootPageNum
-    rootPageNum = newNodeInfo.pageNo;
-    
-    ///read and update MetaPage
-    Page* tmpMetaPage;
-    bufMgr->readPage(file, 1, tmpMetaPage);
-    IndexMetaInfo* metaInfo = (IndexMetaInfo*)tmpMetaPage;
-    
-    metaInfo->rootPageNo = rootPageNum;
-    metaInfo->isRootALeaf = false;
-    bufMgr->unPinPage(file, newPageNum, true);
-    
+    memcpy(&key, record.c_str() + attrByteOffset, sizeof(T));
 }
-    
-void BTreeIndex::nonLeafSplit(NonLeafNodeInt* nonLeafNode, PageKeyPair<int>& newNonLeafPage, PageKeyPair<int> pageEntry)
+
+static void recordKey(const std::string& record, int attrByteOffset, const std::vector<KeyColumn>& keyColumns, StringKey& key)
 {
-    ///create a new nonLeafNode, reassign half the values to the new node, pass the middle key/pageNo combo back up
-    PageId newPageNum;
-    Page * tmpPage;
-    bufMgr->allocPage(file, newPageNum, tmpPage);
-    
-    NonLeafNodeInt* newNonLeafNode = (NonLeafNodeInt*)tmpPage;
-    int i;
-    for(i = 0; i < nodeOccupancy/2; i++){
-        newNonLeafNode->keyArray[i] = nonLeafNode->keyArray[nodeOccupancy/2 + i];
-        nonLeafNode->keyArray[nodeOccupancy/2 + i] = 0;
-        newNonLeafNode->pageNoArray[i] = nonLeafNode->pageNoArray[nodeOccupancy/2 + i];
-        nonLeafNode->pageNoArray[nodeOccupancy/2 + i] = 0;
+    if(keyColumns.empty()){
+        key.set(record.c_str() + attrByteOffset, record.size() - attrByteOffset);
+        return;
     }
-    ///since pageNoArray is one large, manually change the last values
-    newNonLeafNode->pageNoArray[nodeOccupancy/2] = nonLeafNode->pageNoArray[nodeOccupancy];
-    nonLeafNode->pageNoArray[nodeOccupancy] = 0;
-    
-    if(nonLeafNode->keyArray[nodeOccupancy/2 - 1] > pageEntry.key){
-        nonLeafInsert(nonLeafNode, pageEntry);
-    }else nonLeafInsert(newNonLeafNode, pageEntry);
-    
-    newNonLeafPage.set(newPageNum, newNonLeafNode->keyArray[0]);
-    bufMgr->unPinPage(file, newPageNum, true);
-    
+    char encoded[STRINGSIZE + 1];
+    compositekey::encodeRecord(keyColumns.data(), (int)keyColumns.size(), record.c_str(), record.size(), encoded);
+    key.set(encoded);
 }
-    
-void BTreeIndex::leafSplit(LeafNodeInt* leafNode, PageKeyPair<int>& newLeafPage, RIDKeyPair<int> dataEntry)
-{
-    ///create a new nonLeafNode, reassign half the values to the new node, pass the middle key/pageNo combo back up
-    PageId newPageNum;
-    Page * tmpPage;
-    bufMgr->allocPage(file, newPageNum, tmpPage);
-    
-    LeafNodeInt* newLeafNode = (LeafNodeInt*)tmpPage;
-    int i;
-    for(i = 0; i < leafOccupancy/2; i++){
-        newLeafNode->keyArray[i] = leafNode->keyArray[leafOccupancy/2 + i];
-        leafNode->keyArray[leafOccupancy/2 + i] = 0;
-        newLeafNode->ridArray[i] = leafNode->ridArray[leafOccupancy/2 + i];
-        leafNode->ridArray[leafOccupancy/2 + i].page_number = 0;
-    }
 
-    newLeafNode->rightSibPageNo = leafNode->rightSibPageNo;
-    leafNode->rightSibPageNo = newPageNum;
-    
-    if(leafNode->keyArray[nodeOccupancy/2 - 1] > dataEntry.key){
-        leafInsert(leafNode, dataEntry);
-    }else leafInsert(newLeafNode, dataEntry);
-    
-    newLeafPage.set(newPageNum, newLeafNode->keyArray[0]);
-    bufMgr->unPinPage(file, newPageNum, true);
-    
+///key of type T from the pointer passed to insertEntry, insertEntries or startScan
+template <class T>
+static T keyFromPointer(const void* key)
+{
+    return *(const T*)key;
 }
-    
-    
-// -----------------------------------------------------------------------------
-// leafInsert
-// -----------------------------------------------------------------------------
-    
 
-    
-void BTreeIndex::leafInsert(LeafNodeInt * leafNode, RIDKeyPair<int> dataEntry)
+template <>
+StringKey keyFromPointer<StringKey>(const void* key)
 {
-    
-    ///traverse leafNode for insert index, stop at first key that is greater than insert key
-    int i;
-    for(int i = 0; i < leafOccupancy && leafNode->ridArray[i].page_number != 0; i++){
-        
-        if(dataEntry.key < leafNode->keyArray[i])break; ///found insert location
-        
-    }
-    
-    ///shift all entries one to the right. Work from right to left to avoid overwriting entries
-    int n;
-    for(n = leafOccupancy - 1; n > i; n--){
-        ///set [n-1] to [n]
-        
-        leafNode->keyArray[n] = leafNode->keyArray[n-1];
-        leafNode->ridArray[n] = leafNode->ridArray[n-1];
-    }
-    
-    leafNode->keyArray[i] = dataEntry.key;
-    leafNode->ridArray[i] = dataEntry.rid;
-    
+    StringKey stringKey;
+    stringKey.set((const char*)key);
+    return stringKey;
 }
-    
-void BTreeIndex::nonLeafInsert(NonLeafNodeInt * nonLeafNode, PageKeyPair<int> pageEntry)
-{
-    ///node has been split and we need to now insert the pageEntry
-    
-    int i;
-    for(int i = 0; i < nodeOccupancy && nonLeafNode->pageNoArray[i] != 0; i++){
-        
-        if(pageEntry.key < nonLeafNode->keyArray[i] )break; ///found insert location
-    }
-    
-    ///shift all entries one to the right
-    int n;
-    for(n = nodeOccupancy -1; n > i; n--){
-        nonLeafNode->keyArray[n] = nonLeafNode->keyArray[n-1];
-        nonLeafNode->pageNoArray[n+1] = nonLeafNode->pageNoArray[n];
-    }
-
-    nonLeafNode->keyArray[i] = pageEntry.key;
-    nonLeafNode->pageNoArray[i+1] = pageEntry.pageNo;
-
 
+///write a key where minKey or maxKey were told to. STRING keys are written null-terminated
+template <class T>
+static void keyToPointer(const T& key, void* out)
+{
+    memcpy(out, &key, sizeof(T));
 }
-        
-    
-void BTreeIndex::rootLeafInsert(LeafNodeInt * rootNode, RIDKeyPair<int> dataEntry, bool split)
+
+template <>
+void keyToPointer<StringKey>(const StringKey& key, void* out)
 {
-    
-    if(!split){ ///don't need to split, treat like any other leaf
-        leafInsert(rootNode, dataEntry);
-    }else{
-        ///split the node and make a new root node to take its place
-        
-        PageKeyPair<int> newRootPage;
-        
-        leafSplit(rootNode, newRootPage, dataEntry);
-        PageId curRootPage = rootPageNum;
-        
-        rootSplit(newRootPage, 1);
-        bufMgr->unPinPage(file, curRootPage, true);
-    }
-        
+    memcpy(out, key.bytes, STRINGSIZE);
+    ((char*)out)[STRINGSIZE] = '\0';
 }
-    
-// -----------------------------------------------------------------------------
-// FindLeaf
-// Arguments:  RIDKeypair to be inserted, current page number, and Placeholder PageKeyPair entry as overflow tracker
-// -----------------------------------------------------------------------------
-///Recursively visit each node on the way down to the leaf node that contains the correct location for the key. Start at root
-///Base Case, the next node is a leaf node and the insertion can be attempted.
-void BTreeIndex::findandInsert(RIDKeyPair<int> dataEntry, PageId curPageNum, PageKeyPair<int>& splitEntry)
+
+///keys below and above every key of type T. Descents for them follow the leftmost or rightmost path
+template <class T>
+static T lowestKey()
 {
-    ///read current page from bufferManager
-    Page* tmpPage;
-    bufMgr->readPage(file, curPageNum, tmpPage);
-    
-    ///this will always be a nonLeaf page
-    NonLeafNodeInt* curPage = (NonLeafNodeInt*)tmpPage;
-    
-    ///find dataEntry's key position relative to curPage keyArray
-    int i;
-    PageId nextPageNum;
-    for(i = 0; i < nodeOccupancy && curPage->pageNoArray[i] != 0; i++){
-        
-        if(dataEntry.key < curPage->keyArray[i]){
-            break;
-        }
-        
-    }
-    
-    nextPageNum = curPage->pageNoArray[i];
-    
-    if(curPage->level == 1){ ///directly above leaf. Next page is leafNode
-        Page* nextPage;
-        
-        bufMgr->readPage(file, nextPageNum, nextPage);
-        
-        LeafNodeInt * leafNode = (LeafNodeInt*)nextPage;
-        
-        if(leafNode->ridArray[leafOccupancy-1].page_number != 0){///will need to split
-            
-            PageKeyPair<int> newLeafPage;
-            leafSplit(leafNode, newLeafPage, dataEntry);
-            
-            ///can the new key fit on currpage, if not split again.
-            if(curPage->pageNoArray[nodeOccupancy] != 0){
-                PageKeyPair<int> newNonLeafPage;
-                nonLeafSplit(curPage, newNonLeafPage, newLeafPage);
-                splitEntry = newNonLeafPage;
-            }else nonLeafInsert(curPage, newLeafPage);
-            
-        }else{///can be inserted no problem.
-            leafInsert(leafNode, dataEntry);
-        }
-        ///clear bufMgr of pinned files
-        bufMgr->unPinPage(file, curPageNum, true);
-        bufMgr->unPinPage(file, nextPageNum, true);
-        return;
-    }
-    
-    ///not low enough yer, traverse to next node
-    PageKeyPair<int> newSplitPage;
-    newSplitPage.set(0,0);
-    bufMgr->unPinPage(file, curPageNum, false);
-    
-    ///call the next level of search
-    findandInsert(dataEntry, nextPageNum, newSplitPage);
-    
-    ///on the way back up, check to see if newSplitPage has been modified, if so insert
-    if(newSplitPage.pageNo != 0) {
-        PageKeyPair<int> nonLeafPage;
-        nonLeafPage.set(newSplitPage.pageNo, newSplitPage.key);
-       if(curPage->pageNoArray[nodeOccupancy] != 0){
-           PageKeyPair<int> newNonLeafPage;
-           nonLeafSplit(curPage, newNonLeafPage, nonLeafPage);
-           splitEntry = newNonLeafPage;
-       }else nonLeafInsert(curPage, nonLeafPage);
-        
-    }
+    return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
 }
-    
-    
-    
-// -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
-// -----------------------------------------------------------------------------
 
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+template <class T>
+static T highestKey()
 {
-    Page* tmpPage;
-    bufMgr->readPage(file, rootPageNum, tmpPage);
-    
-    RIDKeyPair<int> dataEntry;
-    dataEntry.set(rid, *(int*)key);
-    
-    ///if root is a leaf, then manually insert until it needs to split
-    if(isRootALeaf){
-        
-        LeafNodeInt * rootLeaf = (LeafNodeInt*)tmpPage;
-        ///check to see if last key/page pair is taken
-        if(rootLeaf->ridArray[leafOccupancy - 1].page_number != 0){
-            ///full and needs to split
-            isRootALeaf = false;
-            rootLeafInsert(rootLeaf, dataEntry, true);
-            
-        }else{
-            rootLeafInsert(rootLeaf, dataEntry, false);
-        }
-        
-    }else{
-        ///set up call to FindLeaf, let it handle the insert.
-        ///pass in root page number, dataEntry, and PageKeyPair entry
-        
-        PageKeyPair<int> splitEntry;
-        ///set page number to zero as this will mark whether a page is allocated
-        splitEntry.set(0, *(int*)key);
-        
-        findandInsert(dataEntry, rootPageNum, splitEntry);
-        
-        ///if splitEntry has a valid page, that means root needs to split
-        
-    }
-    
+    return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::startScan
-// -----------------------------------------------------------------------------
+template <>
+StringKey lowestKey<StringKey>()
+{
+    StringKey key;
+    memset(key.bytes, 0, STRINGSIZE);
+    return key;
+}
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+template <>
+StringKey highestKey<StringKey>()
 {
-	// check low and high operators are correct, if not, throw BadOpCodeException error
-	if (lowOpParm != GT && lowOpParm != GTE) {
-        scanExecuting = false;
-		throw BadOpcodesException();
-	}
-    else if (highOpParm != LT && highOpParm != LTE) {
-        scanExecuting = false;
-        throw BadOpcodesException();
-    }
+    StringKey key;
+    memset(key.bytes, 0xff, STRINGSIZE);
+    return key;
+}
 
-	// check value search range is valid, ie low value < high value
-    if (lowValParm > highValParm) {
-        scanExecuting = false;
-        throw BadScanrangeException();
+///position of the child of a non-leaf node to descend to for key. Separators equal to key send the descent left if lower is set
+template <class T>
+static int childIndex(const Page* node, const T& key, bool lower)
+{
+    const NonLeafNode<T>* nonLeafNode = (const NonLeafNode<T>*)node;
+    int count = nonLeafNode->header.keyCount;
+    if(nonLeafNode->header.nodeType == BLOCKED_NONLEAF_NODE){
+        const T* directory = nonLeafNode->keyArray + blockedNonLeafSize<T>();
+        return lower ? nodesearch::blockedLowerBound(nonLeafNode->keyArray, count, directory, nonLeafBlockKeys<T>(), key)
+                     : nodesearch::blockedUpperBound(nonLeafNode->keyArray, count, directory, nonLeafBlockKeys<T>(), key);
     }
+    return lower ? nodesearch::lowerBound(nonLeafNode->keyArray, count, key)
+                 : nodesearch::upperBound(nonLeafNode->keyArray, count, key);
+}
 
-    // If another scan is already executing, that needs to be ended here
-    if (scanExecuting) {
-        endScan();
-    }
-    
+///write the block directory of a blocked non-leaf node again once its keys have changed
+template <class T>
+static void updateDirectory(Page* node)
+{
+    NonLeafNode<T>* nonLeafNode = (NonLeafNode<T>*)node;
+    if(nonLeafNode->header.nodeType != BLOCKED_NONLEAF_NODE) return;
+    nodesearch::buildDirectory(nonLeafNode->keyArray, (int)nonLeafNode->header.keyCount, nonLeafBlockKeys<T>(),
+                               nonLeafNode->keyArray + blockedNonLeafSize<T>());
+}
 
-    scanExecuting = true;
-    lowOp = lowOpParm;
-    highOp = highOpParm;
+template <>
+void updateDirectory<StringKey>(Page* node)
+{
+}
 
+template <>
+int childIndex<StringKey>(const Page* node, const StringKey& key, bool lower)
+{
+    const StringNonLeafNode* nonLeafNode = (const StringNonLeafNode*)node;
+    return lower ? stringnode::nonLeafLowerBound(nonLeafNode, key)
+                 : stringnode::nonLeafUpperBound(nonLeafNode, key);
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
-// -----------------------------------------------------------------------------
+///child i of a non-leaf node
+template <class T>
+static PageId childAt(const Page* node, int i)
+{
+    return ((const NonLeafNode<T>*)node)->pageNoArray[i];
+}
 
-void BTreeIndex::scanNext(RecordId& outRid) 
+template <>
+PageId childAt<StringKey>(const Page* node, int i)
 {
-    LeafNodeInt* cnode = 0;
-    int nextPage = 0;
+    return stringnode::child((const StringNonLeafNode*)node, i);
+}
 
-    //check if this is called before a startScan call
-    if(scanExecuting == false){throw ScanNotInitializedException();}
+///child of a non-leaf node to descend to for key
+template <class T>
+static PageId childFor(const Page* node, const T& key, bool lower)
+{
+    return childAt<T>(node, childIndex<T>(node, key, lower));
+}
 
-    //check if page num is 0. throw exception
-    if(currentPageNum == 0){throw IndexScanCompletedException();}
+///entry counts of the subtrees under the children of a non-leaf node
+template <class T>
+static std::uint32_t* childCounts(Page* node)
+{
+    return ((NonLeafNode<T>*)node)->countArray;
+}
 
-    //get node from currentPageData
-    cnode = (LeafNodeInt*)currentPageData;
+template <>
+std::uint32_t* childCounts<StringKey>(Page* node)
+{
+    return stringnode::childCounts((StringNonLeafNode*)node);
+}
 
-    //check if its at the end of a page. throw exception
-    if(cnode->rightSibPageNo == 0){throw IndexScanCompletedException();}
-    nextPage = cnode->ridArray[nextEntry].page_number;
+template <class T>
+static const std::uint32_t* childCounts(const Page* node)
+{
+    return childCounts<T>(const_cast<Page*>(node));
+}
 
-    //chekc if end of page. if yes unpin then read
-    if((nextEntry == INTARRAYLEAFSIZE) || (nextPage == 0)){
+///whether a node is a leaf, in any leaf layout
+static bool isLeafNode(const Page* node)
+{
+    std::int16_t nodeType = ((const NodeHeader*)node)->nodeType;
+    return nodeType == LEAF_NODE || nodeType == PACKED_LEAF_NODE;
+}
 
-        //unpin page
-        bufMgr->unPinPage(file, currentPageNum, false);
+///whether a leaf is a PackedLeafNode. Only INTEGER leaves can be
+static bool packedLeaf(const Page* node)
+{
+    return ((const NodeHeader*)node)->nodeType == PACKED_LEAF_NODE;
+}
 
-        //goto next page. read it.
-        bufMgr->readPage(file,cnode->rightSibPageNo,currentPageData);
-        nextEntry =0;
-    }
+///position in a leaf of the first key not less than key if lower is set, of the first key greater than key otherwise
+template <class T>
+static int leafBound(const Page* node, const T& key, bool lower)
+{
+    const LeafNode<T>* leafNode = (const LeafNode<T>*)node;
+    int count = leafNode->header.keyCount;
+    return lower ? nodesearch::lowerBound(leafNode->keyArray, count, key)
+                 : nodesearch::upperBound(leafNode->keyArray, count, key);
+}
 
-    int k = cnode->keyArray[nextEntry];
-    //now check if key/rid works
-    while(compK(lowValInt,lowOp,highValInt, highOp, k) == false){
-    if(outRid == cnode->ridArray[nextEntry]){
-        //found a match. throw finish exception
-        throw  IndexScanCompletedException();
-    }
-	//try the next one
-	nextEntry++;
-	k=cnode->keyArray[nextEntry];
-	outRid = cnode->ridArray[nextEntry];
+template <>
+int leafBound<int>(const Page* node, const int& key, bool lower)
+{
+    if(packedLeaf(node)){
+        const PackedLeafNode* leafNode = (const PackedLeafNode*)node;
+        return lower ? packedleaf::leafLowerBound(leafNode, key) : packedleaf::leafUpperBound(leafNode, key);
     }
+    const LeafNodeInt* leafNode = (const LeafNodeInt*)node;
+    int count = leafNode->header.keyCount;
+    return lower ? nodesearch::lowerBound(leafNode->keyArray, count, key)
+                 : nodesearch::upperBound(leafNode->keyArray, count, key);
+}
 
+template <>
+int leafBound<StringKey>(const Page* node, const StringKey& key, bool lower)
+{
+    const StringLeafNode* leafNode = (const StringLeafNode*)node;
+    return lower ? stringnode::leafLowerBound(leafNode, key) : stringnode::leafUpperBound(leafNode, key);
 }
 
-bool BTreeIndex::compK(int lowValInt,const Operator lowOp,int highValInt,const Operator highOp, int key){
-    int lVal = (lowValInt);
-    int hVal = (highValInt);
-    bool retVal = false;
-    
-    if(lowOp == GTE){
-        if(highOp == LTE) retVal = (key >= lVal && key <= hVal);
-        else if(highOp == LT) retVal = (key < hVal && key >= lVal);
-    }if(lowOp == GT){
-        if(highOp == LTE) retVal = (key <= hVal && key > lVal);
-        else if(highOp == LT) retVal = (key < hVal && key > lVal);
-    }
-    return retVal;
-    
+///compare key i of a leaf with key, like memcmp
+template <class T>
+static int compareLeafKey(const Page* node, int i, const T& key)
+{
+    const T& leafKey = ((const LeafNode<T>*)node)->keyArray[i];
+    return (leafKey < key) ? -1 : (key < leafKey) ? 1 : 0;
+}
+
+template <>
+int compareLeafKey<int>(const Page* node, int i, const int& key)
+{
+    int leafKey = packedLeaf(node) ? packedleaf::leafKey((const PackedLeafNode*)node, i) : ((const LeafNodeInt*)node)->keyArray[i];
+    return (leafKey < key) ? -1 : (key < leafKey) ? 1 : 0;
+}
+
+template <>
+int compareLeafKey<StringKey>(const Page* node, int i, const StringKey& key)
+{
+    return stringnode::compareLeafKey((const StringLeafNode*)node, i, key.bytes);
+}
+
+///key i of a leaf
+template <class T>
+static T leafKeyAt(const Page* node, int i)
+{
+    return ((const LeafNode<T>*)node)->keyArray[i];
+}
+
+template <>
+int leafKeyAt<int>(const Page* node, int i)
+{
+    return packedLeaf(node) ? packedleaf::leafKey((const PackedLeafNode*)node, i) : ((const LeafNodeInt*)node)->keyArray[i];
+}
+
+template <>
+StringKey leafKeyAt<StringKey>(const Page* node, int i)
+{
+    StringKey key;
+    stringnode::leafKey((const StringLeafNode*)node, i, key);
+    return key;
+}
+
+///record ids of entries [first, last) of a leaf
+template <class T>
+static void leafRids(const Page* node, int first, int last, RecordId* out)
+{
+    const LeafNode<T>* leafNode = (const LeafNode<T>*)node;
+    std::copy(leafNode->ridArray + first, leafNode->ridArray + last, out);
+}
+
+template <>
+void leafRids<int>(const Page* node, int first, int last, RecordId* out)
+{
+    if(packedLeaf(node)){
+        packedleaf::leafRids((const PackedLeafNode*)node, first, last, out);
+        return;
+    }
+    const LeafNodeInt* leafNode = (const LeafNodeInt*)node;
+    std::copy(leafNode->ridArray + first, leafNode->ridArray + last, out);
+}
+
+template <>
+void leafRids<StringKey>(const Page* node, int first, int last, RecordId* out)
+{
+    for(int i = first; i < last; i++) *out++ = stringnode::leafRid((const StringLeafNode*)node, i);
+}
+
+///record id of entry i of a leaf
+template <class T>
+static RecordId leafRidAt(const Page* node, int i)
+{
+    return ((const LeafNode<T>*)node)->ridArray[i];
+}
+
+template <>
+RecordId leafRidAt<int>(const Page* node, int i)
+{
+    return packedLeaf(node) ? packedleaf::leafRid((const PackedLeafNode*)node, i) : ((const LeafNodeInt*)node)->ridArray[i];
+}
+
+template <>
+RecordId leafRidAt<StringKey>(const Page* node, int i)
+{
+    return stringnode::leafRid((const StringLeafNode*)node, i);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex posting lists
+// -----------------------------------------------------------------------------
+
+template <class T>
+std::uint32_t BTreeIndex::subtreeEntries(const Page* node)
+{
+    const NodeHeader* header = (const NodeHeader*)node;
+    if(isLeafNode(node)) return (std::uint32_t)leafEntries<T>(node, 0, header->keyCount);
+    const std::uint32_t* counts = childCounts<T>(node);
+    return std::accumulate(counts, counts + header->keyCount + 1, (std::uint32_t)0);
+}
+
+template <class T>
+size_t BTreeIndex::leafEntries(const Page* leaf, int first, int last)
+{
+    size_t count = std::max(last - first, 0);
+    for(int i = first; i < last; i++){
+        RecordId rid = leafRidAt<T>(leaf, i);
+        if(postinglist::isList(rid)) count += postingSize(rid.page_number) - 1;
+    }
+    return count;
+}
+
+template <>
+size_t BTreeIndex::leafEntries<StringKey>(const Page* leaf, int first, int last)
+{
+    return std::max(last - first, 0);
+}
+
+template <class T>
+size_t BTreeIndex::copyLeafRids(const Page* leaf, int first, int last, RecordId* out, size_t max)
+{
+    std::vector<RecordId> rids;
+    size_t n = 0;
+    for(int i = first; i < last && n < max; i++){
+        RecordId rid = leafRidAt<T>(leaf, i);
+        if(!postinglist::isList(rid)){
+            out[n++] = rid;
+            continue;
+        }
+        PageId pageNum = rid.page_number;
+        while(pageNum != 0 && n < max){
+            pageNum = loadPosting(pageNum, rids);
+            size_t take = std::min(rids.size(), max - n);
+            std::copy(rids.begin(), rids.begin() + take, out + n);
+            n += take;
+        }
+    }
+    return n;
+}
+
+template <>
+size_t BTreeIndex::copyLeafRids<StringKey>(const Page* leaf, int first, int last, RecordId* out, size_t max)
+{
+    size_t n = std::min((size_t)std::max(last - first, 0), max);
+    leafRids<StringKey>(leaf, first, first + (int)n, out);
+    return n;
+}
+
+template <class T>
+bool BTreeIndex::touchesPosting(const Page* leaf, const T& key) const
+{
+    int first = leafBound<T>(leaf, key, true);
+    int last = leafBound<T>(leaf, key, false);
+    for(int i = first; i < last; i++){
+        if(postinglist::isList(leafRidAt<T>(leaf, i))) return true;
+    }
+    return postingMinDuplicates > 0 && last - first + 1 >= postingMinDuplicates;
+}
+
+template <>
+bool BTreeIndex::touchesPosting<StringKey>(const Page* leaf, const StringKey& key) const
+{
+    return false;
+}
+
+template <class T>
+bool BTreeIndex::postingInsert(LeafNode<T>* leafNode, const RIDKeyPair<T>& dataEntry)
+{
+    int count = leafNode->header.keyCount;
+    int first = nodesearch::lowerBound(leafNode->keyArray, count, dataEntry.key);
+    int last = nodesearch::upperBound(leafNode->keyArray, count, dataEntry.key);
+    for(int i = first; i < last; i++){
+        if(!postinglist::isList(leafNode->ridArray[i])) continue;
+        postingAdd(leafNode->ridArray[i].page_number, dataEntry.rid);
+        return true;
+    }
+    if(postingMinDuplicates <= 0 || last - first + 1 < postingMinDuplicates) return false;
+    
+    ///the entries of the key and the new one move to a list, the leaf keeps one entry for all of them
+    std::vector<RecordId> rids(leafNode->ridArray + first, leafNode->ridArray + last);
+    rids.push_back(dataEntry.rid);
+    std::sort(rids.begin(), rids.end(), postinglist::ridLess);
+    leafNode->ridArray[first] = postinglist::listRef(createPosting(rids.data(), rids.size()));
+    std::copy(leafNode->keyArray + last, leafNode->keyArray + count, leafNode->keyArray + first + 1);
+    std::copy(leafNode->ridArray + last, leafNode->ridArray + count, leafNode->ridArray + first + 1);
+    leafNode->header.keyCount = count - (last - first) + 1;
+    return true;
+}
+
+template <class T>
+void BTreeIndex::foldPostings(std::vector<RIDKeyPair<T> >& entries, std::vector<std::uint32_t>& ids)
+{
+    std::vector<RIDKeyPair<T> > folded;
+    std::vector<RecordId> rids;
+    ids.clear();
+    size_t start = 0;
+    while(start < entries.size()){
+        size_t end = start + 1;
+        while(end < entries.size() && entries[end].key == entries[start].key) end++;
+        if(end - start < (size_t)postingMinDuplicates){
+            folded.insert(folded.end(), entries.begin() + start, entries.begin() + end);
+            ids.insert(ids.end(), end - start, 1);
+        }else{
+            rids.clear();
+            for(size_t i = start; i < end; i++) rids.push_back(entries[i].rid);
+            std::sort(rids.begin(), rids.end(), postinglist::ridLess);
+            RIDKeyPair<T> entry;
+            entry.set(postinglist::listRef(createPosting(rids.data(), rids.size())), entries[start].key);
+            folded.push_back(entry);
+            ids.push_back((std::uint32_t)(end - start));
+        }
+        start = end;
+    }
+    entries.swap(folded);
+}
+
+PageId BTreeIndex::createPosting(const RecordId* rids, size_t n)
+{
+    PageId firstPageNum = 0;
+    PageId prevPageNum = 0;
+    PostingNode* prevNode = NULL;
+    size_t next = 0;
+    while(next < n){
+        PageId pageNum;
+        Page* page;
+        allocNode(pageNum, page);
+        PostingNode* node = (PostingNode*)page;
+        next += postinglist::encode(node, rids + next, (int)std::min(n - next, (size_t)INT_MAX));
+        node->nextPageNo = 0;
+        node->totalCount = 0;
+        if(prevNode == NULL){
+            firstPageNum = pageNum;
+            node->totalCount = (std::uint32_t)n;
+        }else{
+            prevNode->nextPageNo = pageNum;
+            unPinNode(prevPageNum, true);
+        }
+        prevPageNum = pageNum;
+        prevNode = node;
+    }
+    unPinNode(prevPageNum, true);
+    return firstPageNum;
+}
+
+void BTreeIndex::postingAdd(PageId firstPageNum, const RecordId& rid)
+{
+    std::vector<RecordId> rids;
+    PageId pageNum = firstPageNum;
+    Page* page;
+    readNode(pageNum, page);
+    ((PostingNode*)page)->totalCount++;
+    
+    ///the id goes to the first page whose last id is not below it, or to the last page
+    while(1){
+        PostingNode* node = (PostingNode*)page;
+        rids.clear();
+        postinglist::decode(node, rids);
+        if(node->nextPageNo == 0 || !postinglist::ridLess(rids.back(), rid)) break;
+        PageId nextPageNum = node->nextPageNo;
+        unPinNode(pageNum, pageNum == firstPageNum);
+        pageNum = nextPageNum;
+        readNode(pageNum, page);
+    }
+    
+    PostingNode* node = (PostingNode*)page;
+    rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, postinglist::ridLess), rid);
+    int n = (int)rids.size();
+    if(postinglist::encode(node, rids.data(), n) < n){
+        ///split the page in two halves, either one fits since the whole page did before the insert
+        PageId newPageNum;
+        Page* newPage;
+        allocNode(newPageNum, newPage);
+        PostingNode* newNode = (PostingNode*)newPage;
+        postinglist::encode(node, rids.data(), n / 2);
+        postinglist::encode(newNode, rids.data() + n / 2, n - n / 2);
+        newNode->totalCount = 0;
+        newNode->nextPageNo = node->nextPageNo;
+        node->nextPageNo = newPageNum;
+        unPinNode(newPageNum, true);
+    }
+    unPinNode(pageNum, true);
+}
+
+bool BTreeIndex::postingRemove(PageId firstPageNum, const RecordId& rid, bool& empty)
+{
+    empty = false;
+    std::vector<RecordId> rids;
+    PageId prevPageNum = 0;
+    PageId pageNum = firstPageNum;
+    while(pageNum != 0){
+        Page* page;
+        readNode(pageNum, page);
+        PostingNode* node = (PostingNode*)page;
+        rids.clear();
+        postinglist::decode(node, rids);
+        std::vector<RecordId>::iterator it = std::lower_bound(rids.begin(), rids.end(), rid, postinglist::ridLess);
+        if(it == rids.end() || !(*it == rid)){
+            PageId nextPageNum = node->nextPageNo;
+            unPinNode(pageNum, false);
+            prevPageNum = pageNum;
+            pageNum = nextPageNum;
+            continue;
+        }
+        
+        rids.erase(it);
+        PageId nextPageNum = node->nextPageNo;
+        if(!rids.empty()){
+            ///merging two gaps never takes more bytes than the two took, so the rest fits again
+            postinglist::encode(node, rids.data(), (int)rids.size());
+            unPinNode(pageNum, true);
+        }else if(pageNum != firstPageNum){
+            freeNode(pageNum, page);
+            Page* prevPage;
+            readNode(prevPageNum, prevPage);
+            ((PostingNode*)prevPage)->nextPageNo = nextPageNum;
+            unPinNode(prevPageNum, true);
+        }else if(nextPageNum != 0){
+            ///the first page keeps the total, so the second page moves into it
+            Page* nextPage;
+            readNode(nextPageNum, nextPage);
+            const PostingNode* nextNode = (const PostingNode*)nextPage;
+            node->header = nextNode->header;
+            node->nextPageNo = nextNode->nextPageNo;
+            node->usedBytes = nextNode->usedBytes;
+            memcpy(node->data, nextNode->data, nextNode->usedBytes);
+            freeNode(nextPageNum, nextPage);
+            unPinNode(pageNum, true);
+        }else{
+            freeNode(pageNum, page);
+            empty = true;
+            return true;
+        }
+        
+        Page* firstPage;
+        readNode(firstPageNum, firstPage);
+        ((PostingNode*)firstPage)->totalCount--;
+        unPinNode(firstPageNum, true);
+        return true;
+    }
+    return false;
+}
+
+std::uint32_t BTreeIndex::postingSize(PageId firstPageNum)
+{
+    Page* page;
+    readNode(firstPageNum, page);
+    const PostingNode* node = (const PostingNode*)page;
+    std::uint32_t count = (node->header.nodeType == POSTING_NODE) ? node->totalCount : 0;
+    unPinNode(firstPageNum, false);
+    return count;
+}
+
+PageId BTreeIndex::loadPosting(PageId pageNum, std::vector<RecordId>& rids)
+{
+    while(1){
+        ///posting lists only change in exclusive operations, a read that overlapped one is done again
+        std::uint64_t treeVersion = threadSafe ? treeLatch.readLock() : 0;
+        Page* page;
+        readNode(pageNum, page);
+        const PostingNode* node = (const PostingNode*)page;
+        rids.clear();
+        PageId nextPageNum = 0;
+        if(node->header.nodeType == POSTING_NODE){
+            postinglist::decode(node, rids);
+            nextPageNum = node->nextPageNo;
+        }
+        unPinNode(pageNum, false);
+        if(!threadSafe || treeLatch.validate(treeVersion)) return nextPageNum;
+    }
+}
+
+void BTreeIndex::setPostingLists(int minDuplicates)
+{
+    postingMinDuplicates = std::max(minDuplicates, 0);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex packed leaves
+// -----------------------------------------------------------------------------
+// Only INTEGER indexes have packed leaves, so only the int versions do anything.
+
+///orders entries by key only. Stable merges with it keep existing entries ahead of equal new ones
+static bool intEntryOrder(const RIDKeyPair<int>& e1, const RIDKeyPair<int>& e2)
+{
+    return e1.key < e2.key;
+}
+
+///ids that entries [first, last) of a bulk load stand for, ids as foldPostings leaves it
+static std::uint32_t entryIds(const std::vector<std::uint32_t>& ids, size_t first, size_t last)
+{
+    if(ids.empty()) return (std::uint32_t)(last - first);
+    return std::accumulate(ids.begin() + first, ids.begin() + last, (std::uint32_t)0);
+}
+
+///only INTEGER leaves are packed, the constructor turns packedLeaves off for the other types
+template <class T>
+void BTreeIndex::bulkLoadPacked(std::vector<RIDKeyPair<T> >&, const std::vector<std::uint32_t>&)
+{
+    throw BadIndexInfoException("Packed leaves hold INTEGER keys only");
+}
+
+template <>
+void BTreeIndex::bulkLoadPacked<int>(std::vector<RIDKeyPair<int> >& entries, const std::vector<std::uint32_t>& ids)
+{
+    ///leaves hold more entries the closer their keys and records are, so the entries are cut by size rather than count
+    std::vector<size_t> sizes;
+    packedleaf::leafPieces(entries.data(), entries.size(), fillFactor, sizes);
+    
+    std::vector<PageKeyPair<int> > level;
+    PageKeyPair<int> nodeEntry;
+    
+    PageId curPageNum = rootPageNum;
+    Page* curPage;
+    readNode(curPageNum, curPage);
+    
+    ((PackedLeafNode*)curPage)->leftSibPageNo = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < sizes.size(); leaf++){
+        PackedLeafNode* leafNode = (PackedLeafNode*)curPage;
+        packedleaf::encodeLeaf(leafNode, entries.data() + next, (int)sizes[leaf]);
+        nodeEntry.set(curPageNum, sizes[leaf] > 0 ? entries[next].key : 0, entryIds(ids, next, next + sizes[leaf]));
+        level.push_back(nodeEntry);
+        next += sizes[leaf];
+        
+        if(leaf + 1 < sizes.size()){
+            PageId nextPageNum;
+            Page* nextPage;
+            allocNode(nextPageNum, nextPage);
+            leafNode->rightSibPageNo = nextPageNum;
+            ((PackedLeafNode*)nextPage)->leftSibPageNo = curPageNum;
+            unPinNode(curPageNum, true);
+            curPageNum = nextPageNum;
+            curPage = nextPage;
+        }else{
+            leafNode->rightSibPageNo = 0;
+            unPinNode(curPageNum, true);
+        }
+    }
+    
+    rootPageNum = buildUpperLevels(level, 1);
+    isRootALeaf = (sizes.size() == 1);
+}
+
+template <class T>
+void BTreeIndex::leafMergePacked(PageId, Page*, const RIDKeyPair<T>*, size_t, std::vector<PageKeyPair<T> >&)
+{
+    throw BadIndexInfoException("Packed leaves hold INTEGER keys only");
+}
+
+template <>
+void BTreeIndex::leafMergePacked<int>(PageId pageNum, Page* leaf, const RIDKeyPair<int>* entries, size_t n, std::vector<PageKeyPair<int> >& newSiblings)
+{
+    PackedLeafNode* leafNode = (PackedLeafNode*)leaf;
+    std::vector<RIDKeyPair<int> > existing;
+    packedleaf::decodeLeaf(leafNode, existing);
+    std::vector<RIDKeyPair<int> > merged(existing.size() + n);
+    std::merge(existing.begin(), existing.end(), entries, entries + n, merged.begin(), intEntryOrder);
+    
+    ///re-encode in place if everything fits one leaf, otherwise spread the entries by the fill factor
+    std::vector<size_t> sizes;
+    packedleaf::leafPieces(merged.data(), merged.size(), 1.0, sizes);
+    if(sizes.size() > 1){
+        packedleaf::leafPieces(merged.data(), merged.size(), fillFactor, sizes);
+    }
+    
+    PageId lastSibPageNo = leafNode->rightSibPageNo;
+    PackedLeafNode* curNode = leafNode;
+    PageId curPageNum = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < sizes.size(); leaf++){
+        packedleaf::encodeLeaf(curNode, merged.data() + next, (int)sizes[leaf]);
+        next += sizes[leaf];
+        if(leaf > 0) newSiblings.back().count = (std::uint32_t)leafEntries<int>((Page*)curNode, 0, (int)sizes[leaf]);
+        
+        if(leaf + 1 < sizes.size()){
+            PageId newPageNum;
+            Page* newPage;
+            allocNode(newPageNum, newPage);
+            curNode->rightSibPageNo = newPageNum;
+            if(curPageNum != 0) unPinNode(curPageNum, true);
+            curNode = (PackedLeafNode*)newPage;
+            curNode->leftSibPageNo = (curPageNum != 0) ? curPageNum : pageNum;
+            curPageNum = newPageNum;
+            
+            PageKeyPair<int> sibling;
+            sibling.set(newPageNum, merged[next].key);
+            newSiblings.push_back(sibling);
+        }
+    }
+    curNode->rightSibPageNo = lastSibPageNo;
+    if(curPageNum != 0){
+        unPinNode(curPageNum, true);
+        setLeftSibling(lastSibPageNo, curPageNum);
+    }
+}
+
+template <class T>
+bool BTreeIndex::deleteFromPacked(PageId pageNum, Page*, const T&, const RecordId&, bool&)
+{
+    unPinNode(pageNum, false);
+    throw BadIndexInfoException("Packed leaves hold INTEGER keys only");
+}
+
+template <>
+bool BTreeIndex::deleteFromPacked<int>(PageId pageNum, Page* leaf, const int& key, const RecordId& rid, bool& underflow)
+{
+    PackedLeafNode* leafNode = (PackedLeafNode*)leaf;
+    int count = leafNode->header.keyCount;
+    ///duplicates keep their insertion order, look through all of them and their posting lists for the rid
+    for(int i = packedleaf::leafLowerBound(leafNode, key); i < count && packedleaf::leafKey(leafNode, i) == key; i++){
+        RecordId entryRid = packedleaf::leafRid(leafNode, i);
+        bool erase = (entryRid == rid);
+        bool found = erase;
+        if(!found && postinglist::isList(entryRid)){
+            found = postingRemove(entryRid.page_number, rid, erase);
+        }
+        if(found){
+            ///the other entries fit the field widths of the leaf, so it is encoded again in place
+            if(erase){
+                std::vector<RIDKeyPair<int> > entries;
+                packedleaf::decodeLeaf(leafNode, entries);
+                entries.erase(entries.begin() + i);
+                packedleaf::encodeLeaf(leafNode, entries.data(), (int)entries.size());
+                count--;
+            }
+            ///packed leaves fill by bytes, not by entry count
+            underflow = (count == 0 || packedleaf::leafUsedBytes(leafNode) < PACKEDLEAFDATASIZE * lowWaterFill);
+            unPinNode(pageNum, true);
+            return true;
+        }
+    }
+    unPinNode(pageNum, false);
+    return false;
+}
+
+template <class T>
+bool BTreeIndex::rebalancePacked(Page*, Page*, T&)
+{
+    throw BadIndexInfoException("Packed leaves hold INTEGER keys only");
+}
+
+template <>
+bool BTreeIndex::rebalancePacked<int>(Page* leftPage, Page* rightPage, int& separator)
+{
+    PackedLeafNode* leftNode = (PackedLeafNode*)leftPage;
+    PackedLeafNode* rightNode = (PackedLeafNode*)rightPage;
+    std::vector<RIDKeyPair<int> > entries;
+    packedleaf::decodeLeaf(leftNode, entries);
+    packedleaf::decodeLeaf(rightNode, entries);
+    
+    ///merge only into a leaf the next few inserts will not split again right away
+    std::vector<size_t> sizes;
+    packedleaf::leafPieces(entries.data(), entries.size(), fillFactor, sizes);
+    if(sizes.size() == 1){
+        packedleaf::encodeLeaf(leftNode, entries.data(), (int)entries.size());
+        leftNode->rightSibPageNo = rightNode->rightSibPageNo;
+        return true;
+    }
+    
+    ///even the two out. Together the entries may need wider fields than either leaf had, and if they
+    ///then no longer fit in two leaves the leaves are left as they are
+    packedleaf::leafPieces(entries.data(), entries.size(), 1.0, sizes);
+    if(sizes.size() > 2) return false;
+    if(sizes.size() == 1){
+        sizes.assign(1, entries.size() / 2);
+        sizes.push_back(entries.size() - sizes[0]);
+    }
+    packedleaf::encodeLeaf(leftNode, entries.data(), (int)sizes[0]);
+    packedleaf::encodeLeaf(rightNode, entries.data() + sizes[0], (int)sizes[1]);
+    separator = entries[sizes[0]].key;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::loadRelation
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::loadRelation(const std::string & relationName)
+{
+    std::vector<RIDKeyPair<T> > entries;
+    RIDKeyPair<T> dataEntry;
+    RecordId tmpRec;
+    std::string tmpStr;
+    T key;
+    
+    FileScan fScan(relationName, bufMgr);
+    try{
+        while(1){
+            fScan.scanNext(tmpRec);
+            tmpStr = fScan.getRecord();
+            recordKey(tmpStr, attrByteOffset, keyColumns, key);
+            dataEntry.set(tmpRec, key);
+            entries.push_back(dataEntry);
+        }
+    }catch(EndOfFileException e){
+        ///every tuple has been read
+    }
+    
+    bulkLoad(entries);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::bulkLoad(std::vector<RIDKeyPair<T> >& entries)
+{
+    std::sort(entries.begin(), entries.end());
+    std::vector<std::uint32_t> ids;
+    if(postingMinDuplicates > 0) foldPostings(entries, ids);
+    if(packedLeaves){
+        bulkLoadPacked(entries, ids);
+        return;
+    }
+    
+    ///pageNo, lowest key and entry count of every leaf
+    std::vector<PageKeyPair<T> > level;
+    PageKeyPair<T> nodeEntry;
+    
+    ///leaf level. Spread the entries evenly so the last leaf is not left nearly empty
+    int leafFill = nodeFill(leafOccupancy);
+    size_t numEntries = entries.size();
+    size_t numLeaves = std::max<size_t>(1, (numEntries + leafFill - 1) / leafFill);
+    
+    PageId curPageNum = rootPageNum;
+    Page* curPage;
+    readNode(curPageNum, curPage);
+    
+    ((LeafNode<T>*)curPage)->leftSibPageNo = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < numLeaves; leaf++){
+        LeafNode<T>* leafNode = (LeafNode<T>*)curPage;
+        size_t count = numEntries / numLeaves + (leaf < numEntries % numLeaves ? 1 : 0);
+        leafNode->header.nodeType = LEAF_NODE;
+        leafNode->header.level = 0;
+        leafNode->header.keyCount = (std::int32_t)count;
+        
+        for(size_t i = 0; i < count; i++, next++){
+            leafNode->keyArray[i] = entries[next].key;
+            leafNode->ridArray[i] = entries[next].rid;
+        }
+        nodeEntry.set(curPageNum, count > 0 ? leafNode->keyArray[0] : T(), entryIds(ids, next - count, next));
+        level.push_back(nodeEntry);
+        
+        ///allocate the right sibling first so this leaf can be linked to it before it is written
+        if(leaf + 1 < numLeaves){
+            PageId nextPageNum;
+            Page* nextPage;
+            allocNode(nextPageNum, nextPage);
+            leafNode->rightSibPageNo = nextPageNum;
+            ((LeafNode<T>*)nextPage)->leftSibPageNo = curPageNum;
+            unPinNode(curPageNum, true);
+            curPageNum = nextPageNum;
+            curPage = nextPage;
+        }else{
+            leafNode->rightSibPageNo = 0;
+            unPinNode(curPageNum, true);
+        }
+    }
+    
+    rootPageNum = buildUpperLevels(level, 1);
+    isRootALeaf = (numLeaves == 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildUpperLevels
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::buildUpperLevels(std::vector<PageKeyPair<T> >& level, int nodeLevel)
+{
+    ///build the non-leaf levels until a single node, the root, is left
+    size_t maxChildren = nodeFill(nodeOccupancy) + 1;
+    while(level.size() > 1){
+        std::vector<PageKeyPair<T> > parentLevel;
+        PageKeyPair<T> nodeEntry;
+        size_t numNodes = (level.size() + maxChildren - 1) / maxChildren;
+        
+        size_t next = 0;
+        for(size_t node = 0; node < numNodes; node++){
+            PageId curPageNum;
+            Page* tmpPage;
+            allocNode(curPageNum, tmpPage);
+            NonLeafNode<T>* nonLeafNode = (NonLeafNode<T>*)tmpPage;
+            size_t children = level.size() / numNodes + (node < level.size() % numNodes ? 1 : 0);
+            nonLeafNode->header.nodeType = nonLeafNodeType();
+            nonLeafNode->header.level = (std::int16_t)nodeLevel;
+            nonLeafNode->header.keyCount = (std::int32_t)(children - 1);
+            ///the lowest key of the first child is not stored here, it is passed up to the parent
+            nodeEntry.set(curPageNum, level[next].key, level[next].count);
+            nonLeafNode->pageNoArray[0] = level[next].pageNo;
+            nonLeafNode->countArray[0] = level[next].count;
+            next++;
+            for(size_t i = 1; i < children; i++, next++){
+                nonLeafNode->keyArray[i-1] = level[next].key;
+                nonLeafNode->pageNoArray[i] = level[next].pageNo;
+                nonLeafNode->countArray[i] = level[next].count;
+                nodeEntry.count += level[next].count;
+            }
+            updateDirectory<T>(tmpPage);
+            parentLevel.push_back(nodeEntry);
+            unPinNode(curPageNum, true);
+        }
+        
+        level.swap(parentLevel);
+        nodeLevel++;
+    }
+    
+    return level[0].pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nodeFill
+// -----------------------------------------------------------------------------
+
+int BTreeIndex::nodeFill(int occupancy)
+{
+    ///at least one key and at most a full node
+    int fill = (int)(occupancy * fillFactor);
+    return std::max(1, std::min(fill, occupancy));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setRoot
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setRoot(PageId pageNum, bool isLeaf)
+{
+    ///optimistic readers load the root without a lock, see optimisticPath
+    __atomic_store_n(&rootPageNum, pageNum, __ATOMIC_RELEASE);
+    __atomic_store_n(&isRootALeaf, isLeaf, __ATOMIC_RELEASE);
+    
+    ///read and update MetaPage
+    Page* tmpMetaPage;
+    bufMgr->readPage(file, headerPageNum, tmpMetaPage);
+    IndexMetaInfo* metaInfo = (IndexMetaInfo*)tmpMetaPage;
+    metaInfo->rootPageNo = rootPageNum;
+    metaInfo->isRootALeaf = isRootALeaf;
+    bufMgr->unPinPage(file, headerPageNum, true);
+    
+    ///a new root from a split goes on top of the cached levels. No one has it pinned yet, so it can be
+    ///cached right away. Any other root change leaves the cache to be filled again
+    if(!isLeaf && cachedNode(pageNum) == NULL && upperCacheSize < upperCachePages){
+        CachedNode& node = upperCache[upperCacheSize];
+        node.pageNum = pageNum;
+        bufMgr->readPage(file, pageNum, node.page);
+        node.dirty = false;
+        __atomic_store_n(&upperCacheSize, upperCacheSize + 1, __ATOMIC_RELEASE);
+    }else{
+        upperCacheStale = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNode / unPinNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::readNode(PageId pageNum, Page*& page)
+{
+    page = cachedNode(pageNum);
+    if(page == NULL) bufMgr->readPage(file, pageNum, page);
+}
+
+void BTreeIndex::unPinNode(PageId pageNum, bool dirty)
+{
+    int size = __atomic_load_n(&upperCacheSize, __ATOMIC_ACQUIRE);
+    for(int i = 0; i < size; i++){
+        if(upperCache[i].pageNum == pageNum){
+            if(dirty) __atomic_store_n(&upperCache[i].dirty, true, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    bufMgr->unPinPage(file, pageNum, dirty);
+}
+
+Page* BTreeIndex::cachedNode(PageId pageNum)
+{
+    ///a handful of nodes, a linear search is cheaper than the buffer pool hash table and its latch
+    int size = __atomic_load_n(&upperCacheSize, __ATOMIC_ACQUIRE);
+    for(int i = 0; i < size; i++){
+        if(upperCache[i].pageNum == pageNum) return upperCache[i].page;
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setUpperCache / refreshUpperCache
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setUpperCache(int maxPages)
+{
+    releaseUpperCache();
+    upperCachePages = std::max(maxPages, 0);
+    upperCache.resize(upperCachePages);
+    refreshUpperCache();
+}
+
+void BTreeIndex::releaseUpperCache()
+{
+    for(int i = 0; i < upperCacheSize; i++){
+        bufMgr->unPinPage(file, upperCache[i].pageNum, upperCache[i].dirty);
+    }
+    upperCacheSize = 0;
+}
+
+void BTreeIndex::refreshUpperCache()
+{
+    releaseUpperCache();
+    upperCacheStale = false;
+    switch(attributeType){
+    case INTEGER: fillUpperCache<int>(); break;
+    case DOUBLE: fillUpperCache<double>(); break;
+    case STRING: fillUpperCache<StringKey>(); break;
+    }
+}
+
+void BTreeIndex::checkUpperCache()
+{
+    if(!threadSafe && upperCacheStale) refreshUpperCache();
+}
+
+template <class T>
+void BTreeIndex::fillUpperCache()
+{
+    if(isRootALeaf) return;
+    
+    ///a level at a time from the root, as many nodes as fit. Leaves are never cached
+    std::vector<PageId> level(1, rootPageNum);
+    std::vector<PageId> nextLevel;
+    while(!level.empty()){
+        nextLevel.clear();
+        for(size_t i = 0; i < level.size(); i++){
+            if(upperCacheSize == upperCachePages) return;
+            CachedNode& node = upperCache[upperCacheSize];
+            node.pageNum = level[i];
+            bufMgr->readPage(file, node.pageNum, node.page);
+            node.dirty = false;
+            upperCacheSize++;
+            
+            const NodeHeader* header = (const NodeHeader*)node.page;
+            if(header->level > 1){
+                for(int c = 0; c <= header->keyCount; c++) nextLevel.push_back(childAt<T>(node.page, c));
+            }
+        }
+        level.swap(nextLevel);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nonLeafNodeType
+// -----------------------------------------------------------------------------
+
+std::int16_t BTreeIndex::nonLeafNodeType() const
+{
+    return blockedNonLeaves ? BLOCKED_NONLEAF_NODE : NONLEAF_NODE;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocNode(PageId& pageNum, Page*& page)
+{
+    std::lock_guard<std::mutex> guard(allocLatch);
+    rightEdgePath.clear();
+    if(freePageNum == 0){
+        bufMgr->allocPage(file, pageNum, page);
+        return;
+    }
+    
+    ///BlobFile cannot delete pages, so freed pages are handed out again before the file grows
+    pageNum = freePageNum;
+    readNode(pageNum, page);
+    setFreeList(((FreeNode*)page)->nextFreePageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::freeNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::freeNode(PageId pageNum, Page* page)
+{
+    std::lock_guard<std::mutex> guard(allocLatch);
+    rightEdgePath.clear();
+    FreeNode* freeNode = (FreeNode*)page;
+    freeNode->header.nodeType = FREE_NODE;
+    freeNode->header.level = 0;
+    freeNode->header.keyCount = 0;
+    freeNode->nextFreePageNo = freePageNum;
+    ///a cached node stays pinned until the cache is filled again
+    if(cachedNode(pageNum) != NULL) upperCacheStale = true;
+    unPinNode(pageNum, true);
+    setFreeList(pageNum);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setFreeList
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setFreeList(PageId pageNum)
+{
+    freePageNum = pageNum;
+    
+    Page* tmpMetaPage;
+    bufMgr->readPage(file, headerPageNum, tmpMetaPage);
+    ((IndexMetaInfo*)tmpMetaPage)->freePageNo = freePageNum;
+    bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::~BTreeIndex -- destructor
+// -----------------------------------------------------------------------------
+
+BTreeIndex::~BTreeIndex()
+{ ///end any running scan, flush the indexfile from buffer and close it
+    try{
+        if(scanCursor.isOpen()) scanCursor.endScan();
+        ///the read-ahead worker may hold a page of the file pinned until it stops, and reads leaves the
+        ///buffered messages are about to change
+        delete readAhead;
+        readAhead = NULL;
+        flushWriteBuffer();
+        releaseUpperCache();
+        bufMgr->flushFile(file);
+    }catch(BadgerDbException e){
+        ///destructor must not throw
+    }
+    delete nodeLatches;
+    delete file;
+}
+
+///newNodeInfo will contain the pageId and key of the new right node, level is the level of the new root
+template <class T>
+void BTreeIndex::rootSplit(PageKeyPair<T> newNodeInfo, std::uint32_t rootCount, int level)
+{
+ 
+    PageId newPageNum;
+    Page * tmpPage;
+    allocNode(newPageNum, tmpPage);
+    
+    NonLeafNode<T>* newRootNode = (NonLeafNode<T>*)tmpPage;
+    newRootNode->header.nodeType = nonLeafNodeType();
+    newRootNode->header.level = level;
+    newRootNode->header.keyCount = 1;
+    
+    ///set NonLeafNode info for RootNode
+    newRootNode->keyArray[0] = newNodeInfo.key;
+    ///left of key is the old root, right is the newNode
+    newRootNode->pageNoArray[0] = rootPageNum;
+    newRootNode->pageNoArray[1] = newNodeInfo.pageNo;
+    newRootNode->countArray[0] = rootCount;
+    newRootNode->countArray[1] = newNodeInfo.count;
+    updateDirectory<T>(tmpPage);
+    
+    unPinNode(newPageNum, true);
+    
+    ///update rootPageNum and the MetaPage
+    setRoot(newPageNum, false);
+    
+}
+    
+template <class T>
+void BTreeIndex::nonLeafSplit(NonLeafNode<T>* nonLeafNode, PageKeyPair<T>& newNonLeafPage, PageKeyPair<T> pageEntry, int pos, bool rightEdge)
+{
+    ///create a new nonLeafNode, move the upper half of the keys to it and pass the middle key up
+    PageId newPageNum;
+    Page * tmpPage;
+    allocNode(newPageNum, tmpPage);
+    
+    NonLeafNode<T>* newNonLeafNode = (NonLeafNode<T>*)tmpPage;
+    newNonLeafNode->header.nodeType = nonLeafNodeType();
+    newNonLeafNode->header.level = nonLeafNode->header.level;
+    
+    ///lay out the keys and children with the new entry in place, then cut that sequence in two
+    T keys[nonLeafArraySize<T>() + 1];
+    PageId children[nonLeafArraySize<T>() + 2];
+    std::uint32_t counts[nonLeafArraySize<T>() + 2];
+    int n = nonLeafNode->header.keyCount;
+    
+    std::copy(nonLeafNode->keyArray, nonLeafNode->keyArray + pos, keys);
+    keys[pos] = pageEntry.key;
+    std::copy(nonLeafNode->keyArray + pos, nonLeafNode->keyArray + n, keys + pos + 1);
+    std::copy(nonLeafNode->pageNoArray, nonLeafNode->pageNoArray + pos + 1, children);
+    children[pos + 1] = pageEntry.pageNo;
+    std::copy(nonLeafNode->pageNoArray + pos + 1, nonLeafNode->pageNoArray + n + 1, children + pos + 2);
+    std::copy(nonLeafNode->countArray, nonLeafNode->countArray + pos + 1, counts);
+    std::copy(nonLeafNode->countArray + pos + 1, nonLeafNode->countArray + n + 1, counts + pos + 2);
+    ///the child that split and its new sibling hold its old entries and the new one between them
+    counts[pos] = nonLeafNode->countArray[pos] + 1 - pageEntry.count;
+    counts[pos + 1] = pageEntry.count;
+    
+    ///keys[mid] moves up to the parent and is kept in neither node. The last child of a node on the right
+    ///edge splits again and again under appends, so that node keeps as many keys as a bulk load gives it
+    int mid = (n + 1) / 2;
+    if(rightEdge && pos == n) mid = std::min(nodeFill(nodeOccupancy), n - 1);
+    std::copy(keys, keys + mid, nonLeafNode->keyArray);
+    std::copy(children, children + mid + 1, nonLeafNode->pageNoArray);
+    std::copy(counts, counts + mid + 1, nonLeafNode->countArray);
+    nonLeafNode->header.keyCount = mid;
+    
+    std::copy(keys + mid + 1, keys + n + 1, newNonLeafNode->keyArray);
+    std::copy(children + mid + 1, children + n + 2, newNonLeafNode->pageNoArray);
+    std::copy(counts + mid + 1, counts + n + 2, newNonLeafNode->countArray);
+    newNonLeafNode->header.keyCount = n - mid;
+    updateDirectory<T>((Page*)nonLeafNode);
+    updateDirectory<T>(tmpPage);
+    
+    newNonLeafPage.set(newPageNum, keys[mid], std::accumulate(counts + mid + 1, counts + n + 2, (std::uint32_t)0));
+    unPinNode(newPageNum, true);
+    
+}
+    
+template <class T>
+void BTreeIndex::leafSplit(PageId pageNum, LeafNode<T>* leafNode, PageKeyPair<T>& newLeafPage, RIDKeyPair<T> dataEntry)
+{
+    ///create a new leafNode, move the upper half of the entries to it and pass its first key up
+    PageId newPageNum;
+    Page * tmpPage;
+    allocNode(newPageNum, tmpPage);
+    
+    LeafNode<T>* newLeafNode = (LeafNode<T>*)tmpPage;
+    newLeafNode->header.nodeType = LEAF_NODE;
+    newLeafNode->header.level = 0;
+    
+    ///the left node keeps mid entries once the new entry is in. Move one more if the new entry goes left
+    int n = leafNode->header.keyCount;
+    int mid = (n + 1) / 2;
+    int pos = nodesearch::upperBound(leafNode->keyArray, n, dataEntry.key);
+    ///an entry past the end of the rightmost leaf is most likely one of a run of appends, which would leave
+    ///every left half as it is. The left node is kept as full as a bulk load fills it instead
+    if(pos == n && leafNode->rightSibPageNo == 0) mid = nodeFill(leafOccupancy);
+    int moveFrom = (pos < mid) ? mid - 1 : mid;
+    
+    std::copy(leafNode->keyArray + moveFrom, leafNode->keyArray + n, newLeafNode->keyArray);
+    std::copy(leafNode->ridArray + moveFrom, leafNode->ridArray + n, newLeafNode->ridArray);
+    newLeafNode->header.keyCount = n - moveFrom;
+    leafNode->header.keyCount = moveFrom;
+
+    newLeafNode->rightSibPageNo = leafNode->rightSibPageNo;
+    newLeafNode->leftSibPageNo = pageNum;
+    leafNode->rightSibPageNo = newPageNum;
+    setLeftSibling(newLeafNode->rightSibPageNo, newPageNum);
+    
+    if(pos < mid){
+        leafInsert(leafNode, dataEntry);
+    }else leafInsert(newLeafNode, dataEntry);
+    
+    newLeafPage.set(newPageNum, newLeafNode->keyArray[0], (std::uint32_t)leafEntries<T>(tmpPage, 0, newLeafNode->header.keyCount));
+    unPinNode(newPageNum, true);
+    
+}
+    
+    
+// -----------------------------------------------------------------------------
+// leafInsert
+// -----------------------------------------------------------------------------
+    
+
+    
+template <class T>
+void BTreeIndex::leafInsert(LeafNode<T> * leafNode, RIDKeyPair<T> dataEntry)
+{
+    int count = leafNode->header.keyCount;
+    
+    ///insert location is after any equal keys so duplicates keep their insertion order
+    int i = nodesearch::upperBound(leafNode->keyArray, count, dataEntry.key);
+    
+    ///shift the used entries one to the right. Work from right to left to avoid overwriting entries
+    std::copy_backward(leafNode->keyArray + i, leafNode->keyArray + count, leafNode->keyArray + count + 1);
+    std::copy_backward(leafNode->ridArray + i, leafNode->ridArray + count, leafNode->ridArray + count + 1);
+    
+    leafNode->keyArray[i] = dataEntry.key;
+    leafNode->ridArray[i] = dataEntry.rid;
+    leafNode->header.keyCount = count + 1;
+
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setLeftSibling
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setLeftSibling(PageId pageNum, PageId leftPageNum)
+{
+    if(pageNum == 0) return;
+    ///leftSibPageNo is at the same place in every leaf layout
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    ((LeafNodeInt*)tmpPage)->leftSibPageNo = leftPageNum;
+    unPinNode(pageNum, true);
+}
+
+template <class T>
+void BTreeIndex::nonLeafInsert(NonLeafNode<T> * nonLeafNode, PageKeyPair<T> pageEntry, int i)
+{
+    ///child i has been split and we need to now insert the pageEntry
+    int keyCount = nonLeafNode->header.keyCount;
+    
+    ///shift all entries one to the right, the new page goes to the right of its key
+    std::copy_backward(nonLeafNode->keyArray + i, nonLeafNode->keyArray + keyCount, nonLeafNode->keyArray + keyCount + 1);
+    std::copy_backward(nonLeafNode->pageNoArray + i + 1, nonLeafNode->pageNoArray + keyCount + 1, nonLeafNode->pageNoArray + keyCount + 2);
+    std::copy_backward(nonLeafNode->countArray + i + 1, nonLeafNode->countArray + keyCount + 1, nonLeafNode->countArray + keyCount + 2);
+
+    nonLeafNode->keyArray[i] = pageEntry.key;
+    nonLeafNode->pageNoArray[i+1] = pageEntry.pageNo;
+    nonLeafNode->header.keyCount = keyCount + 1;
+    ///the child that split and its new sibling hold its old entries and the new one between them
+    nonLeafNode->countArray[i] += 1 - pageEntry.count;
+    nonLeafNode->countArray[i+1] = pageEntry.count;
+    updateDirectory<T>((Page*)nonLeafNode);
+
+}
+        
+    
+template <class T>
+void BTreeIndex::rootLeafInsert(LeafNode<T> * rootNode, RIDKeyPair<T> dataEntry, bool split)
+{
+    
+    if(!split){ ///don't need to split, treat like any other leaf
+        leafInsert(rootNode, dataEntry);
+    }else{
+        ///split the node and make a new root node above both halves
+        
+        PageKeyPair<T> newLeafPage;
+        
+        leafSplit(rootPageNum, rootNode, newLeafPage, dataEntry);
+        rootSplit(newLeafPage, (std::uint32_t)leafEntries<T>((Page*)rootNode, 0, rootNode->header.keyCount), 1);
+    }
+        
+}
+    
+// -----------------------------------------------------------------------------
+// FindLeaf
+// Arguments:  RIDKeypair to be inserted, current page number, and Placeholder PageKeyPair entry as overflow tracker
+// -----------------------------------------------------------------------------
+///Recursively visit each node on the way down to the leaf node that contains the correct location for the key. Start at root
+///Base Case, the next node is a leaf node and the insertion can be attempted.
+///If curPage itself has to split, splitEntry is set to the new right node and the key to insert in the parent.
+template <class T>
+void BTreeIndex::findandInsert(RIDKeyPair<T> dataEntry, PageId curPageNum, PageKeyPair<T>& splitEntry, bool rightEdge)
+{
+    ///read current page from bufferManager
+    Page* tmpPage;
+    readNode(curPageNum, tmpPage);
+    
+    ///this will always be a nonLeaf page
+    NonLeafNode<T>* curPage = (NonLeafNode<T>*)tmpPage;
+    
+    ///find dataEntry's key position relative to curPage keyArray, equal keys go to the right child
+    int i = childIndex<T>(tmpPage, dataEntry.key, false);
+    PageId nextPageNum = curPage->pageNoArray[i];
+    
+    ///entry to add to curPage if the child below it splits
+    PageKeyPair<T> childSplit;
+    childSplit.set(0, T());
+    
+    if(curPage->header.level == 1){ ///directly above leaf. Next page is leafNode
+        Page* nextPage;
+        
+        readNode(nextPageNum, nextPage);
+        
+        LeafNode<T> * leafNode = (LeafNode<T>*)nextPage;
+        
+        if(postingInsert(leafNode, dataEntry)){///went to a posting list, the leaf does not grow
+        }else if(leafNode->header.keyCount == leafOccupancy){///will need to split
+            leafSplit(nextPageNum, leafNode, childSplit, dataEntry);
+        }else{///can be inserted no problem.
+            leafInsert(leafNode, dataEntry);
+        }
+        unPinNode(nextPageNum, true);
+    }else{
+        ///not low enough yet, traverse to next node
+        findandInsert(dataEntry, nextPageNum, childSplit, rightEdge && i == curPage->header.keyCount);
+    }
+    
+    ///on the way back up, check to see if childSplit has been set, if so insert it here
+    if(childSplit.pageNo != 0) {
+        ///can the new key fit on curPage, if not split again.
+        if(curPage->header.keyCount == nodeOccupancy){
+            nonLeafSplit(curPage, splitEntry, childSplit, i, rightEdge);
+        }else nonLeafInsert(curPage, childSplit, i);
+    }else __atomic_fetch_add(&curPage->countArray[i], 1, __ATOMIC_RELAXED);
+    unPinNode(curPageNum, true);
+}
+    
+    
+    
+// -----------------------------------------------------------------------------
+// BTreeIndex write buffer
+// -----------------------------------------------------------------------------
+
+template <>
+WriteBuffer<int>& BTreeIndex::writeBuffer<int>() { return intMessages; }
+
+template <>
+WriteBuffer<double>& BTreeIndex::writeBuffer<double>() { return doubleMessages; }
+
+template <>
+WriteBuffer<StringKey>& BTreeIndex::writeBuffer<StringKey>() { return stringMessages; }
+
+///orders entries by key only, used to find where a run of entries for one child ends
+template <class T>
+static bool entryKeyLess(const RIDKeyPair<T>& entry, const T& key)
+{
+    return entry.key < key;
+}
+
+template <class T>
+static bool keyEntryLess(const T& key, const RIDKeyPair<T>& entry)
+{
+    return key < entry.key;
+}
+
+///positions [first, last) of the messages with keys in a scan range
+template <class T>
+static void messageRange(const std::vector<RIDKeyPair<T> >& messages, const T& lowVal, Operator lowOp,
+                         const T& highVal, Operator highOp, size_t& first, size_t& last)
+{
+    first = ((lowOp == GTE) ? std::lower_bound(messages.begin(), messages.end(), lowVal, entryKeyLess<T>)
+                            : std::upper_bound(messages.begin(), messages.end(), lowVal, keyEntryLess<T>)) - messages.begin();
+    last = ((highOp == LTE) ? std::upper_bound(messages.begin(), messages.end(), highVal, keyEntryLess<T>)
+                            : std::lower_bound(messages.begin(), messages.end(), highVal, entryKeyLess<T>)) - messages.begin();
+    last = std::max(first, last);
+}
+
+bool BTreeIndex::buffering() const
+{
+    return writeBufferMessages > 0 && !threadSafe;
+}
+
+void BTreeIndex::setWriteBuffer(int maxMessages)
+{
+    beginExclusive();
+    checkUpperCache();
+    try{
+        flushWriteBuffer();
+    }catch(...){
+        endExclusive();
+        throw;
+    }
+    endExclusive();
+    writeBufferMessages = std::max(maxMessages, 0);
+}
+
+template <class T>
+void BTreeIndex::bufferInsert(const void* key, const RecordId rid)
+{
+    RIDKeyPair<T> entry;
+    entry.set(rid, keyFromPointer<T>(key));
+    WriteBuffer<T>& buffer = writeBuffer<T>();
+    buffer.sorted = false;
+    
+    ///inserting an entry deleted since the last flush keeps the copy the leaves still hold
+    typename std::map<RIDKeyPair<T>, int, MessageOrder<T> >::iterator pos = buffer.copies.insert(std::make_pair(entry, 0)).first;
+    if(pos->second < 0){
+        buffer.size--;
+        if(++pos->second == 0) buffer.copies.erase(pos);
+        return;
+    }
+    pos->second++;
+    buffer.size++;
+    if(buffer.size >= (size_t)writeBufferMessages) applyMessages<T>(false);
+}
+
+template <class T>
+void BTreeIndex::bufferDelete(const void* key, const RecordId rid)
+{
+    RIDKeyPair<T> entry;
+    entry.set(rid, keyFromPointer<T>(key));
+    WriteBuffer<T>& buffer = writeBuffer<T>();
+    
+    typename std::map<RIDKeyPair<T>, int, MessageOrder<T> >::iterator pos = buffer.copies.find(entry);
+    if(pos != buffer.copies.end() && pos->second > 0){
+        buffer.sorted = false;
+        buffer.size--;
+        if(--pos->second == 0) buffer.copies.erase(pos);
+        return;
+    }
+    
+    ///the leaves have to hold one more copy of the entry than is deleted already
+    size_t deleted = (pos == buffer.copies.end()) ? 0 : -pos->second;
+    if(!leafHolds<T>(entry.key, rid, deleted + 1)){
+        throw NoSuchKeyFoundException();
+    }
+    buffer.sorted = false;
+    if(pos == buffer.copies.end()) buffer.copies.insert(std::make_pair(entry, -1));
+    else pos->second--;
+    buffer.size++;
+    if(buffer.size >= (size_t)writeBufferMessages) applyMessages<T>(false);
+}
+
+template <class T>
+const WriteBuffer<T>& BTreeIndex::sortedMessages()
+{
+    WriteBuffer<T>& buffer = writeBuffer<T>();
+    if(buffer.sorted) return buffer;
+    
+    ///the map is in message order already, each entry stands for as many copies as its count
+    buffer.inserts.clear();
+    buffer.deletes.clear();
+    typename std::map<RIDKeyPair<T>, int, MessageOrder<T> >::const_iterator it;
+    for(it = buffer.copies.begin(); it != buffer.copies.end(); ++it){
+        if(it->second > 0) buffer.inserts.insert(buffer.inserts.end(), it->second, it->first);
+        else buffer.deletes.insert(buffer.deletes.end(), -it->second, it->first);
+    }
+    buffer.sorted = true;
+    return buffer;
+}
+
+template <class T>
+void BTreeIndex::applyMessages(bool all)
+{
+    sortedMessages<T>();
+    WriteBuffer<T>& buffer = writeBuffer<T>();
+    std::vector<RIDKeyPair<T> >& inserts = buffer.inserts;
+    std::vector<RIDKeyPair<T> >& deletes = buffer.deletes;
+    if(inserts.empty() && deletes.empty()) return;
+    
+    ///messages go down to the children of the root with the most of them, until at least half of the
+    ///buffer is applied. The others keep theirs until they have gathered more
+    std::vector<int> insertChild(inserts.size(), 0);
+    std::vector<int> deleteChild(deletes.size(), 0);
+    std::vector<bool> flushChild(1, true);
+    if(!all && !isRootALeaf){
+        Page* tmpPage;
+        readNode(rootPageNum, tmpPage);
+        std::vector<size_t> counts(((NodeHeader*)tmpPage)->keyCount + 1, 0);
+        for(size_t i = 0; i < inserts.size(); i++){
+            insertChild[i] = childIndex<T>(tmpPage, inserts[i].key, false);
+            counts[insertChild[i]]++;
+        }
+        for(size_t i = 0; i < deletes.size(); i++){
+            deleteChild[i] = childIndex<T>(tmpPage, deletes[i].key, false);
+            counts[deleteChild[i]]++;
+        }
+        unPinNode(rootPageNum, false);
+        
+        std::vector<std::pair<size_t, int> > children(counts.size());
+        for(size_t c = 0; c < counts.size(); c++) children[c] = std::make_pair(counts[c], (int)c);
+        std::sort(children.begin(), children.end());
+        flushChild.assign(counts.size(), false);
+        size_t applied = 0;
+        for(size_t i = children.size(); 2 * applied < inserts.size() + deletes.size(); i--){
+            flushChild[children[i - 1].second] = true;
+            applied += children[i - 1].first;
+        }
+    }
+    
+    std::vector<RIDKeyPair<T> > applyInserts, keepInserts, applyDeletes, keepDeletes;
+    for(size_t i = 0; i < inserts.size(); i++) (flushChild[insertChild[i]] ? applyInserts : keepInserts).push_back(inserts[i]);
+    for(size_t i = 0; i < deletes.size(); i++) (flushChild[deleteChild[i]] ? applyDeletes : keepDeletes).push_back(deletes[i]);
+    inserts.swap(keepInserts);
+    deletes.swap(keepDeletes);
+    ///all copies of an entry go to one child, so the applied entries leave copies whole
+    for(size_t i = 0; i < applyInserts.size(); i++) buffer.copies.erase(applyInserts[i]);
+    for(size_t i = 0; i < applyDeletes.size(); i++) buffer.copies.erase(applyDeletes[i]);
+    buffer.size = inserts.size() + deletes.size();
+    
+    ///every delete is of an entry the leaves hold, so none of them fails. The inserts go in as one batch,
+    ///which changes each leaf once
+    for(size_t i = 0; i < applyDeletes.size(); i++){
+        deleteKey<T>(&applyDeletes[i].key, applyDeletes[i].rid);
+    }
+    if(!applyInserts.empty()){
+        std::vector<KeyRidPair> pairs(applyInserts.size());
+        for(size_t i = 0; i < pairs.size(); i++){
+            pairs[i].key = &applyInserts[i].key;
+            pairs[i].rid = applyInserts[i].rid;
+        }
+        insertKeys<T>(&pairs[0], pairs.size());
+    }
+}
+
+void BTreeIndex::flushWriteBuffer()
+{
+    switch(attributeType){
+    case INTEGER: applyMessages<int>(true); break;
+    case DOUBLE: applyMessages<double>(true); break;
+    case STRING: applyMessages<StringKey>(true); break;
+    }
+}
+
+template <class T>
+bool BTreeIndex::leafHolds(const T& key, const RecordId& rid, size_t copies)
+{
+    Page leafCopy;
+    Page* leaf;
+    PageId pageNum;
+    readLeaf<T>(key, true, pageNum, leaf, &leafCopy);
+    
+    size_t found = 0;
+    std::vector<RecordId> rids;
+    while(found < copies){
+        int first = leafBound<T>(leaf, key, true);
+        int last = leafBound<T>(leaf, key, false);
+        for(int i = first; i < last && found < copies; i++){
+            RecordId entryRid = leafRidAt<T>(leaf, i);
+            if(!postinglist::isList(entryRid)){
+                if(entryRid == rid) found++;
+                continue;
+            }
+            ///the ids of a posting list are sorted on each of its pages
+            PageId listPageNum = entryRid.page_number;
+            while(listPageNum != 0 && found < copies){
+                listPageNum = loadPosting(listPageNum, rids);
+                std::pair<std::vector<RecordId>::iterator, std::vector<RecordId>::iterator> same =
+                    std::equal_range(rids.begin(), rids.end(), rid, postinglist::ridLess);
+                found += same.second - same.first;
+            }
+        }
+        if(last < ((NodeHeader*)leaf)->keyCount || ((LeafNodeInt*)leaf)->rightSibPageNo == 0) break;
+        nextLeaf(pageNum, leaf, &leafCopy);
+    }
+    releaseLeaf(pageNum);
+    return found >= copies;
+}
+
+template <class T>
+long BTreeIndex::bufferedInRange(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp)
+{
+    size_t first, last;
+    messageRange<T>(sortedMessages<T>().inserts, lowVal, lowOp, highVal, highOp, first, last);
+    long n = (long)(last - first);
+    messageRange<T>(sortedMessages<T>().deletes, lowVal, lowOp, highVal, highOp, first, last);
+    return n - (long)(last - first);
+}
+
+template <class T>
+size_t BTreeIndex::lookupMerged(const T& key, RecordId* out, size_t max)
+{
+    const WriteBuffer<T>& buffer = sortedMessages<T>();
+    size_t insertFirst, insertLast, deleteFirst, deleteLast;
+    messageRange<T>(buffer.inserts, key, GTE, key, LTE, insertFirst, insertLast);
+    messageRange<T>(buffer.deletes, key, GTE, key, LTE, deleteFirst, deleteLast);
+    
+    ///enough entries are read from the leaves to still have max once the deleted ones are dropped
+    std::vector<RecordId> rids(max + deleteLast - deleteFirst);
+    size_t n = lookupKey<T>(key, &rids[0], rids.size());
+    
+    ///the deletes of one key are sorted by record id. Each leaf entry is looked up among them, and the
+    ///copies of a record id each drop one entry, counted at the first of them
+    std::vector<RecordId> deleted(deleteLast - deleteFirst);
+    for(size_t d = deleteFirst; d < deleteLast; d++) deleted[d - deleteFirst] = buffer.deletes[d].rid;
+    std::vector<size_t> used(deleted.size(), 0);
+    size_t found = 0;
+    for(size_t i = 0; i < n && found < max; i++){
+        std::pair<std::vector<RecordId>::iterator, std::vector<RecordId>::iterator> same =
+            std::equal_range(deleted.begin(), deleted.end(), rids[i], postinglist::ridLess);
+        if(same.first != same.second && used[same.first - deleted.begin()] < (size_t)(same.second - same.first)){
+            used[same.first - deleted.begin()]++;
+        }else out[found++] = rids[i];
+    }
+    for(size_t i = insertFirst; i < insertLast && found < max; i++) out[found++] = buffer.inserts[i].rid;
+    return found;
+}
+
+///whether the buffered deletes of key leave one of the entries leaves hold for it
+template <class T>
+static bool liveRun(const std::vector<RIDKeyPair<T> >& deletes, const T& key, size_t entries)
+{
+    size_t first, last;
+    messageRange<T>(deletes, key, GTE, key, LTE, first, last);
+    return entries > last - first;
+}
+
+template <class T>
+bool BTreeIndex::liveEdgeKey(bool max, T& key)
+{
+    const std::vector<RIDKeyPair<T> >& deletes = sortedMessages<T>().deletes;
+    Page leafCopy;
+    Page* leaf;
+    PageId pageNum;
+    readLeaf<T>(max ? highestKey<T>() : lowestKey<T>(), !max, pageNum, leaf, &leafCopy);
+    
+    ///the leaves are walked from the edge inwards, so only the keys the deletes take are read. Entries
+    ///of one key are counted across leaves. The key is live if the deletes leave one of them
+    bool found = false;
+    bool inRun = false;
+    T runKey = T();
+    size_t runEntries = 0;
+    while(!found){
+        int count = ((NodeHeader*)leaf)->keyCount;
+        for(int n = 0; n < count && !found;){
+            T nextKey = leafKeyAt<T>(leaf, max ? count - 1 - n : n);
+            int first = max ? leafBound<T>(leaf, nextKey, true) : n;
+            int last = max ? count - n : leafBound<T>(leaf, nextKey, false);
+            if(inRun && nextKey != runKey){
+                found = liveRun<T>(deletes, runKey, runEntries);
+                if(found) key = runKey;
+                inRun = false;
+            }
+            if(!inRun){
+                runKey = nextKey;
+                runEntries = 0;
+                inRun = true;
+            }
+            runEntries += leafEntries<T>(leaf, first, last);
+            n += last - first;
+        }
+        PageId sibPageNo = max ? ((LeafNodeInt*)leaf)->leftSibPageNo : ((LeafNodeInt*)leaf)->rightSibPageNo;
+        if(found || sibPageNo == 0) break;
+        nextLeaf(pageNum, leaf, &leafCopy, max);
+    }
+    releaseLeaf(pageNum);
+    
+    if(!found && inRun){
+        found = liveRun<T>(deletes, runKey, runEntries);
+        if(found) key = runKey;
+    }
+    return found;
+}
+
+template <class T>
+void BTreeIndex::mergeMessages(BTreeScanCursor& cursor, const T& lowVal, const T& highVal)
+{
+    const WriteBuffer<T>& buffer = sortedMessages<T>();
+    messageRange<T>(buffer.inserts, lowVal, cursor.lowOp, highVal, cursor.highOp, cursor.insertNext, cursor.insertEnd);
+    messageRange<T>(buffer.deletes, lowVal, cursor.lowOp, highVal, cursor.highOp, cursor.deleteFirst, cursor.deleteEnd);
+    cursor.deleteUsed.assign(cursor.deleteEnd - cursor.deleteFirst, false);
+    cursor.merging = cursor.insertNext < cursor.insertEnd || cursor.deleteFirst < cursor.deleteEnd;
+    cursor.heldValid = false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+{
+    if(threadSafe){
+        switch(attributeType){
+        case INTEGER: insertShared<int>(key, rid); break;
+        case DOUBLE: insertShared<double>(key, rid); break;
+        case STRING: insertShared<StringKey>(key, rid); break;
+        }
+        return;
+    }
+    beginExclusive();
+    checkUpperCache();
+    try{
+        if(buffering()){
+            switch(attributeType){
+            case INTEGER: bufferInsert<int>(key, rid); break;
+            case DOUBLE: bufferInsert<double>(key, rid); break;
+            case STRING: bufferInsert<StringKey>(key, rid); break;
+            }
+        }else{
+            switch(attributeType){
+            case INTEGER: insertKey<int>(key, rid); break;
+            case DOUBLE: insertKey<double>(key, rid); break;
+            case STRING: insertKey<StringKey>(key, rid); break;
+            }
+        }
+    }catch(...){
+        endExclusive();
+        throw;
+    }
+    endExclusive();
+}
+
+template <class T>
+void BTreeIndex::insertKey(const void *key, const RecordId rid) 
+{
+    ///a packed leaf is encoded again for every change, a single insert is a batch of one
+    if(packedLeaves){
+        KeyRidPair pair;
+        pair.key = key;
+        pair.rid = rid;
+        insertKeys<T>(&pair, 1);
+        return;
+    }
+    
+    RIDKeyPair<T> dataEntry;
+    dataEntry.set(rid, keyFromPointer<T>(key));
+    if(appendInsert(dataEntry)) return;
+    
+    ///if root is a leaf, then manually insert until it needs to split
+    if(isRootALeaf){
+        Page* tmpPage;
+        PageId rootLeafNum = rootPageNum;
+        readNode(rootLeafNum, tmpPage);
+        
+        LeafNode<T> * rootLeaf = (LeafNode<T>*)tmpPage;
+        ///full root leaf needs to split
+        if(!postingInsert(rootLeaf, dataEntry)) rootLeafInsert(rootLeaf, dataEntry, rootLeaf->header.keyCount == leafOccupancy);
+        unPinNode(rootLeafNum, true);
+        
+    }else{
+        ///set up call to FindLeaf, let it handle the insert.
+        ///pass in root page number, dataEntry, and PageKeyPair entry
+        
+        PageKeyPair<T> splitEntry;
+        ///set page number to zero as this will mark whether a page is allocated
+        splitEntry.set(0, dataEntry.key);
+        
+        findandInsert(dataEntry, rootPageNum, splitEntry, true);
+        
+        ///if splitEntry has a valid page, that means root needs to split
+        if(splitEntry.pageNo != 0){
+            Page* tmpPage;
+            readNode(rootPageNum, tmpPage);
+            int rootLevel = ((NonLeafNode<T>*)tmpPage)->header.level;
+            std::uint32_t rootCount = subtreeEntries<T>(tmpPage);
+            unPinNode(rootPageNum, false);
+            rootSplit(splitEntry, rootCount, rootLevel + 1);
+        }
+    }
+    
+}
+
+template <class T>
+bool BTreeIndex::appendInsert(const RIDKeyPair<T>& dataEntry)
+{
+    ///another writer may change the shape of the tree while the path is followed
+    if(threadSafe) return false;
+    
+    if(rightEdgePath.empty()){
+        PageId pageNum = rootPageNum;
+        while(pageNum != 0){
+            rightEdgePath.push_back(pageNum);
+            Page* tmpPage;
+            readNode(pageNum, tmpPage);
+            const NodeHeader* header = (const NodeHeader*)tmpPage;
+            PageId childNum = isLeafNode(tmpPage) ? 0 : childAt<T>(tmpPage, header->keyCount);
+            unPinNode(pageNum, false);
+            pageNum = childNum;
+        }
+    }
+    
+    ///every separator on the path is at most the last key of the leaf, so a key not below that key
+    ///would be led to this leaf by findandInsert as well
+    PageId leafNum = rightEdgePath.back();
+    Page* tmpPage;
+    readNode(leafNum, tmpPage);
+    LeafNode<T>* leafNode = (LeafNode<T>*)tmpPage;
+    int count = leafNode->header.keyCount;
+    if(leafNode->header.nodeType != LEAF_NODE || count == 0 || count == leafOccupancy
+       || dataEntry.key < leafNode->keyArray[count - 1]){
+        unPinNode(leafNum, false);
+        return false;
+    }
+    
+    ///the counts go first, a posting list started by the insert allocates a page and empties the path
+    for(size_t i = 0; i + 1 < rightEdgePath.size(); i++){
+        Page* nodePage;
+        readNode(rightEdgePath[i], nodePage);
+        NonLeafNode<T>* node = (NonLeafNode<T>*)nodePage;
+        node->countArray[node->header.keyCount]++;
+        unPinNode(rightEdgePath[i], true);
+    }
+    if(!postingInsert(leafNode, dataEntry)){
+        leafNode->keyArray[count] = dataEntry.key;
+        leafNode->ridArray[count] = dataEntry.rid;
+        leafNode->header.keyCount++;
+    }
+    unPinNode(leafNum, true);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setThreadSafe
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setThreadSafe(bool on)
+{
+    ///threads insert and delete without the buffer, so it starts them off empty
+    if(on){
+        beginExclusive();
+        try{
+            flushWriteBuffer();
+        }catch(...){
+            endExclusive();
+            throw;
+        }
+        endExclusive();
+    }
+    ///the cache only takes in new roots while threads share the index, start them off with a full one
+    if(upperCacheStale) refreshUpperCache();
+    threadSafe = on;
+    if(on && nodeLatches == NULL) nodeLatches = new NodeLatchTable();
+    ///scans on several threads may ask for read-ahead at once, so the worker has to exist before they do
+    if(on && readAheadPages > 0 && readAhead == NULL) readAhead = new ReadAhead(bufMgr, file, treeLatch, *nodeLatches);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::beginExclusive / endExclusive
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::beginExclusive()
+{
+    ///new inserts, optimistic reads and the read-ahead worker wait on or stop at treeLatch
+    treeLatch.lock();
+    ///the inserts already under node latches finish first
+    if(!threadSafe) return;
+    while(activeWriters.load() != 0){
+        std::this_thread::yield();
+    }
+}
+
+void BTreeIndex::endExclusive()
+{
+    treeLatch.unlock();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::copyNode
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::copyNode(PageId pageNum, std::uint64_t version, std::uint64_t treeVersion, Page* copy)
+{
+    ///the cache is looked at once, a node cached in between must not be unpinned by this read
+    Page* page = cachedNode(pageNum);
+    if(page != NULL){
+        memcpy((void*)copy, (const void*)page, Page::SIZE);
+    }else{
+        bufMgr->readPage(file, pageNum, page);
+        memcpy((void*)copy, (const void*)page, Page::SIZE);
+        bufMgr->unPinPage(file, pageNum, false);
+    }
+    return nodeLatches->latch(pageNum).validate(version) && treeLatch.validate(treeVersion);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::searchInPlace
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::searchInPlace(PageId pageNum, const T& key, bool lower, LatchedNode& node, PageId& childNum)
+{
+    Page* page = cachedNode(pageNum);
+    bool pinned = (page == NULL);
+    if(pinned) bufMgr->readPage(file, pageNum, page);
+    
+    ///the header is read once. A writer may be halfway through the node, so the count is only trusted
+    ///as far as the arrays of the node reach
+    NonLeafNode<T>* nonLeafNode = (NonLeafNode<T>*)page;
+    std::int16_t nodeType = __atomic_load_n(&nonLeafNode->header.nodeType, __ATOMIC_RELAXED);
+    bool blocked = (nodeType == BLOCKED_NONLEAF_NODE);
+    if(nodeType != NONLEAF_NODE && !blocked){
+        if(pinned) bufMgr->unPinPage(file, pageNum, false);
+        return false;
+    }
+    int count = __atomic_load_n(&nonLeafNode->header.keyCount, __ATOMIC_RELAXED);
+    count = std::min(std::max(count, 0), blocked ? blockedNonLeafSize<T>() : nonLeafArraySize<T>());
+    
+    if(blocked){
+        const T* directory = nonLeafNode->keyArray + blockedNonLeafSize<T>();
+        node.child = lower ? nodesearch::blockedLowerBound(nonLeafNode->keyArray, count, directory, nonLeafBlockKeys<T>(), key)
+                           : nodesearch::blockedUpperBound(nonLeafNode->keyArray, count, directory, nonLeafBlockKeys<T>(), key);
+    }else{
+        node.child = lower ? nodesearch::lowerBound(nonLeafNode->keyArray, count, key)
+                           : nodesearch::upperBound(nonLeafNode->keyArray, count, key);
+    }
+    childNum = __atomic_load_n(&nonLeafNode->pageNoArray[node.child], __ATOMIC_RELAXED);
+    node.hasRoom = count < nodeOccupancy;
+    if(pinned) bufMgr->unPinPage(file, pageNum, false);
+    return true;
+}
+
+template <>
+bool BTreeIndex::searchInPlace<StringKey>(PageId pageNum, const StringKey& key, bool lower, LatchedNode& node, PageId& childNum)
+{
+    ///string non-leaves hold offsets into the page, which a half-written node may send anywhere
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::optimisticPath
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::optimisticPath(const T& key, bool lower, std::vector<LatchedNode>& path, std::uint64_t& rootVersion, std::uint64_t& treeVersion, Page* leafCopy)
+{
+    path.clear();
+    treeVersion = treeLatch.readLock();
+    rootVersion = rootLatch.readLock();
+    PageId pageNum = __atomic_load_n(&rootPageNum, __ATOMIC_ACQUIRE);
+    std::uint64_t version = nodeLatches->latch(pageNum).readLock();
+    if(!rootLatch.validate(rootVersion)) return false;
+    
+    ///INTEGER and DOUBLE non-leaves are searched where they sit, see searchInPlace. Leaves and STRING
+    ///nodes are looked at only in copies that passed validation, their offsets may make no sense while
+    ///a writer changes them
+    Page scratch;
+    Page* copy = (leafCopy != NULL) ? leafCopy : &scratch;
+    while(1){
+        LatchedNode node;
+        node.pageNum = pageNum;
+        node.version = version;
+        PageId childNum;
+        if(searchInPlace<T>(pageNum, key, lower, node, childNum)){
+            if(!nodeLatches->latch(pageNum).validate(version) || !treeLatch.validate(treeVersion)) return false;
+        }else{
+            if(!copyNode(pageNum, version, treeVersion, copy)) return false;
+            node.hasRoom = nodeHasRoom<T>(copy);
+            node.child = 0;
+            if(isLeafNode(copy)){
+                path.push_back(node);
+                return true;
+            }
+            node.child = childIndex<T>(copy, key, lower);
+            childNum = childAt<T>(copy, node.child);
+        }
+        path.push_back(node);
+        
+        ///the child is still the right one only if its parent has not changed since it was read
+        std::uint64_t childVersion = nodeLatches->latch(childNum).readLock();
+        if(!nodeLatches->latch(pageNum).validate(version)) return false;
+        pageNum = childNum;
+        version = childVersion;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nodeHasRoom
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::nodeHasRoom(const Page* node) const
+{
+    ///STRING occupancies are for keys of the full width, so this holds whatever widths the node is encoded with
+    const NodeHeader* header = (const NodeHeader*)node;
+    return header->keyCount < (isLeafNode(node) ? leafOccupancy : nodeOccupancy);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertShared
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::insertShared(const void* key, const RecordId rid)
+{
+    RIDKeyPair<T> dataEntry;
+    dataEntry.set(rid, keyFromPointer<T>(key));
+    
+    std::vector<LatchedNode> path;
+    std::vector<std::pair<VersionLatch*, std::uint64_t> > held;
+    Page leafPage;
+    while(1){
+        ///count this insert before looking at treeLatch, so an exclusive operation either waits for it or is seen by it
+        activeWriters++;
+        if(treeLatch.isLocked()){
+            activeWriters--;
+            treeLatch.readLock();
+            continue;
+        }
+        
+        std::uint64_t rootVersion, treeVersion;
+        if(!optimisticPath(dataEntry.key, false, path, rootVersion, treeVersion, &leafPage)){
+            activeWriters--;
+            continue;
+        }
+        
+        ///posting lists have no latches of their own, entries that go to one are inserted exclusively.
+        ///So are entries for packed leaves, which may have to be encoded as more leaves than a split makes
+        if(packedLeaves || touchesPosting<T>(&leafPage, dataEntry.key)){
+            activeWriters--;
+            beginExclusive();
+            try{
+                insertKey<T>(key, rid);
+            }catch(...){
+                endExclusive();
+                throw;
+            }
+            endExclusive();
+            return;
+        }
+        
+        ///the insert changes the leaf, the full nodes above it that split with it and the first node with room
+        int top = (int)path.size() - 1;
+        while(top > 0 && !path[top].hasRoom) top--;
+        bool rootSplits = !path[top].hasRoom;
+        
+        ///latch top-down at the versions the descent read. Any node changed since means starting over
+        held.clear();
+        bool latched = !rootSplits || rootLatch.tryUpgrade(rootVersion);
+        if(latched && rootSplits) held.push_back(std::make_pair(&rootLatch, rootVersion));
+        for(int i = top; latched && i < (int)path.size(); i++){
+            VersionLatch* latch = &nodeLatches->latch(path[i].pageNum);
+            bool alreadyHeld = false;
+            for(size_t h = 0; h < held.size(); h++){
+                if(held[h].first != latch) continue;
+                ///two nodes of the path share a latch, the one version must fit both
+                alreadyHeld = true;
+                latched = (held[h].second == path[i].version);
+            }
+            if(alreadyHeld) continue;
+            latched = latch->tryUpgrade(path[i].version);
+            if(latched) held.push_back(std::make_pair(latch, path[i].version));
+        }
+        
+        ///a leaf split also points the old right neighbour of the leaf at the new leaf. The neighbour is
+        ///latched after the path, so waiting for it could close a cycle with another insert
+        if(latched && !path.back().hasRoom){
+            PageId rightNum = ((LeafNodeInt*)&leafPage)->rightSibPageNo;
+            VersionLatch* latch = &nodeLatches->latch(rightNum);
+            bool alreadyHeld = (rightNum == 0);
+            for(size_t h = 0; h < held.size(); h++){
+                if(held[h].first == latch) alreadyHeld = true;
+            }
+            if(!alreadyHeld){
+                latched = latch->tryLock();
+                if(latched) held.push_back(std::make_pair(latch, std::uint64_t(0)));
+            }
+        }
+        
+        if(latched){
+            try{
+                if(rootSplits) insertKey<T>(key, rid);
+                else insertBelow<T>(path[top].pageNum, dataEntry);
+            }catch(...){
+                for(size_t h = 0; h < held.size(); h++) held[h].first->unlock();
+                activeWriters--;
+                throw;
+            }
+        }
+        for(size_t h = 0; h < held.size(); h++) held[h].first->unlock();
+        ///the nodes above top count the insert too, a root split has counted it all the way up already
+        if(latched && !rootSplits && top > 0) addPathCounts<T>(dataEntry.key, (int)path.size() - 1 - top);
+        activeWriters--;
+        if(latched) return;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertBelow
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::insertBelow(PageId pageNum, const RIDKeyPair<T>& dataEntry)
+{
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    if(((NodeHeader*)tmpPage)->nodeType == LEAF_NODE){
+        if(!postingInsert((LeafNode<T>*)tmpPage, dataEntry)) leafInsert((LeafNode<T>*)tmpPage, dataEntry);
+        unPinNode(pageNum, true);
+        return;
+    }
+    unPinNode(pageNum, false);
+    
+    ///the node has room, so the separators of any splits below it stop here
+    PageKeyPair<T> splitEntry;
+    splitEntry.set(0, dataEntry.key);
+    findandInsert(dataEntry, pageNum, splitEntry, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::addPathCounts
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::addPathCounts(const T& key, int topLevel)
+{
+    ///levels above this one have their counts added already
+    int countedLevel = std::numeric_limits<int>::max();
+    Page copy;
+    while(1){
+        std::uint64_t treeVersion = treeLatch.readLock();
+        std::uint64_t rootVersion = rootLatch.readLock();
+        PageId pageNum = __atomic_load_n(&rootPageNum, __ATOMIC_ACQUIRE);
+        std::uint64_t version = nodeLatches->latch(pageNum).readLock();
+        if(!rootLatch.validate(rootVersion)) continue;
+        
+        bool restart = false;
+        while(!restart){
+            if(!copyNode(pageNum, version, treeVersion, &copy)) break;
+            int level = ((NodeHeader*)&copy)->level;
+            if(level <= topLevel) return;
+            int child = childIndex<T>(&copy, key, false);
+            PageId childNum = childAt<T>(&copy, child);
+            
+            ///a node unchanged since the copy still holds key, as only a write to the node itself moves its keys
+            if(level < countedLevel){
+                VersionLatch& latch = nodeLatches->latch(pageNum);
+                if(!latch.tryUpgrade(version)) break;
+                Page* tmpPage;
+                readNode(pageNum, tmpPage);
+                __atomic_fetch_add(childCounts<T>(tmpPage) + child, 1, __ATOMIC_RELAXED);
+                unPinNode(pageNum, true);
+                version = latch.unlock();
+                countedLevel = level;
+            }
+            
+            std::uint64_t childVersion = nodeLatches->latch(childNum).readLock();
+            restart = !nodeLatches->latch(pageNum).validate(version);
+            pageNum = childNum;
+            version = childVersion;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntries
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntries(const KeyRidPair* pairs, size_t n)
+{
+    if(n == 0) return;
+    
+    beginExclusive();
+    checkUpperCache();
+    try{
+        switch(attributeType){
+        case INTEGER: insertKeys<int>(pairs, n); break;
+        case DOUBLE: insertKeys<double>(pairs, n); break;
+        case STRING: insertKeys<StringKey>(pairs, n); break;
+        }
+    }catch(...){
+        endExclusive();
+        throw;
+    }
+    endExclusive();
+}
+
+template <class T>
+void BTreeIndex::insertKeys(const KeyRidPair* pairs, size_t n)
+{
+    std::vector<RIDKeyPair<T> > entries(n);
+    for(size_t i = 0; i < n; i++){
+        entries[i].set(pairs[i].rid, keyFromPointer<T>(pairs[i].key));
+    }
+    std::sort(entries.begin(), entries.end());
+    
+    ///level and entries of the root before the batch, new root levels are built above it
+    Page* tmpPage;
+    readNode(rootPageNum, tmpPage);
+    int rootLevel = ((NodeHeader*)tmpPage)->level;
+    std::uint32_t rootCount = subtreeEntries<T>(tmpPage) + (std::uint32_t)n;
+    unPinNode(rootPageNum, false);
+    
+    std::vector<PageKeyPair<T> > newSiblings;
+    batchInsert(rootPageNum, &entries[0], n, newSiblings);
+    
+    ///the root split into several nodes, put a new level (or more for very large batches) on top
+    if(!newSiblings.empty()){
+        std::vector<PageKeyPair<T> > level;
+        ///the old root keeps the entries that did not go to its new siblings
+        for(size_t i = 0; i < newSiblings.size(); i++) rootCount -= newSiblings[i].count;
+        PageKeyPair<T> oldRoot;
+        oldRoot.set(rootPageNum, T(), rootCount);
+        level.push_back(oldRoot);
+        level.insert(level.end(), newSiblings.begin(), newSiblings.end());
+        setRoot(buildUpperLevels(level, rootLevel + 1), false);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::batchInsert
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::batchInsert(PageId pageNum, const RIDKeyPair<T>* entries, size_t n, std::vector<PageKeyPair<T> >& newSiblings)
+{
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    
+    if(packedLeaf(tmpPage)){
+        leafMergePacked(pageNum, tmpPage, entries, n, newSiblings);
+        unPinNode(pageNum, true);
+        return;
+    }
+    if(((NodeHeader*)tmpPage)->nodeType == LEAF_NODE){
+        leafMerge(pageNum, (LeafNode<T>*)tmpPage, entries, n, newSiblings);
+        unPinNode(pageNum, true);
+        return;
+    }
+    
+    NonLeafNode<T>* curNode = (NonLeafNode<T>*)tmpPage;
+    int keyCount = curNode->header.keyCount;
+    
+    ///new right siblings of the children, tagged with the index of the child that split
+    std::vector<std::pair<int, PageKeyPair<T> > > childSplits;
+    std::vector<PageKeyPair<T> > siblings;
+    
+    ///entries are sorted, so each child receives one contiguous run and is visited once
+    size_t start = 0;
+    while(start < n){
+        int child = childIndex<T>(tmpPage, entries[start].key, false);
+        ///the run ends at the first entry that belongs right of this child's separator
+        size_t end = n;
+        if(child < keyCount){
+            end = std::lower_bound(entries + start, entries + n, curNode->keyArray[child], entryKeyLess<T>) - entries;
+        }
+        
+        siblings.clear();
+        batchInsert(curNode->pageNoArray[child], entries + start, end - start, siblings);
+        for(size_t s = 0; s < siblings.size(); s++){
+            childSplits.push_back(std::make_pair(child, siblings[s]));
+        }
+        curNode->countArray[child] += (std::uint32_t)(end - start);
+        start = end;
+    }
+    
+    if(!childSplits.empty()){
+        nonLeafMerge(curNode, childSplits, newSiblings);
+    }
+    unPinNode(pageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafMerge
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::leafMerge(PageId pageNum, LeafNode<T>* leafNode, const RIDKeyPair<T>* entries, size_t n, std::vector<PageKeyPair<T> >& newSiblings)
+{
+    int count = leafNode->header.keyCount;
+    size_t total = count + n;
+    
+    if(total <= (size_t)leafOccupancy){
+        ///merge from the back so each existing entry is shifted at most once.
+        ///new entries go after equal keys, same as leafInsert
+        int i = count - 1;
+        size_t j = n;
+        size_t out = total;
+        while(j > 0){
+            out--;
+            if(i >= 0 && leafNode->keyArray[i] > entries[j-1].key){
+                leafNode->keyArray[out] = leafNode->keyArray[i];
+                leafNode->ridArray[out] = leafNode->ridArray[i];
+                i--;
+            }else{
+                leafNode->keyArray[out] = entries[j-1].key;
+                leafNode->ridArray[out] = entries[j-1].rid;
+                j--;
+            }
+        }
+        leafNode->header.keyCount = (std::int32_t)total;
+        return;
+    }
+    
+    ///too many for one page. Merge into a scratch run and spread it over as many leaves as the fill factor needs
+    std::vector<T> keys(total);
+    std::vector<RecordId> rids(total);
+    int i = 0;
+    size_t j = 0;
+    for(size_t out = 0; out < total; out++){
+        if(j >= n || (i < count && leafNode->keyArray[i] <= entries[j].key)){
+            keys[out] = leafNode->keyArray[i];
+            rids[out] = leafNode->ridArray[i];
+            i++;
+        }else{
+            keys[out] = entries[j].key;
+            rids[out] = entries[j].rid;
+            j++;
+        }
+    }
+    
+    int leafFill = nodeFill(leafOccupancy);
+    size_t numLeaves = (total + leafFill - 1) / leafFill;
+    PageId lastSibPageNo = leafNode->rightSibPageNo;
+    
+    ///the first part stays in this leaf, the rest go to new leaves linked in after it
+    LeafNode<T>* curNode = leafNode;
+    PageId curPageNum = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < numLeaves; leaf++){
+        size_t leafCount = total / numLeaves + (leaf < total % numLeaves ? 1 : 0);
+        std::copy(keys.begin() + next, keys.begin() + next + leafCount, curNode->keyArray);
+        std::copy(rids.begin() + next, rids.begin() + next + leafCount, curNode->ridArray);
+        curNode->header.keyCount = (std::int32_t)leafCount;
+        next += leafCount;
+        if(leaf > 0) newSiblings.back().count = (std::uint32_t)leafEntries<T>((Page*)curNode, 0, (int)leafCount);
+        
+        if(leaf + 1 < numLeaves){
+            PageId newPageNum;
+            Page* newPage;
+            allocNode(newPageNum, newPage);
+            curNode->rightSibPageNo = newPageNum;
+            if(curPageNum != 0) unPinNode(curPageNum, true);
+            
+            curNode = (LeafNode<T>*)newPage;
+            curNode->header.nodeType = LEAF_NODE;
+            curNode->header.level = 0;
+            curNode->leftSibPageNo = (curPageNum != 0) ? curPageNum : pageNum;
+            curPageNum = newPageNum;
+            
+            PageKeyPair<T> sibling;
+            sibling.set(newPageNum, keys[next]);
+            newSiblings.push_back(sibling);
+        }
+    }
+    curNode->rightSibPageNo = lastSibPageNo;
+    if(curPageNum != 0){
+        unPinNode(curPageNum, true);
+        setLeftSibling(lastSibPageNo, curPageNum);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nonLeafMerge
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::nonLeafMerge(NonLeafNode<T>* nonLeafNode, const std::vector<std::pair<int, PageKeyPair<T> > >& childSplits, std::vector<PageKeyPair<T> >& newSiblings)
+{
+    int count = nonLeafNode->header.keyCount;
+    
+    ///the new siblings of child i go right after it, ahead of the key that separates it from child i+1.
+    ///placing them by position keeps the order right even when a new key equals an existing one
+    std::vector<T> keys;
+    std::vector<PageId> children;
+    std::vector<std::uint32_t> counts;
+    keys.reserve(count + childSplits.size());
+    children.reserve(count + childSplits.size() + 1);
+    counts.reserve(count + childSplits.size() + 1);
+    size_t s = 0;
+    for(int i = 0; i <= count; i++){
+        children.push_back(nonLeafNode->pageNoArray[i]);
+        counts.push_back(nonLeafNode->countArray[i]);
+        ///the count of a child that split already has the batch in it, its new siblings take their share
+        size_t child = counts.size() - 1;
+        while(s < childSplits.size() && childSplits[s].first == i){
+            keys.push_back(childSplits[s].second.key);
+            children.push_back(childSplits[s].second.pageNo);
+            counts.push_back(childSplits[s].second.count);
+            counts[child] -= childSplits[s].second.count;
+            s++;
+        }
+        if(i < count) keys.push_back(nonLeafNode->keyArray[i]);
+    }
+    
+    if(keys.size() <= (size_t)nodeOccupancy){
+        std::copy(keys.begin(), keys.end(), nonLeafNode->keyArray);
+        std::copy(children.begin(), children.end(), nonLeafNode->pageNoArray);
+        std::copy(counts.begin(), counts.end(), nonLeafNode->countArray);
+        nonLeafNode->header.keyCount = (std::int32_t)keys.size();
+        updateDirectory<T>((Page*)nonLeafNode);
+        return;
+    }
+    
+    ///split the children evenly over as many nodes as needed, the key between two nodes moves up
+    size_t maxChildren = nodeFill(nodeOccupancy) + 1;
+    size_t numChildren = children.size();
+    size_t numNodes = (numChildren + maxChildren - 1) / maxChildren;
+    
+    size_t next = 0;
+    for(size_t node = 0; node < numNodes; node++){
+        size_t nodeChildren = numChildren / numNodes + (node < numChildren % numNodes ? 1 : 0);
+        NonLeafNode<T>* curNode = nonLeafNode;
+        PageId curPageNum = 0;
+        if(node > 0){
+            Page* newPage;
+            allocNode(curPageNum, newPage);
+            curNode = (NonLeafNode<T>*)newPage;
+            curNode->header.nodeType = nonLeafNodeType();
+            curNode->header.level = nonLeafNode->header.level;
+            
+            PageKeyPair<T> sibling;
+            sibling.set(curPageNum, keys[next - 1], std::accumulate(counts.begin() + next, counts.begin() + next + nodeChildren, (std::uint32_t)0));
+            newSiblings.push_back(sibling);
+        }
+        
+        std::copy(children.begin() + next, children.begin() + next + nodeChildren, curNode->pageNoArray);
+        std::copy(counts.begin() + next, counts.begin() + next + nodeChildren, curNode->countArray);
+        std::copy(keys.begin() + next, keys.begin() + next + nodeChildren - 1, curNode->keyArray);
+        curNode->header.keyCount = (std::int32_t)(nodeChildren - 1);
+        updateDirectory<T>((Page*)curNode);
+        next += nodeChildren;
+        
+        if(curPageNum != 0) unPinNode(curPageNum, true);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::deleteEntry(const void* key, const RecordId rid)
+{
+    beginExclusive();
+    checkUpperCache();
+    try{
+        if(buffering()){
+            switch(attributeType){
+            case INTEGER: bufferDelete<int>(key, rid); break;
+            case DOUBLE: bufferDelete<double>(key, rid); break;
+            case STRING: bufferDelete<StringKey>(key, rid); break;
+            }
+        }else{
+            switch(attributeType){
+            case INTEGER: deleteKey<int>(key, rid); break;
+            case DOUBLE: deleteKey<double>(key, rid); break;
+            case STRING: deleteKey<StringKey>(key, rid); break;
+            }
+        }
+    }catch(...){
+        endExclusive();
+        throw;
+    }
+    endExclusive();
+}
+
+template <class T>
+void BTreeIndex::deleteKey(const void* key, const RecordId rid)
+{
+    bool underflow = false;
+    if(!deleteFrom<T>(rootPageNum, keyFromPointer<T>(key), rid, underflow)){
+        throw NoSuchKeyFoundException();
+    }
+    
+    ///a root left with a single child is replaced by that child, the tree gets one level shorter
+    while(!isRootALeaf){
+        Page* tmpPage;
+        readNode(rootPageNum, tmpPage);
+        NodeHeader* header = (NodeHeader*)tmpPage;
+        if(header->keyCount > 0){
+            unPinNode(rootPageNum, false);
+            break;
+        }
+        PageId oldRootNum = rootPageNum;
+        setRoot(childAt<T>(tmpPage, 0), header->level == 1);
+        freeNode(oldRootNum, tmpPage);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setLowWaterFill
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setLowWaterFill(double fill)
+{
+    lowWaterFill = std::max(0.0, std::min(fill, 0.5));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteFrom
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::deleteFrom(PageId pageNum, const T& key, const RecordId& rid, bool& underflow)
+{
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    
+    if(packedLeaf(tmpPage)) return deleteFromPacked(pageNum, tmpPage, key, rid, underflow);
+    if(((NodeHeader*)tmpPage)->nodeType == LEAF_NODE){
+        LeafNode<T>* leafNode = (LeafNode<T>*)tmpPage;
+        int count = leafNode->header.keyCount;
+        ///duplicates keep their insertion order, look through all of them and their posting lists for the rid
+        for(int i = nodesearch::lowerBound(leafNode->keyArray, count, key); i < count && leafNode->keyArray[i] == key; i++){
+            bool erase = (leafNode->ridArray[i] == rid);
+            bool found = erase;
+            if(!found && postinglist::isList(leafNode->ridArray[i])){
+                found = postingRemove(leafNode->ridArray[i].page_number, rid, erase);
+            }
+            if(found){
+                ///a posting list that lost its last record id goes like a plain entry
+                if(erase){
+                    std::copy(leafNode->keyArray + i + 1, leafNode->keyArray + count, leafNode->keyArray + i);
+                    std::copy(leafNode->ridArray + i + 1, leafNode->ridArray + count, leafNode->ridArray + i);
+                    leafNode->header.keyCount = --count;
+                }
+                underflow = (count == 0 || count < leafOccupancy * lowWaterFill);
+                unPinNode(pageNum, true);
+                return true;
+            }
+        }
+        unPinNode(pageNum, false);
+        return false;
+    }
+    
+    NonLeafNode<T>* curNode = (NonLeafNode<T>*)tmpPage;
+    int keyCount = curNode->header.keyCount;
+    ///duplicates of a separator can sit on both sides of it, so the children right of separators equal
+    ///to key are searched too
+    for(int i = childIndex<T>(tmpPage, key, true); i <= keyCount; i++){
+        bool childUnderflow = false;
+        if(deleteFrom(curNode->pageNoArray[i], key, rid, childUnderflow)){
+            curNode->countArray[i]--;
+            if(childUnderflow && keyCount > 0){
+                rebalanceChild(curNode, i);
+            }
+            keyCount = curNode->header.keyCount;
+            underflow = (keyCount == 0 || keyCount < nodeOccupancy * lowWaterFill);
+            unPinNode(pageNum, true);
+            return true;
+        }
+        if(i == keyCount || curNode->keyArray[i] != key) break;
+    }
+    unPinNode(pageNum, false);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceChild
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::rebalanceChild(NonLeafNode<T>* parent, int i)
+{
+    ///pair the child with its right neighbour, or with its left one if it is the last child
+    int left = (i < parent->header.keyCount) ? i : i - 1;
+    PageId leftPageNum = parent->pageNoArray[left];
+    PageId rightPageNum = parent->pageNoArray[left + 1];
+    Page* leftPage;
+    Page* rightPage;
+    readNode(leftPageNum, leftPage);
+    readNode(rightPageNum, rightPage);
+    bool merged;
+    
+    if(packedLeaf(leftPage)){
+        merged = rebalancePacked(leftPage, rightPage, parent->keyArray[left]);
+    }else if(parent->header.level == 1){
+        LeafNode<T>* leftNode = (LeafNode<T>*)leftPage;
+        LeafNode<T>* rightNode = (LeafNode<T>*)rightPage;
+        int leftCount = leftNode->header.keyCount;
+        int rightCount = rightNode->header.keyCount;
+        int total = leftCount + rightCount;
+        
+        ///merge only into a node the next few inserts will not split again right away
+        merged = (total <= nodeFill(leafOccupancy));
+        if(merged){
+            std::copy(rightNode->keyArray, rightNode->keyArray + rightCount, leftNode->keyArray + leftCount);
+            std::copy(rightNode->ridArray, rightNode->ridArray + rightCount, leftNode->ridArray + leftCount);
+            leftNode->header.keyCount = total;
+            leftNode->rightSibPageNo = rightNode->rightSibPageNo;
+        }else{
+            ///even the two out, the separator becomes the first key of the right node
+            int newLeft = total / 2;
+            if(leftCount < newLeft){
+                int move = newLeft - leftCount;
+                std::copy(rightNode->keyArray, rightNode->keyArray + move, leftNode->keyArray + leftCount);
+                std::copy(rightNode->ridArray, rightNode->ridArray + move, leftNode->ridArray + leftCount);
+                std::copy(rightNode->keyArray + move, rightNode->keyArray + rightCount, rightNode->keyArray);
+                std::copy(rightNode->ridArray + move, rightNode->ridArray + rightCount, rightNode->ridArray);
+            }else{
+                int move = leftCount - newLeft;
+                std::copy_backward(rightNode->keyArray, rightNode->keyArray + rightCount, rightNode->keyArray + rightCount + move);
+                std::copy_backward(rightNode->ridArray, rightNode->ridArray + rightCount, rightNode->ridArray + rightCount + move);
+                std::copy(leftNode->keyArray + newLeft, leftNode->keyArray + leftCount, rightNode->keyArray);
+                std::copy(leftNode->ridArray + newLeft, leftNode->ridArray + leftCount, rightNode->ridArray);
+            }
+            leftNode->header.keyCount = newLeft;
+            rightNode->header.keyCount = total - newLeft;
+            parent->keyArray[left] = rightNode->keyArray[0];
+        }
+    }else{
+        NonLeafNode<T>* leftNode = (NonLeafNode<T>*)leftPage;
+        NonLeafNode<T>* rightNode = (NonLeafNode<T>*)rightPage;
+        int leftCount = leftNode->header.keyCount;
+        int rightCount = rightNode->header.keyCount;
+        
+        ///the separator in the parent comes down between the keys of the two nodes
+        std::vector<T> keys(leftNode->keyArray, leftNode->keyArray + leftCount);
+        keys.push_back(parent->keyArray[left]);
+        keys.insert(keys.end(), rightNode->keyArray, rightNode->keyArray + rightCount);
+        std::vector<PageId> children(leftNode->pageNoArray, leftNode->pageNoArray + leftCount + 1);
+        children.insert(children.end(), rightNode->pageNoArray, rightNode->pageNoArray + rightCount + 1);
+        std::vector<std::uint32_t> counts(leftNode->countArray, leftNode->countArray + leftCount + 1);
+        counts.insert(counts.end(), rightNode->countArray, rightNode->countArray + rightCount + 1);
+        int total = (int)keys.size();
+        
+        merged = (total <= nodeFill(nodeOccupancy));
+        int newLeft = merged ? total : total / 2;
+        std::copy(keys.begin(), keys.begin() + newLeft, leftNode->keyArray);
+        std::copy(children.begin(), children.begin() + newLeft + 1, leftNode->pageNoArray);
+        std::copy(counts.begin(), counts.begin() + newLeft + 1, leftNode->countArray);
+        leftNode->header.keyCount = newLeft;
+        if(!merged){
+            ///keys[newLeft] moves back up to the parent
+            std::copy(keys.begin() + newLeft + 1, keys.end(), rightNode->keyArray);
+            std::copy(children.begin() + newLeft + 1, children.end(), rightNode->pageNoArray);
+            std::copy(counts.begin() + newLeft + 1, counts.end(), rightNode->countArray);
+            rightNode->header.keyCount = total - newLeft - 1;
+            parent->keyArray[left] = keys[newLeft];
+            updateDirectory<T>(rightPage);
+        }
+        updateDirectory<T>(leftPage);
+    }
+    
+    parent->countArray[left] = subtreeEntries<T>(leftPage);
+    ///the leaf after a merged pair now follows the left leaf of the two
+    PageId nextLeafNum = (merged && parent->header.level == 1) ? ((LeafNodeInt*)leftPage)->rightSibPageNo : 0;
+    unPinNode(leftPageNum, true);
+    setLeftSibling(nextLeafNum, leftPageNum);
+    if(merged){
+        ///drop the separator and the right node from the parent
+        int keyCount = parent->header.keyCount;
+        std::copy(parent->keyArray + left + 1, parent->keyArray + keyCount, parent->keyArray + left);
+        std::copy(parent->pageNoArray + left + 2, parent->pageNoArray + keyCount + 1, parent->pageNoArray + left + 1);
+        std::copy(parent->countArray + left + 2, parent->countArray + keyCount + 1, parent->countArray + left + 1);
+        parent->header.keyCount = keyCount - 1;
+        freeNode(rightPageNum, rightPage);
+    }else{
+        parent->countArray[left + 1] = subtreeEntries<T>(rightPage);
+        unPinNode(rightPageNum, true);
+    }
+    updateDirectory<T>((Page*)parent);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor -- constructors and destructor
+// -----------------------------------------------------------------------------
+
+BTreeScanCursor::BTreeScanCursor()
+{
+    index = NULL;
+    scanExecuting = false;
+    nextEntry = 0;
+    descending = false;
+    currentPageNum = 0;
+    currentPageData = NULL;
+    leafCopy = NULL;
+    leafPinned = false;
+    readAheadWindow = 0;
+    readAheadLeft = 0;
+    inPosting = false;
+    postingNext = 0;
+    postingNextPage = 0;
+    merging = false;
+    insertNext = insertEnd = 0;
+    deleteFirst = deleteEnd = 0;
+    heldValid = false;
+    rangeNext = 0;
+    rangeStats = RangeScanStats();
+}
+
+BTreeScanCursor::BTreeScanCursor(BTreeScanCursor&& other)
+{
+    ///the pin moves with the scan state, other no longer owns it
+    scanExecuting = false;
+    leafCopy = NULL;
+    *this = std::move(other);
+}
+
+BTreeScanCursor& BTreeScanCursor::operator=(BTreeScanCursor&& other)
+{
+    if(this == &other) return *this;
+    if(scanExecuting) endScan();
+    
+    index = other.index;
+    scanExecuting = other.scanExecuting;
+    nextEntry = other.nextEntry;
+    descending = other.descending;
+    currentPageNum = other.currentPageNum;
+    currentPageData = other.currentPageData;
+    lowValInt = other.lowValInt;
+    lowValDouble = other.lowValDouble;
+    lowValString = other.lowValString;
+    highValInt = other.highValInt;
+    highValDouble = other.highValDouble;
+    highValString = other.highValString;
+    lowOp = other.lowOp;
+    highOp = other.highOp;
+    readAheadWindow = other.readAheadWindow;
+    readAheadLeft = other.readAheadLeft;
+    leafPinned = other.leafPinned;
+    inPosting = other.inPosting;
+    postingRids.swap(other.postingRids);
+    postingNext = other.postingNext;
+    postingNextPage = other.postingNextPage;
+    merging = other.merging;
+    insertNext = other.insertNext;
+    insertEnd = other.insertEnd;
+    deleteFirst = other.deleteFirst;
+    deleteEnd = other.deleteEnd;
+    deleteUsed.swap(other.deleteUsed);
+    heldValid = other.heldValid;
+    heldRid = other.heldRid;
+    rangeValsInt.swap(other.rangeValsInt);
+    rangeValsDouble.swap(other.rangeValsDouble);
+    rangeValsString.swap(other.rangeValsString);
+    rangeOps.swap(other.rangeOps);
+    rangeNext = other.rangeNext;
+    descentPath.swap(other.descentPath);
+    rangeStats = other.rangeStats;
+    delete leafCopy;
+    leafCopy = other.leafCopy;
+    other.leafCopy = NULL;
+    
+    other.scanExecuting = false;
+    other.currentPageNum = 0;
+    other.currentPageData = NULL;
+    other.nextEntry = 0;
+    other.inPosting = false;
+    other.merging = false;
+    other.heldValid = false;
+    return *this;
+}
+
+BTreeScanCursor::~BTreeScanCursor()
+{
+    try{
+        if(scanExecuting) endScan();
+    }catch(BadgerDbException e){
+        ///destructor must not throw
+    }
+    delete leafCopy;
+}
+
+bool BTreeScanCursor::isOpen() const
+{
+    return scanExecuting;
+}
+
+size_t BTreeScanCursor::rangeIndex() const
+{
+    ///rangeNext moves past a range as the range starts, and the entry after the last one of a range is
+    ///only looked for once the next range has started
+    return rangeNext > 0 ? rangeNext - 1 : 0;
+}
+
+const RangeScanStats& BTreeScanCursor::rangeScanStats() const
+{
+    return rangeStats;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::scanHighVal / scanLowVal / setScanRange
+// -----------------------------------------------------------------------------
+
+template <>
+int BTreeScanCursor::scanHighVal<int>() const { return highValInt; }
+
+template <>
+double BTreeScanCursor::scanHighVal<double>() const { return highValDouble; }
+
+template <>
+StringKey BTreeScanCursor::scanHighVal<StringKey>() const { return highValString; }
+
+template <>
+int BTreeScanCursor::scanLowVal<int>() const { return lowValInt; }
+
+template <>
+double BTreeScanCursor::scanLowVal<double>() const { return lowValDouble; }
+
+template <>
+StringKey BTreeScanCursor::scanLowVal<StringKey>() const { return lowValString; }
+
+template <>
+void BTreeScanCursor::setScanRange<int>(int lowVal, int highVal)
+{
+    lowValInt = lowVal;
+    highValInt = highVal;
+}
+
+template <>
+void BTreeScanCursor::setScanRange<double>(double lowVal, double highVal)
+{
+    lowValDouble = lowVal;
+    highValDouble = highVal;
+}
+
+template <>
+void BTreeScanCursor::setScanRange<StringKey>(StringKey lowVal, StringKey highVal)
+{
+    lowValString = lowVal;
+    highValString = highVal;
+}
+
+template <>
+std::vector<int>& BTreeScanCursor::rangeVals<int>() { return rangeValsInt; }
+
+template <>
+std::vector<double>& BTreeScanCursor::rangeVals<double>() { return rangeValsDouble; }
+
+template <>
+std::vector<StringKey>& BTreeScanCursor::rangeVals<StringKey>() { return rangeValsString; }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::lookup(const void* key, RecordId* out, size_t max)
+{
+    checkUpperCache();
+    if(max == 0) return 0;
+    switch(attributeType){
+    case INTEGER: return lookupMerged<int>(keyFromPointer<int>(key), out, max);
+    case DOUBLE: return lookupMerged<double>(keyFromPointer<double>(key), out, max);
+    case STRING: return lookupMerged<StringKey>(keyFromPointer<StringKey>(key), out, max);
+    }
+    return 0;
+}
+
+template <class T>
+size_t BTreeIndex::lookupKey(const T& key, RecordId* out, size_t max)
+{
+    if(max == 0) return 0;
+    
+    ///separators equal to key send the descent left, its first entries may be at the end of the left child
+    Page leafCopy;
+    Page* leaf;
+    PageId pageNum;
+    readLeaf<T>(key, true, pageNum, leaf, &leafCopy);
+    
+    size_t n = 0;
+    while(1){
+        int first = leafBound<T>(leaf, key, true);
+        int last = leafBound<T>(leaf, key, false);
+        n += copyLeafRids<T>(leaf, first, last, out + n, max - n);
+        
+        ///entries of the key may go on in the right sibling only if they reach the end of this leaf
+        if(last < ((NodeHeader*)leaf)->keyCount || ((LeafNodeInt*)leaf)->rightSibPageNo == 0 || n == max) break;
+        nextLeaf(pageNum, leaf, &leafCopy);
+    }
+    releaseLeaf(pageNum);
+    return n;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readLeaf / nextLeaf / releaseLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::readLeaf(const T& key, bool lower, PageId& pageNum, Page*& leaf, Page* copy)
+{
+    ///in thread-safe mode the leaves are read from copies, like the leaves of a cursor
+    if(threadSafe){
+        std::vector<LatchedNode> path;
+        std::uint64_t rootVersion, treeVersion;
+        while(!optimisticPath(key, lower, path, rootVersion, treeVersion, copy)){}
+        pageNum = path.back().pageNum;
+        leaf = copy;
+        return;
+    }
+    
+    pageNum = rootPageNum;
+    if(!isRootALeaf){
+        while(1){
+            Page* tmpPage;
+            readNode(pageNum, tmpPage);
+            PageId nextPageNum = childFor<T>(tmpPage, key, lower);
+            bool childIsLeaf = (((NodeHeader*)tmpPage)->level == 1);
+            unPinNode(pageNum, false);
+            pageNum = nextPageNum;
+            if(childIsLeaf) break;
+        }
+    }
+    readNode(pageNum, leaf);
+}
+
+void BTreeIndex::nextLeaf(PageId& pageNum, Page*& leaf, Page* copy, bool left)
+{
+    ///leftSibPageNo is at the same place in every leaf layout
+    PageId nextPageNum = left ? ((LeafNodeInt*)leaf)->leftSibPageNo : ((LeafNodeInt*)leaf)->rightSibPageNo;
+    releaseLeaf(pageNum);
+    pageNum = nextPageNum;
+    if(threadSafe){
+        VersionLatch& latch = nodeLatches->latch(pageNum);
+        while(!copyNode(pageNum, latch.readLock(), treeLatch.readLock(), copy)){}
+        leaf = copy;
+    }else{
+        readNode(pageNum, leaf);
+    }
+}
+
+void BTreeIndex::releaseLeaf(PageId pageNum)
+{
+    if(!threadSafe) unPinNode(pageNum, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::countRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+    if (lowOpParm != GT && lowOpParm != GTE) {
+        throw BadOpcodesException();
+    }
+    else if (highOpParm != LT && highOpParm != LTE) {
+        throw BadOpcodesException();
+    }
+    checkUpperCache();
+
+    switch(attributeType){
+    case INTEGER: return countKeys<int>(lowValParm, lowOpParm, highValParm, highOpParm);
+    case DOUBLE: return countKeys<double>(lowValParm, lowOpParm, highValParm, highOpParm);
+    case STRING: return countKeys<StringKey>(lowValParm, lowOpParm, highValParm, highOpParm);
+    }
+    return 0;
+}
+
+template <class T>
+size_t BTreeIndex::countKeys(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+    T lowVal = keyFromPointer<T>(lowValParm);
+    T highVal = keyFromPointer<T>(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+    
+    Page leafCopy;
+    Page* leaf;
+    PageId pageNum;
+    readLeaf<T>(lowVal, lowOpParm == GTE, pageNum, leaf, &leafCopy);
+    int first = leafBound<T>(leaf, lowVal, lowOpParm == GTE);
+    
+    size_t total = 0;
+    while(1){
+        ///a leaf whose last key is in range counts whole, only the leaf the range ends in is searched
+        int count = ((NodeHeader*)leaf)->keyCount;
+        if(first < count){
+            int last = compareLeafKey<T>(leaf, count - 1, highVal);
+            if(last > 0 || (last == 0 && highOpParm == LT)){
+                int end = leafBound<T>(leaf, highVal, highOpParm == LT);
+                total += leafEntries<T>(leaf, first, end);
+                break;
+            }
+            total += leafEntries<T>(leaf, first, count);
+        }
+        if(((LeafNodeInt*)leaf)->rightSibPageNo == 0) break;
+        nextLeaf(pageNum, leaf, &leafCopy);
+        first = 0;
+    }
+    releaseLeaf(pageNum);
+    ///every buffered delete is of an entry the leaves hold, so the total cannot go below 0
+    return total + bufferedInRange<T>(lowVal, lowOpParm, highVal, highOpParm);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+
+double BTreeIndex::estimateRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+    if (lowOpParm != GT && lowOpParm != GTE) {
+        throw BadOpcodesException();
+    }
+    else if (highOpParm != LT && highOpParm != LTE) {
+        throw BadOpcodesException();
+    }
+    checkUpperCache();
+
+    switch(attributeType){
+    case INTEGER: return estimateKeys<int>(lowValParm, lowOpParm, highValParm, highOpParm);
+    case DOUBLE: return estimateKeys<double>(lowValParm, lowOpParm, highValParm, highOpParm);
+    case STRING: return estimateKeys<StringKey>(lowValParm, lowOpParm, highValParm, highOpParm);
+    }
+    return 0;
+}
+
+template <class T>
+double BTreeIndex::estimateKeys(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+    T lowVal = keyFromPointer<T>(lowValParm);
+    T highVal = keyFromPointer<T>(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+    
+    ///the range holds the entries before the high bound that are not before the low bound
+    double low, high;
+    while(!estimateRank<T>(lowVal, lowOpParm == GTE, low)){}
+    while(!estimateRank<T>(highVal, highOpParm == LT, high)){}
+    return std::max(high - low + bufferedInRange<T>(lowVal, lowOpParm, highVal, highOpParm), 0.0);
+}
+
+///share of the entries under child i of a non-leaf node that are below key, assuming the keys are
+///spread evenly between the separators around the child. A child at either end has only one of them
+template <class T>
+static double childShare(const Page* node, int i, const T& key)
+{
+    const NonLeafNode<T>* nonLeafNode = (const NonLeafNode<T>*)node;
+    if(i == 0 || i == nonLeafNode->header.keyCount) return 0.5;
+    double low = nonLeafNode->keyArray[i-1];
+    double high = nonLeafNode->keyArray[i];
+    if(!(high > low)) return 0.5;
+    return std::max(0.0, std::min(((double)key - low) / (high - low), 1.0));
+}
+
+template <>
+double childShare<StringKey>(const Page* node, int i, const StringKey& key)
+{
+    return 0.5;
+}
+
+template <class T>
+bool BTreeIndex::estimateRank(const T& key, bool lower, double& rank)
+{
+    rank = 0;
+    std::uint64_t treeVersion = 0;
+    std::uint64_t version = 0;
+    PageId pageNum = rootPageNum;
+    if(threadSafe){
+        treeVersion = treeLatch.readLock();
+        std::uint64_t rootVersion = rootLatch.readLock();
+        pageNum = __atomic_load_n(&rootPageNum, __ATOMIC_ACQUIRE);
+        version = nodeLatches->latch(pageNum).readLock();
+        if(!rootLatch.validate(rootVersion)) return false;
+    }
+    
+    ///in thread-safe mode nodes are looked at in copies that passed validation, like optimisticPath
+    Page copy;
+    while(1){
+        Page* node = &copy;
+        if(threadSafe){
+            if(!copyNode(pageNum, version, treeVersion, &copy)) return false;
+        }else readNode(pageNum, node);
+        
+        const NodeHeader* header = (const NodeHeader*)node;
+        bool leaf = isLeafNode(node);
+        bool bottom = leaf || header->level == 1;
+        bool countLeaf = false;
+        PageId childNum = 0;
+        if(leaf){
+            ///only a root leaf or a leaf with posting lists is read, it is counted exactly
+            rank += leafEntries<T>(node, 0, leafBound<T>(node, key, lower));
+        }else{
+            int i = childIndex<T>(node, key, lower);
+            const std::uint32_t* counts = childCounts<T>(node);
+            rank += std::accumulate(counts, counts + i, 0.0);
+            childNum = childAt<T>(node, i);
+            ///the leaf the key falls in is not read, the entries below the key are interpolated. A leaf
+            ///with more entries than slots holds posting lists, whose entries all sit at one key and would
+            ///be spread over the whole leaf, so that leaf is read and counted exactly instead
+            countLeaf = bottom && counts[i] > (std::uint32_t)leafOccupancy;
+            if(bottom && !countLeaf) rank += childShare<T>(node, i, key) * counts[i];
+        }
+        if(!threadSafe) unPinNode(pageNum, false);
+        ///the sizes of posting lists are read outside the copy, they only change in exclusive operations
+        if(leaf) return !threadSafe || treeLatch.validate(treeVersion);
+        if(bottom && !countLeaf) return true;
+        
+        if(threadSafe){
+            std::uint64_t childVersion = nodeLatches->latch(childNum).readLock();
+            if(!nodeLatches->latch(pageNum).validate(version)) return false;
+            version = childVersion;
+        }
+        pageNum = childNum;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::minKey / maxKey
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::minKey(void* out)
+{
+    checkUpperCache();
+    switch(attributeType){
+    case INTEGER: return edgeKey<int>(false, out);
+    case DOUBLE: return edgeKey<double>(false, out);
+    case STRING: return edgeKey<StringKey>(false, out);
+    }
+    return false;
+}
+
+bool BTreeIndex::maxKey(void* out)
+{
+    checkUpperCache();
+    switch(attributeType){
+    case INTEGER: return edgeKey<int>(true, out);
+    case DOUBLE: return edgeKey<double>(true, out);
+    case STRING: return edgeKey<StringKey>(true, out);
+    }
+    return false;
+}
+
+template <class T>
+bool BTreeIndex::edgeKey(bool max, void* out)
+{
+    ///a key past every key sends the descent down the leftmost or the rightmost path
+    Page leafCopy;
+    Page* leaf;
+    PageId pageNum;
+    readLeaf<T>(max ? highestKey<T>() : lowestKey<T>(), !max, pageNum, leaf, &leafCopy);
+    
+    ///only deletes leave an edge leaf empty. The smallest key is then on the first leaf to its right that has
+    ///keys, the largest is found by walking all leaves from the left
+    if(max && ((NodeHeader*)leaf)->keyCount == 0){
+        releaseLeaf(pageNum);
+        readLeaf<T>(lowestKey<T>(), true, pageNum, leaf, &leafCopy);
+    }
+    bool found = false;
+    T key = T();
+    while(1){
+        int count = ((NodeHeader*)leaf)->keyCount;
+        if(count > 0){
+            key = leafKeyAt<T>(leaf, max ? count - 1 : 0);
+            found = true;
+            if(!max) break;
+        }
+        if(((LeafNodeInt*)leaf)->rightSibPageNo == 0) break;
+        nextLeaf(pageNum, leaf, &leafCopy);
+    }
+    releaseLeaf(pageNum);
+    
+    ///buffered deletes may take every entry of the key, buffered inserts may go past it
+    const WriteBuffer<T>& buffer = sortedMessages<T>();
+    if(found && !buffer.deletes.empty() && countKeys<T>(&key, GTE, &key, LTE) == 0) found = liveEdgeKey<T>(max, key);
+    if(!buffer.inserts.empty()){
+        const T& insertKey = max ? buffer.inserts.back().key : buffer.inserts.front().key;
+        if(!found || (max ? key < insertKey : insertKey < key)) key = insertKey;
+        found = true;
+    }
+    if(found) keyToPointer<T>(key, out);
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::openScan
+// -----------------------------------------------------------------------------
+
+BTreeScanCursor BTreeIndex::openScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const bool descending)
+{
+    BTreeScanCursor cursor;
+    openCursor(cursor, lowValParm, lowOpParm, highValParm, highOpParm, descending);
+    return cursor;
+}
+
+BTreeScanCursor BTreeIndex::openScan(const ScanRange* ranges, size_t numRanges)
+{
+    BTreeScanCursor cursor;
+    checkUpperCache();
+    switch(attributeType){
+    case INTEGER: positionRanges<int>(cursor, ranges, numRanges); break;
+    case DOUBLE: positionRanges<double>(cursor, ranges, numRanges); break;
+    case STRING: positionRanges<StringKey>(cursor, ranges, numRanges); break;
+    }
+    return cursor;
+}
+
+Datatype BTreeIndex::keyType() const
+{
+    return attributeType;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::makeKey / openPrefixScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::makeKey(const void* const* values, int numValues, char* out) const
+{
+    if(keyColumns.empty() || numValues < 0 || numValues > (int)keyColumns.size()){
+        throw BadScanParamException();
+    }
+    compositekey::encodeValues(keyColumns.data(), numValues, values, out);
+}
+
+BTreeScanCursor BTreeIndex::openPrefixScan(const void* const* values, int numValues)
+{
+    char lowVal[STRINGSIZE + 1];
+    char highVal[STRINGSIZE + 1];
+    makeKey(values, numValues, lowVal);
+    
+    ///every key that starts with the prefix is at most the prefix followed by the largest bytes
+    size_t len = strlen(lowVal);
+    memcpy(highVal, lowVal, len);
+    memset(highVal + len, 0xff, STRINGSIZE - len);
+    highVal[STRINGSIZE] = '\0';
+    return openScan(lowVal, GTE, highVal, LTE);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+    openCursor(scanCursor, lowValParm, lowOpParm, highValParm, highOpParm, false);
+}
+
+void BTreeIndex::openCursor(BTreeScanCursor& cursor,
+				   const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const bool descending)
+{
+	// check low and high operators are correct, if not, throw BadOpCodeException error
+	if (lowOpParm != GT && lowOpParm != GTE) {
+		throw BadOpcodesException();
+	}
+    else if (highOpParm != LT && highOpParm != LTE) {
+        throw BadOpcodesException();
+    }
+    checkUpperCache();
+
+    cursor.descending = descending;
+    switch(attributeType){
+    case INTEGER: positionScan<int>(cursor, lowValParm, lowOpParm, highValParm, highOpParm); break;
+    case DOUBLE: positionScan<double>(cursor, lowValParm, lowOpParm, highValParm, highOpParm); break;
+    case STRING: positionScan<StringKey>(cursor, lowValParm, lowOpParm, highValParm, highOpParm); break;
+    }
+}
+
+template <class T>
+void BTreeIndex::positionShared(BTreeScanCursor& cursor, const T& lowVal, bool lower)
+{
+    ///the leaf is copied rather than pinned, other threads may change it while the cursor is on it
+    if(cursor.leafCopy == NULL) cursor.leafCopy = new Page();
+    std::vector<LatchedNode> path;
+    std::uint64_t rootVersion, treeVersion;
+    while(!optimisticPath(lowVal, lower, path, rootVersion, treeVersion, cursor.leafCopy)){}
+    
+    cursor.currentPageNum = path.back().pageNum;
+    cursor.currentPageData = cursor.leafCopy;
+    cursor.leafPinned = false;
+    cursor.rangeStats.nodeReads += path.size() - 1;
+}
+
+template <class T>
+void BTreeIndex::positionDescending(BTreeScanCursor& cursor, const T& lowVal, const T& highVal)
+{
+    ///descend to the leaf that holds the last key in range.
+    ///for LTE a separator equal to highVal sends us right since duplicates of it may sit in the right child
+    if(threadSafe && cursor.leafCopy == NULL) cursor.leafCopy = new Page();
+    readLeaf<T>(highVal, cursor.highOp == LT, cursor.currentPageNum, cursor.currentPageData, cursor.leafCopy);
+    cursor.leafPinned = !threadSafe;
+    cursor.nextEntry = leafBound<T>(cursor.currentPageData, highVal, cursor.highOp == LT) - 1;
+    
+    ///the last entry is looked for now, through the merge with the write buffer like every other one
+    mergeMessages<T>(cursor, lowVal, highVal);
+    cursor.heldValid = cursor.mergeNext<T>(cursor.heldRid);
+    if(!cursor.heldValid){
+        cursor.endScan();
+        throw NoSuchKeyFoundException();
+    }
+}
+
+template <class T>
+void BTreeIndex::positionScan(BTreeScanCursor& cursor, const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	// check value search range is valid, ie low value <= high value
+    T lowVal = keyFromPointer<T>(lowValParm);
+    T highVal = keyFromPointer<T>(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+
+    // If another scan is already executing on this cursor, that needs to be ended here
+    if (cursor.scanExecuting) {
+        cursor.endScan();
+    }
+    
+
+    cursor.index = this;
+    cursor.scanExecuting = true;
+    cursor.setScanRange<T>(lowVal, highVal);
+    cursor.lowOp = lowOpParm;
+    cursor.highOp = highOpParm;
+    cursor.readAheadWindow = 0;
+    cursor.readAheadLeft = 0;
+    if(cursor.descending){
+        positionDescending<T>(cursor, lowVal, highVal);
+        return;
+    }
+    
+    ///descend to the leaf that holds the first key in range.
+    ///for GTE a separator equal to lowVal sends us left since duplicates of it may sit in the left child
+    if(threadSafe){
+        positionShared<T>(cursor, lowVal, lowOpParm == GTE);
+    }else{
+        PageId pageNum = rootPageNum;
+        if(!isRootALeaf){
+            while(1){
+                Page* tmpPage;
+                readNode(pageNum, tmpPage);
+                NonLeafNode<T>* curNode = (NonLeafNode<T>*)tmpPage;
+                int i = childIndex<T>(tmpPage, lowVal, lowOpParm == GTE);
+                PageId nextPageNum = curNode->pageNoArray[i];
+                bool childIsLeaf = (curNode->header.level == 1);
+                unPinNode(pageNum, false);
+                pageNum = nextPageNum;
+                if(childIsLeaf) break;
+            }
+        }
+        
+        cursor.currentPageNum = pageNum;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        cursor.leafPinned = true;
+    }
+    LeafNode<T>* leafNode = (LeafNode<T>*)cursor.currentPageData;
+    int count = leafNode->header.keyCount;
+    cursor.nextEntry = leafBound<T>(cursor.currentPageData, lowVal, lowOpParm == GTE);
+    
+    ///every key of this leaf is below the range, the first match can only be on the right sibling
+    while(cursor.nextEntry >= count && leafNode->rightSibPageNo != 0){
+        PageId nextPageNum = leafNode->rightSibPageNo;
+        cursor.moveRight(nextPageNum);
+        leafNode = (LeafNode<T>*)cursor.currentPageData;
+        count = leafNode->header.keyCount;
+    }
+    
+    ///with messages in range the first entry is looked for now, the buffered deletes may hide every entry
+    mergeMessages<T>(cursor, lowVal, highVal);
+    if(cursor.merging){
+        cursor.heldValid = cursor.mergeNext<T>(cursor.heldRid);
+        if(!cursor.heldValid){
+            cursor.endScan();
+            throw NoSuchKeyFoundException();
+        }
+    }else if(cursor.nextEntry >= count || cursor.pastHighBound<T>(leafKeyAt<T>(cursor.currentPageData, cursor.nextEntry))){
+        cursor.endScan();
+        throw NoSuchKeyFoundException();
+    }
+    cursor.readAheadLeaves<T>();
+
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::positionRanges / skipTo
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::positionRanges(BTreeScanCursor& cursor, const ScanRange* ranges, size_t numRanges)
+{
+    std::vector<T> vals;
+    std::vector<Operator> ops;
+    for(size_t i = 0; i < numRanges; i++){
+        const ScanRange& range = ranges[i];
+        if((range.lowOp != GT && range.lowOp != GTE) || (range.highOp != LT && range.highOp != LTE)){
+            throw BadOpcodesException();
+        }
+        T lowVal = keyFromPointer<T>(range.lowVal);
+        T highVal = keyFromPointer<T>(range.highVal);
+        if(lowVal > highVal){
+            throw BadScanrangeException();
+        }
+        ///a range may start at the key the one before it ends at only if one of them leaves it out
+        if(!vals.empty() && (lowVal < vals.back() || (lowVal == vals.back() && ops.back() == LTE && range.lowOp == GTE))){
+            throw BadScanrangeException();
+        }
+        ///a range of one key that leaves the key out holds nothing. Leaving it out keeps every stored
+        ///range ending at or after the position it starts at
+        if(lowVal == highVal && (range.lowOp == GT || range.highOp == LT)) continue;
+        vals.push_back(lowVal);
+        vals.push_back(highVal);
+        ops.push_back(range.lowOp);
+        ops.push_back(range.highOp);
+    }
+    
+    cursor.index = this;
+    cursor.scanExecuting = true;
+    cursor.descending = false;
+    cursor.readAheadWindow = 0;
+    cursor.readAheadLeft = 0;
+    cursor.rangeVals<T>().swap(vals);
+    cursor.rangeOps.swap(ops);
+    cursor.rangeNext = 0;
+    cursor.rangeStats = RangeScanStats();
+    if(!cursor.nextRangeFor<T>()){
+        cursor.endScan();
+        throw NoSuchKeyFoundException();
+    }
+}
+
+template <class T>
+void BTreeIndex::skipTo(BTreeScanCursor& cursor, const T& key, bool lower)
+{
+    ///other threads may change the nodes above the leaves, so thread-safe cursors start from the root
+    cursor.rangeStats.descents++;
+    cursor.rangeStats.leafReads++;
+    if(threadSafe){
+        positionShared<T>(cursor, key, lower);
+        cursor.nextEntry = leafBound<T>(cursor.currentPageData, key, lower);
+        return;
+    }
+    
+    ///a child before the last one of a node ends at the separator after it, so a key that does not pass
+    ///that separator is in the subtree of the node. The last child may end anywhere up to the separator
+    ///of the node in its parent, so for a key past every separator we climb
+    std::vector<PageId>& path = cursor.descentPath;
+    while(path.size() > 1){
+        Page* tmpPage;
+        readNode(path.back(), tmpPage);
+        cursor.rangeStats.nodeReads++;
+        bool inside = childIndex<T>(tmpPage, key, lower) < ((NodeHeader*)tmpPage)->keyCount;
+        unPinNode(path.back(), false);
+        if(inside) break;
+        path.pop_back();
+    }
+    
+    PageId pageNum = rootPageNum;
+    if(!path.empty()){
+        pageNum = path.back();
+        path.pop_back();
+    }
+    if(!isRootALeaf){
+        while(1){
+            path.push_back(pageNum);
+            Page* tmpPage;
+            readNode(pageNum, tmpPage);
+            cursor.rangeStats.nodeReads++;
+            PageId nextPageNum = childFor<T>(tmpPage, key, lower);
+            bool childIsLeaf = (((NodeHeader*)tmpPage)->level == 1);
+            unPinNode(pageNum, false);
+            pageNum = nextPageNum;
+            if(childIsLeaf) break;
+        }
+    }
+    
+    if(cursor.leafPinned) bufMgr->unPinPage(file, cursor.currentPageNum, false);
+    cursor.currentPageNum = pageNum;
+    bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+    cursor.leafPinned = true;
+    cursor.nextEntry = leafBound<T>(cursor.currentPageData, key, lower);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::nextRange / seekRange
+// -----------------------------------------------------------------------------
+
+bool BTreeScanCursor::nextRange()
+{
+    if(rangeNext >= rangeOps.size() / 2) return false;
+    switch(index->attributeType){
+    case INTEGER: return nextRangeFor<int>();
+    case DOUBLE: return nextRangeFor<double>();
+    case STRING: return nextRangeFor<StringKey>();
+    }
+    return false;
+}
+
+template <class T>
+bool BTreeScanCursor::nextRangeFor()
+{
+    const std::vector<T>& vals = rangeVals<T>();
+    while(rangeNext < rangeOps.size() / 2){
+        size_t range = rangeNext++;
+        setScanRange<T>(vals[2 * range], vals[2 * range + 1]);
+        lowOp = rangeOps[2 * range];
+        highOp = rangeOps[2 * range + 1];
+        if(seekRange<T>()) return true;
+    }
+    return false;
+}
+
+template <class T>
+bool BTreeScanCursor::seekRange()
+{
+    const T lowVal = scanLowVal<T>();
+    const bool lower = (lowOp == GTE);
+    
+    ///the entries before nextEntry belong to earlier ranges, so a range that reaches the last key of the
+    ///leaf starts at or after nextEntry
+    int count = (currentPageData != NULL) ? ((NodeHeader*)currentPageData)->keyCount : 0;
+    rangeStats.ranges++;
+    if(count > 0 && !pastLowBound<T>(leafKeyAt<T>(currentPageData, count - 1))){
+        nextEntry = std::max(nextEntry, leafBound<T>(currentPageData, lowVal, lower));
+        rangeStats.leafHits++;
+    }else{
+        index->skipTo<T>(*this, lowVal, lower);
+        readAheadWindow = 0;
+        readAheadLeft = 0;
+    }
+    
+    while(nextEntry >= ((NodeHeader*)currentPageData)->keyCount){
+        PageId nextPageNum = ((LeafNodeInt*)currentPageData)->rightSibPageNo;
+        if(nextPageNum == 0) break;
+        moveRight(nextPageNum);
+    }
+    
+    index->mergeMessages<T>(*this, lowVal, scanHighVal<T>());
+    bool found;
+    if(merging){
+        heldValid = mergeNext<T>(heldRid);
+        found = heldValid;
+    }else{
+        found = nextEntry < ((NodeHeader*)currentPageData)->keyCount && !pastHighBound<T>(leafKeyAt<T>(currentPageData, nextEntry));
+    }
+    if(found) readAheadLeaves<T>();
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNext(RecordId& outRid) 
+{
+    scanCursor.scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeScanCursor::scanNext(RecordId& outRid) 
+{
+    //check if this is called before the scan was opened
+    if(scanExecuting == false){throw ScanNotInitializedException();}
+
+    ///the end of a range is not the end of a multi-range scan, the batch path moves on to the next one
+    if(!rangeOps.empty()){
+        if(scanNextBatch(&outRid, 1) == 0){throw IndexScanCompletedException();}
+        return;
+    }
+
+    if(merging || descending){
+        if(!mergedNext(outRid)){throw IndexScanCompletedException();}
+        return;
+    }
+
+    switch(index->attributeType){
+    case INTEGER: scanNextEntry<int>(outRid); break;
+    case DOUBLE: scanNextEntry<double>(outRid); break;
+    case STRING: scanNextEntry<StringKey>(outRid); break;
+    }
+}
+
+template <class T>
+void BTreeScanCursor::scanNextEntry(RecordId& outRid)
+{
+    LeafNode<T>* leafNode = (LeafNode<T>*)currentPageData;
+
+    while(1){
+        //check if end of page. if yes unpin then read the right sibling
+        while(nextEntry >= leafNode->header.keyCount){
+            PageId nextPageNum = leafNode->rightSibPageNo;
+            if(nextPageNum == 0){throw IndexScanCompletedException();}
+
+            moveRight(nextPageNum);
+            leafNode = (LeafNode<T>*)currentPageData;
+            readAheadLeaves<T>();
+        }
+
+        //keys are sorted, so the first key past the high bound ends the scan
+        if(pastHighBound<T>(leafKeyAt<T>(currentPageData, nextEntry))){throw IndexScanCompletedException();}
+
+        RecordId rid = leafRidAt<T>(currentPageData, nextEntry);
+        if(!postinglist::isList(rid)){
+            outRid = rid;
+            nextEntry++;
+            return;
+        }
+        if(nextPostingRid(rid.page_number, outRid)) return;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::nextPostingRid
+// -----------------------------------------------------------------------------
+
+bool BTreeScanCursor::nextPostingRid(PageId firstPageNum, RecordId& outRid)
+{
+    if(!inPosting){
+        postingNextPage = index->loadPosting(firstPageNum, postingRids);
+        postingNext = 0;
+        inPosting = true;
+    }
+    while(postingNext == postingRids.size()){
+        if(postingNextPage == 0){
+            inPosting = false;
+            nextEntry += descending ? -1 : 1;
+            return false;
+        }
+        postingNextPage = index->loadPosting(postingNextPage, postingRids);
+        postingNext = 0;
+    }
+    outRid = postingRids[postingNext++];
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::mergedNext
+// -----------------------------------------------------------------------------
+
+bool BTreeScanCursor::mergedNext(RecordId& outRid)
+{
+    if(heldValid){
+        outRid = heldRid;
+        heldValid = false;
+        return true;
+    }
+    switch(index->attributeType){
+    case INTEGER: return mergeNext<int>(outRid);
+    case DOUBLE: return mergeNext<double>(outRid);
+    case STRING: return mergeNext<StringKey>(outRid);
+    }
+    return false;
+}
+
+template <class T>
+bool BTreeScanCursor::mergeNext(RecordId& outRid)
+{
+    const std::vector<RIDKeyPair<T> >& inserts = index->sortedMessages<T>().inserts;
+    while(1){
+        bool inTree = treeHasNext<T>();
+        T key = inTree ? leafKeyAt<T>(currentPageData, nextEntry) : T();
+        ///a descending scan takes the buffered inserts from the back
+        if(insertNext < insertEnd){
+            const RIDKeyPair<T>& insert = descending ? inserts[insertEnd - 1] : inserts[insertNext];
+            if(!inTree || (descending ? key < insert.key : insert.key < key)){
+                outRid = insert.rid;
+                if(descending) insertEnd--;
+                else insertNext++;
+                return true;
+            }
+        }
+        if(!inTree) return false;
+        
+        RecordId rid = leafRidAt<T>(currentPageData, nextEntry);
+        if(!postinglist::isList(rid)) nextEntry += descending ? -1 : 1;
+        else if(!nextPostingRid(rid.page_number, rid)) continue;
+        if(!takeDelete<T>(key, rid)){
+            outRid = rid;
+            return true;
+        }
+    }
+}
+
+template <class T>
+bool BTreeScanCursor::treeHasNext()
+{
+    if(descending){
+        while(nextEntry < 0){
+            PageId prevPageNum = ((LeafNodeInt*)currentPageData)->leftSibPageNo;
+            if(prevPageNum == 0) return false;
+            moveLeft(prevPageNum);
+        }
+        return !pastLowBound<T>(leafKeyAt<T>(currentPageData, nextEntry));
+    }
+    while(nextEntry >= ((NodeHeader*)currentPageData)->keyCount){
+        PageId nextPageNum = ((LeafNodeInt*)currentPageData)->rightSibPageNo;
+        if(nextPageNum == 0) return false;
+        moveRight(nextPageNum);
+        readAheadLeaves<T>();
+    }
+    return !pastHighBound<T>(leafKeyAt<T>(currentPageData, nextEntry));
+}
+
+template <class T>
+bool BTreeScanCursor::takeDelete(const T& key, const RecordId& rid)
+{
+    const std::vector<RIDKeyPair<T> >& deletes = index->sortedMessages<T>().deletes;
+    size_t i = std::lower_bound(deletes.begin() + deleteFirst, deletes.begin() + deleteEnd, key, entryKeyLess<T>) - deletes.begin();
+    for(; i < deleteEnd && deletes[i].key == key; i++){
+        if(!deleteUsed[i - deleteFirst] && deletes[i].rid == rid){
+            deleteUsed[i - deleteFirst] = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::scanNextBatch(RecordId* out, size_t max)
+{
+    return scanCursor.scanNextBatch(out, max);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+
+size_t BTreeScanCursor::scanNextBatch(RecordId* out, size_t max)
+{
+    //check if this is called before the scan was opened
+    if(scanExecuting == false){throw ScanNotInitializedException();}
+
+    ///a range is done once it returns fewer entries than asked for. A multi-range scan then goes on
+    ///with its next range, whose messages may call for the other path
+    size_t n = 0;
+    do{
+        ///merged and descending entries come one at a time, a leaf cannot be copied out whole
+        if(merging || descending){
+            while(n < max && mergedNext(out[n])) n++;
+            continue;
+        }
+        switch(index->attributeType){
+        case INTEGER: n += scanNextBatchEntries<int>(out + n, max - n); break;
+        case DOUBLE: n += scanNextBatchEntries<double>(out + n, max - n); break;
+        case STRING: n += scanNextBatchEntries<StringKey>(out + n, max - n); break;
+        }
+    }while(n < max && nextRange());
+    return n;
+}
+
+template <class T>
+size_t BTreeScanCursor::scanNextBatchEntries(RecordId* out, size_t max)
+{
+    LeafNode<T>* leafNode = (LeafNode<T>*)currentPageData;
+    const T highVal = scanHighVal<T>();
+    size_t n = 0;
+
+    while(n < max){
+        int count = leafNode->header.keyCount;
+        if(nextEntry >= count){
+            PageId nextPageNum = leafNode->rightSibPageNo;
+            if(nextPageNum == 0) break;
+
+            moveRight(nextPageNum);
+            leafNode = (LeafNode<T>*)currentPageData;
+            readAheadLeaves<T>();
+            continue;
+        }
+
+        ///entries in range end where the high bound falls in this leaf, the whole rest of it if the last key is in range
+        int limit = count;
+        if(pastHighBound<T>(leafKeyAt<T>(currentPageData, count - 1))){
+            limit = leafBound<T>(currentPageData, highVal, highOp == LT);
+        }
+
+        while(n < max && nextEntry < limit){
+            if(inPosting){
+                if(nextPostingRid(leafRidAt<T>(currentPageData, nextEntry).page_number, out[n])) n++;
+                continue;
+            }
+            ///entries are copied, or unpacked, in one go and kept up to the first posting list among them
+            int end = nextEntry + (int)std::min((size_t)(limit - nextEntry), max - n);
+            leafRids<T>(currentPageData, nextEntry, end, out + n);
+            int stop = nextEntry;
+            while(stop < end && !postinglist::isList(out[n + stop - nextEntry])) stop++;
+            n += stop - nextEntry;
+            nextEntry = stop;
+            if(stop < end && nextPostingRid(out[n].page_number, out[n])) n++;
+        }
+
+        ///stopped by the high bound, nothing further right can be in range
+        if(nextEntry == limit && limit < count) break;
+    }
+
+    return n;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setReadAhead / requestReadAhead
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setReadAhead(int maxPages)
+{
+    readAheadPages = std::max(maxPages, 0);
+    if(readAheadPages == 0){
+        delete readAhead;
+        readAhead = NULL;
+    }else if(threadSafe && readAhead == NULL){
+        ///the same as in setThreadSafe, scans on several threads must not both create the worker
+        readAhead = new ReadAhead(bufMgr, file, treeLatch, *nodeLatches);
+    }
+}
+
+void BTreeIndex::requestReadAhead(PageId pageNum, int numPages)
+{
+    if(readAhead == NULL){
+        ///the worker reads leaves under their version latches, also outside thread-safe mode
+        if(nodeLatches == NULL) nodeLatches = new NodeLatchTable();
+        readAhead = new ReadAhead(bufMgr, file, treeLatch, *nodeLatches);
+    }
+    readAhead->request(pageNum, numPages);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::moveRight / moveLeft / readAheadLeaves
+// -----------------------------------------------------------------------------
+
+void BTreeScanCursor::moveRight(PageId nextPageNum)
+{
+    if(leafPinned){
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        index->bufMgr->readPage(index->file, nextPageNum, currentPageData);
+    }else{
+        ///leaves only split to the right, so whatever moved out of the last copy was in it already
+        VersionLatch& latch = index->nodeLatches->latch(nextPageNum);
+        while(!index->copyNode(nextPageNum, latch.readLock(), index->treeLatch.readLock(), leafCopy)){}
+    }
+    currentPageNum = nextPageNum;
+    nextEntry = 0;
+    rangeStats.leafReads++;
+    if(readAheadLeft > 0) readAheadLeft--;
+}
+
+void BTreeScanCursor::moveLeft(PageId prevPageNum)
+{
+    if(leafPinned){
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        index->bufMgr->readPage(index->file, prevPageNum, currentPageData);
+    }else{
+        ///the left sibling may have split since the current leaf was copied. Its new leaves went to its
+        ///right, so the leaf now in front of the current one is found by walking right from it
+        PageId pageNum = prevPageNum;
+        while(1){
+            VersionLatch& latch = index->nodeLatches->latch(pageNum);
+            while(!index->copyNode(pageNum, latch.readLock(), index->treeLatch.readLock(), leafCopy)){}
+            PageId rightNum = ((LeafNodeInt*)leafCopy)->rightSibPageNo;
+            if(rightNum == currentPageNum || rightNum == 0) break;
+            pageNum = rightNum;
+        }
+        prevPageNum = pageNum;
+    }
+    currentPageNum = prevPageNum;
+    nextEntry = ((NodeHeader*)currentPageData)->keyCount - 1;
+}
+
+template <class T>
+void BTreeScanCursor::readAheadLeaves()
+{
+    const int maxPages = index->readAheadPages;
+    if(maxPages <= 0 || readAheadLeft * 2 > readAheadWindow) return;
+
+    ///rightSibPageNo is at the same place in every leaf layout
+    PageId nextPageNum = ((LeafNodeInt*)currentPageData)->rightSibPageNo;
+    if(nextPageNum == 0) return;
+    int left = leavesLeft<T>();
+    if(left <= 0) return;
+
+    ///short scans start with a couple of leaves, each further request doubles
+    readAheadWindow = std::min(std::max(2 * readAheadWindow, 2), std::min(maxPages, left));
+    ///the leaves still ahead of the last request are asked for again, they are resident by now
+    rangeStats.readAheadLeaves += std::max(readAheadWindow - readAheadLeft, 0);
+    readAheadLeft = readAheadWindow;
+    index->requestReadAhead(nextPageNum, readAheadWindow);
+}
+
+template <class T>
+int BTreeScanCursor::leavesLeft() const
+{
+    int count = ((const NodeHeader*)currentPageData)->keyCount;
+    if(count == 0) return INT_MAX;
+    T firstKey = leafKeyAt<T>(currentPageData, 0);
+    T lastKey = leafKeyAt<T>(currentPageData, count - 1);
+    if(pastHighBound<T>(lastKey)) return 0;
+
+    ///how many more key spans of this leaf fit between its last key and the high bound
+    double span = (double)lastKey - (double)firstKey;
+    if(span <= 0) return INT_MAX;
+    double leaves = ((double)scanHighVal<T>() - (double)lastKey) / span + 1;
+    return (leaves >= INT_MAX) ? INT_MAX : (int)leaves;
+}
+
+template <class T>
+bool BTreeScanCursor::pastHighBound(const T& key) const
+{
+    const T highVal = scanHighVal<T>();
+    return (highOp == LT) ? key >= highVal : key > highVal;
+}
+
+template <class T>
+bool BTreeScanCursor::pastLowBound(const T& key) const
+{
+    const T lowVal = scanLowVal<T>();
+    return (lowOp == GT) ? key <= lowVal : key < lowVal;
 }
 
 
@@ -534,16 +4163,657 @@ bool BTreeIndex::compK(int lowValInt,const Operator lowOp,int highValInt,const O
 //
 void BTreeIndex::endScan() 
 {
-    //check if this is called before a startScan call
+    scanCursor.endScan();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::endScan
+// -----------------------------------------------------------------------------
+
+void BTreeScanCursor::endScan() 
+{
+    //check if this is called before the scan was opened
     if(scanExecuting == false){throw ScanNotInitializedException();}
 
     //end the scan
     scanExecuting = false;
 
-    //unpin page
-    bufMgr->unPinPage(file, currentPageNum, false);
-    }
+    //unpin page, a copied leaf was never left pinned
+    if(leafPinned) index->bufMgr->unPinPage(index->file, currentPageNum, false);
+    leafPinned = false;
 
     //reset scan spefific variables
+    currentPageNum = 0;
+    currentPageData = NULL;
+    nextEntry = 0;
+    inPosting = false;
+    postingRids.clear();
+    merging = false;
+    heldValid = false;
+    deleteUsed.clear();
+    rangeValsInt.clear();
+    rangeValsDouble.clear();
+    rangeValsString.clear();
+    rangeOps.clear();
+    rangeNext = 0;
+    descentPath.clear();
+}
+
+
+// -----------------------------------------------------------------------------
+// STRING keys
+// -----------------------------------------------------------------------------
+// STRING nodes are read and written through stringnode instead of fixed key arrays,
+// so these specializations replace the generic node code for StringKey.
+
+///orders entries by key only. Stable merges with it keep existing entries ahead of equal new ones
+static bool entryOrder(const RIDKeyPair<StringKey>& e1, const RIDKeyPair<StringKey>& e2)
+{
+    return e1.key < e2.key;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeIndex::bulkLoad<StringKey>(std::vector<RIDKeyPair<StringKey> >& entries)
+{
+    std::sort(entries.begin(), entries.end());
+    
+    ///leaves hold more keys the more they share, so the entries are cut by size rather than count
+    std::vector<size_t> sizes;
+    stringnode::leafPieces(entries.data(), entries.size(), fillFactor, sizes);
+    
+    std::vector<PageKeyPair<StringKey> > level;
+    PageKeyPair<StringKey> nodeEntry;
+    
+    PageId curPageNum = rootPageNum;
+    Page* curPage;
+    readNode(curPageNum, curPage);
+    
+    ((StringLeafNode*)curPage)->leftSibPageNo = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < sizes.size(); leaf++){
+        StringLeafNode* leafNode = (StringLeafNode*)curPage;
+        stringnode::encodeLeaf(leafNode, entries.data() + next, (int)sizes[leaf]);
+        ///the separator to the left of a leaf only has to tell it apart from the last key of the previous leaf
+        nodeEntry.set(curPageNum, leaf == 0 ? StringKey() : stringnode::separator(entries[next - 1].key, entries[next].key), (std::uint32_t)sizes[leaf]);
+        level.push_back(nodeEntry);
+        next += sizes[leaf];
+        
+        if(leaf + 1 < sizes.size()){
+            PageId nextPageNum;
+            Page* nextPage;
+            allocNode(nextPageNum, nextPage);
+            leafNode->rightSibPageNo = nextPageNum;
+            ((StringLeafNode*)nextPage)->leftSibPageNo = curPageNum;
+            unPinNode(curPageNum, true);
+            curPageNum = nextPageNum;
+            curPage = nextPage;
+        }else{
+            leafNode->rightSibPageNo = 0;
+            unPinNode(curPageNum, true);
+        }
+    }
+    
+    rootPageNum = buildUpperLevels(level, 1);
+    isRootALeaf = (sizes.size() == 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildUpperLevels<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+PageId BTreeIndex::buildUpperLevels<StringKey>(std::vector<PageKeyPair<StringKey> >& level, int nodeLevel)
+{
+    while(level.size() > 1){
+        ///the key of the first node is not a separator within this level
+        std::vector<StringKey> keys;
+        std::vector<PageId> children;
+        std::vector<std::uint32_t> counts;
+        for(size_t i = 0; i < level.size(); i++){
+            children.push_back(level[i].pageNo);
+            counts.push_back(level[i].count);
+            if(i > 0) keys.push_back(level[i].key);
+        }
+        std::vector<size_t> sizes;
+        stringnode::nonLeafPieces(keys.data(), children.size(), fillFactor, sizes);
+        
+        std::vector<PageKeyPair<StringKey> > parentLevel;
+        PageKeyPair<StringKey> nodeEntry;
+        size_t next = 0;
+        for(size_t node = 0; node < sizes.size(); node++){
+            PageId curPageNum;
+            Page* tmpPage;
+            allocNode(curPageNum, tmpPage);
+            StringNonLeafNode* nonLeafNode = (StringNonLeafNode*)tmpPage;
+            nonLeafNode->header.level = (std::int16_t)nodeLevel;
+            nonLeafNode->reserved[0] = nonLeafNode->reserved[1] = 0;
+            stringnode::encodeNonLeaf(nonLeafNode, keys.data() + next, children.data() + next, counts.data() + next, (int)sizes[node] - 1);
+            nodeEntry.set(curPageNum, level[next].key, std::accumulate(counts.begin() + next, counts.begin() + next + sizes[node], (std::uint32_t)0));
+            parentLevel.push_back(nodeEntry);
+            next += sizes[node];
+            unPinNode(curPageNum, true);
+        }
+        
+        level.swap(parentLevel);
+        nodeLevel++;
+    }
+    
+    return level[0].pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertKey<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeIndex::insertKey<StringKey>(const void* key, const RecordId rid)
+{
+    ///a single insert is a batch of one. It shifts the entry in place when it fits the leaf as encoded
+    KeyRidPair pair;
+    pair.key = key;
+    pair.rid = rid;
+    insertKeys<StringKey>(&pair, 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::batchInsert<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeIndex::batchInsert<StringKey>(PageId pageNum, const RIDKeyPair<StringKey>* entries, size_t n, std::vector<PageKeyPair<StringKey> >& newSiblings)
+{
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    
+    if(((NodeHeader*)tmpPage)->nodeType == LEAF_NODE){
+        StringLeafNode* leafNode = (StringLeafNode*)tmpPage;
+        if(n != 1 || !stringnode::leafInsert(leafNode, entries[0])){
+            leafMergeString(pageNum, leafNode, entries, n, newSiblings);
+        }
+        unPinNode(pageNum, true);
+        return;
+    }
+    
+    StringNonLeafNode* curNode = (StringNonLeafNode*)tmpPage;
+    int keyCount = curNode->header.keyCount;
+    
+    std::vector<std::pair<int, PageKeyPair<StringKey> > > childSplits;
+    std::vector<PageKeyPair<StringKey> > siblings;
+    StringKey sepKey;
+    
+    size_t start = 0;
+    while(start < n){
+        int child = stringnode::nonLeafUpperBound(curNode, entries[start].key);
+        size_t end = n;
+        if(child < keyCount){
+            stringnode::nonLeafKey(curNode, child, sepKey);
+            end = std::lower_bound(entries + start, entries + n, sepKey, entryKeyLess<StringKey>) - entries;
+        }
+        
+        siblings.clear();
+        batchInsert(stringnode::child(curNode, child), entries + start, end - start, siblings);
+        for(size_t s = 0; s < siblings.size(); s++){
+            childSplits.push_back(std::make_pair(child, siblings[s]));
+        }
+        stringnode::childCounts(curNode)[child] += (std::uint32_t)(end - start);
+        start = end;
+    }
+    
+    if(!childSplits.empty()){
+        nonLeafMergeString(curNode, childSplits, newSiblings);
+    }
+    unPinNode(pageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertBelow<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeIndex::insertBelow<StringKey>(PageId pageNum, const RIDKeyPair<StringKey>& dataEntry)
+{
+    std::vector<PageKeyPair<StringKey> > newSiblings;
+    batchInsert<StringKey>(pageNum, &dataEntry, 1, newSiblings);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafMergeString
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::leafMergeString(PageId pageNum, StringLeafNode* leafNode, const RIDKeyPair<StringKey>* entries, size_t n, std::vector<PageKeyPair<StringKey> >& newSiblings)
+{
+    std::vector<RIDKeyPair<StringKey> > existing;
+    stringnode::decodeLeaf(leafNode, existing);
+    std::vector<RIDKeyPair<StringKey> > merged(existing.size() + n);
+    std::merge(existing.begin(), existing.end(), entries, entries + n, merged.begin(), entryOrder);
+    
+    ///re-encode in place if everything fits one leaf, otherwise spread the entries by the fill factor
+    std::vector<size_t> sizes;
+    stringnode::leafPieces(merged.data(), merged.size(), 1.0, sizes);
+    if(sizes.size() > 1){
+        stringnode::leafPieces(merged.data(), merged.size(), fillFactor, sizes);
+    }
+    
+    PageId lastSibPageNo = leafNode->rightSibPageNo;
+    StringLeafNode* curNode = leafNode;
+    PageId curPageNum = 0;
+    size_t next = 0;
+    for(size_t leaf = 0; leaf < sizes.size(); leaf++){
+        stringnode::encodeLeaf(curNode, merged.data() + next, (int)sizes[leaf]);
+        next += sizes[leaf];
+        
+        if(leaf + 1 < sizes.size()){
+            PageId newPageNum;
+            Page* newPage;
+            allocNode(newPageNum, newPage);
+            curNode->rightSibPageNo = newPageNum;
+            if(curPageNum != 0) unPinNode(curPageNum, true);
+            curNode = (StringLeafNode*)newPage;
+            curNode->leftSibPageNo = (curPageNum != 0) ? curPageNum : pageNum;
+            curPageNum = newPageNum;
+            
+            PageKeyPair<StringKey> sibling;
+            sibling.set(newPageNum, stringnode::separator(merged[next - 1].key, merged[next].key), (std::uint32_t)sizes[leaf + 1]);
+            newSiblings.push_back(sibling);
+        }
+    }
+    curNode->rightSibPageNo = lastSibPageNo;
+    if(curPageNum != 0){
+        unPinNode(curPageNum, true);
+        setLeftSibling(lastSibPageNo, curPageNum);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nonLeafMergeString
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::nonLeafMergeString(StringNonLeafNode* nonLeafNode, const std::vector<std::pair<int, PageKeyPair<StringKey> > >& childSplits, std::vector<PageKeyPair<StringKey> >& newSiblings)
+{
+    std::vector<StringKey> oldKeys;
+    std::vector<PageId> oldChildren;
+    std::vector<std::uint32_t> oldCounts;
+    stringnode::decodeNonLeaf(nonLeafNode, oldKeys, oldChildren, oldCounts);
+    int count = (int)oldKeys.size();
+    
+    ///new siblings of child i go right after it, same as nonLeafMerge
+    std::vector<StringKey> keys;
+    std::vector<PageId> children;
+    std::vector<std::uint32_t> counts;
+    keys.reserve(count + childSplits.size());
+    children.reserve(count + childSplits.size() + 1);
+    counts.reserve(count + childSplits.size() + 1);
+    size_t s = 0;
+    for(int i = 0; i <= count; i++){
+        children.push_back(oldChildren[i]);
+        counts.push_back(oldCounts[i]);
+        size_t child = counts.size() - 1;
+        while(s < childSplits.size() && childSplits[s].first == i){
+            keys.push_back(childSplits[s].second.key);
+            children.push_back(childSplits[s].second.pageNo);
+            counts.push_back(childSplits[s].second.count);
+            counts[child] -= childSplits[s].second.count;
+            s++;
+        }
+        if(i < count) keys.push_back(oldKeys[i]);
+    }
+    
+    std::vector<size_t> sizes;
+    stringnode::nonLeafPieces(keys.data(), children.size(), 1.0, sizes);
+    if(sizes.size() > 1){
+        stringnode::nonLeafPieces(keys.data(), children.size(), fillFactor, sizes);
+    }
+    
+    ///the key between two nodes moves up
+    size_t next = 0;
+    for(size_t node = 0; node < sizes.size(); node++){
+        StringNonLeafNode* curNode = nonLeafNode;
+        PageId curPageNum = 0;
+        if(node > 0){
+            Page* newPage;
+            allocNode(curPageNum, newPage);
+            curNode = (StringNonLeafNode*)newPage;
+            curNode->header.level = nonLeafNode->header.level;
+            curNode->reserved[0] = curNode->reserved[1] = 0;
+            
+            PageKeyPair<StringKey> sibling;
+            sibling.set(curPageNum, keys[next - 1], std::accumulate(counts.begin() + next, counts.begin() + next + sizes[node], (std::uint32_t)0));
+            newSiblings.push_back(sibling);
+        }
+        stringnode::encodeNonLeaf(curNode, keys.data() + next, children.data() + next, counts.data() + next, (int)sizes[node] - 1);
+        next += sizes[node];
+        
+        if(curPageNum != 0) unPinNode(curPageNum, true);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::positionScan<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeIndex::positionScan<StringKey>(BTreeScanCursor& cursor, const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+    StringKey lowVal = keyFromPointer<StringKey>(lowValParm);
+    StringKey highVal = keyFromPointer<StringKey>(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+    
+    if (cursor.scanExecuting) {
+        cursor.endScan();
+    }
+    
+    cursor.index = this;
+    cursor.scanExecuting = true;
+    cursor.setScanRange<StringKey>(lowVal, highVal);
+    cursor.lowOp = lowOpParm;
+    cursor.highOp = highOpParm;
+    cursor.readAheadWindow = 0;
+    cursor.readAheadLeft = 0;
+    if(cursor.descending){
+        positionDescending<StringKey>(cursor, lowVal, highVal);
+        return;
+    }
+    
+    if(threadSafe){
+        positionShared<StringKey>(cursor, lowVal, lowOpParm == GTE);
+    }else{
+        PageId pageNum = rootPageNum;
+        if(!isRootALeaf){
+            while(1){
+                Page* tmpPage;
+                readNode(pageNum, tmpPage);
+                StringNonLeafNode* curNode = (StringNonLeafNode*)tmpPage;
+                int i = (lowOpParm == GTE) ? stringnode::nonLeafLowerBound(curNode, lowVal)
+                                           : stringnode::nonLeafUpperBound(curNode, lowVal);
+                PageId nextPageNum = stringnode::child(curNode, i);
+                bool childIsLeaf = (curNode->header.level == 1);
+                unPinNode(pageNum, false);
+                pageNum = nextPageNum;
+                if(childIsLeaf) break;
+            }
+        }
+        
+        cursor.currentPageNum = pageNum;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        cursor.leafPinned = true;
+    }
+    StringLeafNode* leafNode = (StringLeafNode*)cursor.currentPageData;
+    int count = leafNode->header.keyCount;
+    cursor.nextEntry = (lowOpParm == GTE) ? stringnode::leafLowerBound(leafNode, lowVal)
+                                          : stringnode::leafUpperBound(leafNode, lowVal);
+    
+    while(cursor.nextEntry >= count && leafNode->rightSibPageNo != 0){
+        PageId nextPageNum = leafNode->rightSibPageNo;
+        cursor.moveRight(nextPageNum);
+        leafNode = (StringLeafNode*)cursor.currentPageData;
+        count = leafNode->header.keyCount;
+    }
+    
+    mergeMessages<StringKey>(cursor, lowVal, highVal);
+    if(cursor.merging){
+        cursor.heldValid = cursor.mergeNext<StringKey>(cursor.heldRid);
+        if(!cursor.heldValid){
+            cursor.endScan();
+            throw NoSuchKeyFoundException();
+        }
+    }else if(cursor.nextEntry >= count || cursor.pastHighBoundString(leafNode, cursor.nextEntry)){
+        cursor.endScan();
+        throw NoSuchKeyFoundException();
+    }
+    cursor.readAheadLeaves<StringKey>();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::scanNextEntry<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+void BTreeScanCursor::scanNextEntry<StringKey>(RecordId& outRid)
+{
+    StringLeafNode* leafNode = (StringLeafNode*)currentPageData;
+    
+    while(nextEntry >= leafNode->header.keyCount){
+        PageId nextPageNum = leafNode->rightSibPageNo;
+        if(nextPageNum == 0){throw IndexScanCompletedException();}
+        
+        moveRight(nextPageNum);
+        leafNode = (StringLeafNode*)currentPageData;
+        readAheadLeaves<StringKey>();
+    }
+    
+    if(pastHighBoundString(leafNode, nextEntry)){throw IndexScanCompletedException();}
+    
+    outRid = stringnode::leafRid(leafNode, nextEntry);
+    nextEntry++;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScanCursor::scanNextBatchEntries<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+size_t BTreeScanCursor::scanNextBatchEntries<StringKey>(RecordId* out, size_t max)
+{
+    StringLeafNode* leafNode = (StringLeafNode*)currentPageData;
+    size_t n = 0;
+    
+    while(n < max){
+        int count = leafNode->header.keyCount;
+        if(nextEntry >= count){
+            PageId nextPageNum = leafNode->rightSibPageNo;
+            if(nextPageNum == 0) break;
+            
+            moveRight(nextPageNum);
+            leafNode = (StringLeafNode*)currentPageData;
+            readAheadLeaves<StringKey>();
+            continue;
+        }
+        
+        int limit = count;
+        if(pastHighBoundString(leafNode, count - 1)){
+            limit = (highOp == LT) ? stringnode::leafLowerBound(leafNode, highValString)
+                                   : stringnode::leafUpperBound(leafNode, highValString);
+        }
+        
+        int take = std::min((size_t)(limit - nextEntry), max - n);
+        for(int i = 0; i < take; i++){
+            out[n + i] = stringnode::leafRid(leafNode, nextEntry + i);
+        }
+        nextEntry += take;
+        n += take;
+        
+        if(nextEntry == limit && limit < count) break;
+    }
+    
+    return n;
+}
+
+template <>
+int BTreeScanCursor::leavesLeft<StringKey>() const
+{
+    const StringLeafNode* leafNode = (const StringLeafNode*)currentPageData;
+    int count = leafNode->header.keyCount;
+    if(count > 0 && pastHighBoundString(leafNode, count - 1)) return 0;
+    return INT_MAX;
+}
+
+bool BTreeScanCursor::pastHighBoundString(const StringLeafNode* leafNode, int i) const
+{
+    ///compared against the compressed entry, the key is never rebuilt
+    int c = stringnode::compareLeafKey(leafNode, i, highValString.bytes);
+    return (highOp == LT) ? c >= 0 : c > 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteFrom<StringKey>
+// -----------------------------------------------------------------------------
+
+template <>
+bool BTreeIndex::deleteFrom<StringKey>(PageId pageNum, const StringKey& key, const RecordId& rid, bool& underflow)
+{
+    Page* tmpPage;
+    readNode(pageNum, tmpPage);
+    
+    ///STRING nodes fill by bytes, not by key count
+    int lowWaterBytes = (int)(STRINGNODEDATASIZE * lowWaterFill);
+    
+    if(((NodeHeader*)tmpPage)->nodeType == LEAF_NODE){
+        StringLeafNode* leafNode = (StringLeafNode*)tmpPage;
+        int count = leafNode->header.keyCount;
+        for(int i = stringnode::leafLowerBound(leafNode, key); i < count && stringnode::compareLeafKey(leafNode, i, key.bytes) == 0; i++){
+            if(stringnode::leafRid(leafNode, i) == rid){
+                ///the remaining keys still share the prefix and fit the slots, so no re-encoding is needed
+                stringnode::leafErase(leafNode, i);
+                underflow = (count == 1 || stringnode::leafUsedBytes(leafNode) < lowWaterBytes);
+                unPinNode(pageNum, true);
+                return true;
+            }
+        }
+        unPinNode(pageNum, false);
+        return false;
+    }
+    
+    StringNonLeafNode* curNode = (StringNonLeafNode*)tmpPage;
+    int keyCount = curNode->header.keyCount;
+    StringKey sepKey;
+    for(int i = stringnode::nonLeafLowerBound(curNode, key); i <= keyCount; i++){
+        bool childUnderflow = false;
+        if(deleteFrom(stringnode::child(curNode, i), key, rid, childUnderflow)){
+            stringnode::childCounts(curNode)[i]--;
+            if(childUnderflow && keyCount > 0){
+                rebalanceChildString(curNode, i);
+            }
+            underflow = (curNode->header.keyCount == 0 || stringnode::nonLeafUsedBytes(curNode) < lowWaterBytes);
+            unPinNode(pageNum, true);
+            return true;
+        }
+        if(i == keyCount) break;
+        stringnode::nonLeafKey(curNode, i, sepKey);
+        if(sepKey != key) break;
+    }
+    unPinNode(pageNum, false);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceChildString
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::rebalanceChildString(StringNonLeafNode* parent, int i)
+{
+    std::vector<StringKey> parentKeys;
+    std::vector<PageId> parentChildren;
+    std::vector<std::uint32_t> parentCounts;
+    stringnode::decodeNonLeaf(parent, parentKeys, parentChildren, parentCounts);
+    
+    int left = (i < (int)parentKeys.size()) ? i : i - 1;
+    PageId leftPageNum = parentChildren[left];
+    PageId rightPageNum = parentChildren[left + 1];
+    Page* leftPage;
+    Page* rightPage;
+    readNode(leftPageNum, leftPage);
+    readNode(rightPageNum, rightPage);
+    
+    std::vector<size_t> sizes;
+    bool merged;
+    StringKey newSep;
+    
+    if(parent->header.level == 1){
+        std::vector<RIDKeyPair<StringKey> > entries;
+        stringnode::decodeLeaf((StringLeafNode*)leftPage, entries);
+        stringnode::decodeLeaf((StringLeafNode*)rightPage, entries);
+        
+        stringnode::leafPieces(entries.data(), entries.size(), fillFactor, sizes);
+        merged = (sizes.size() == 1);
+        if(!merged){
+            stringnode::leafPieces(entries.data(), entries.size(), 1.0, sizes);
+            if(sizes.size() == 1){
+                sizes.assign(1, entries.size() / 2);
+                sizes.push_back(entries.size() - sizes[0]);
+            }
+            newSep = stringnode::separator(entries[sizes[0] - 1].key, entries[sizes[0]].key);
+        }
+        
+        ///a longer separator may not fit the parent. The child is then left underfull
+        if(!merged){
+            parentKeys[left] = newSep;
+            std::vector<size_t> parentSizes;
+            stringnode::nonLeafPieces(parentKeys.data(), parentChildren.size(), 1.0, parentSizes);
+            if(parentSizes.size() > 1){
+                unPinNode(leftPageNum, false);
+                unPinNode(rightPageNum, false);
+                return;
+            }
+        }
+        
+        StringLeafNode* leftNode = (StringLeafNode*)leftPage;
+        StringLeafNode* rightNode = (StringLeafNode*)rightPage;
+        if(merged){
+            stringnode::encodeLeaf(leftNode, entries.data(), (int)entries.size());
+            leftNode->rightSibPageNo = rightNode->rightSibPageNo;
+            setLeftSibling(leftNode->rightSibPageNo, leftPageNum);
+        }else{
+            stringnode::encodeLeaf(leftNode, entries.data(), (int)sizes[0]);
+            stringnode::encodeLeaf(rightNode, entries.data() + sizes[0], (int)sizes[1]);
+        }
+    }else{
+        ///the separator in the parent comes down between the keys of the two nodes
+        std::vector<StringKey> keys;
+        std::vector<PageId> children;
+        std::vector<std::uint32_t> counts;
+        stringnode::decodeNonLeaf((StringNonLeafNode*)leftPage, keys, children, counts);
+        keys.push_back(parentKeys[left]);
+        stringnode::decodeNonLeaf((StringNonLeafNode*)rightPage, keys, children, counts);
+        
+        stringnode::nonLeafPieces(keys.data(), children.size(), fillFactor, sizes);
+        merged = (sizes.size() == 1);
+        if(!merged){
+            stringnode::nonLeafPieces(keys.data(), children.size(), 1.0, sizes);
+            if(sizes.size() == 1){
+                sizes.assign(1, children.size() / 2);
+                sizes.push_back(children.size() - sizes[0]);
+            }
+            newSep = keys[sizes[0] - 1];
+            parentKeys[left] = newSep;
+            std::vector<size_t> parentSizes;
+            stringnode::nonLeafPieces(parentKeys.data(), parentChildren.size(), 1.0, parentSizes);
+            if(parentSizes.size() > 1){
+                unPinNode(leftPageNum, false);
+                unPinNode(rightPageNum, false);
+                return;
+            }
+        }
+        
+        StringNonLeafNode* leftNode = (StringNonLeafNode*)leftPage;
+        StringNonLeafNode* rightNode = (StringNonLeafNode*)rightPage;
+        if(merged){
+            stringnode::encodeNonLeaf(leftNode, keys.data(), children.data(), counts.data(), (int)keys.size());
+        }else{
+            ///keys[sizes[0] - 1] moves back up to the parent
+            stringnode::encodeNonLeaf(leftNode, keys.data(), children.data(), counts.data(), (int)sizes[0] - 1);
+            stringnode::encodeNonLeaf(rightNode, keys.data() + sizes[0], children.data() + sizes[0], counts.data() + sizes[0], (int)sizes[1] - 1);
+        }
+    }
+    
+    parentCounts[left] = subtreeEntries<StringKey>(leftPage);
+    unPinNode(leftPageNum, true);
+    if(merged){
+        parentKeys.erase(parentKeys.begin() + left);
+        parentChildren.erase(parentChildren.begin() + left + 1);
+        parentCounts.erase(parentCounts.begin() + left + 1);
+        freeNode(rightPageNum, rightPage);
+    }else{
+        parentCounts[left + 1] = subtreeEntries<StringKey>(rightPage);
+        unPinNode(rightPageNum, true);
+    }
+    stringnode::encodeNonLeaf(parent, parentKeys.data(), parentChildren.data(), parentCounts.data(), (int)parentKeys.size());
+}
 
 }
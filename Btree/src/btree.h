@@ -7,15 +7,22 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "node_latch.h"
 
 namespace badgerdb
 {
@@ -42,17 +49,139 @@ enum Operator
 };
 
 
+/**
+ * @brief Version of the on-disk index format. Stored in the meta page, index files written
+ * with any other version are rejected when opened.
+ */
+const int INDEX_FORMAT_VERSION = 7;
+
+/**
+ * @brief Node type flag stored in the header of every node page.
+ */
+enum NodeType
+{
+	LEAF_NODE = 1,
+	NONLEAF_NODE = 2,
+	FREE_NODE = 3,
+	POSTING_NODE = 4,
+	PACKED_LEAF_NODE = 5,
+	BLOCKED_NONLEAF_NODE = 6
+};
+
+/**
+ * @brief Header at the start of every B+Tree node page. Occupancy is read from here
+ * instead of being inferred from empty slots.
+ */
+struct NodeHeader{
+  /**
+   * Number of keys stored in the node.
+   */
+	std::int32_t keyCount;
+
+  /**
+   * Height of the node above the leaves. 0 for leaves, 1 for the non-leaf nodes just above them.
+   */
+	std::int16_t level;
+
+  /**
+   * NodeType of the page.
+   */
+	std::int16_t nodeType;
+};
+
+/**
+ * @brief Number of key slots in a B+Tree leaf for keys of type T.
+ */
+//                                                        header                 sibling ptrs              key           rid
+template <class T>
+constexpr int leafArraySize() { return ( Page::SIZE - sizeof( NodeHeader ) - 2 * sizeof( PageId ) ) / ( sizeof( T ) + sizeof( RecordId ) ); }
+
+/**
+ * @brief Number of key slots in a B+Tree non-leaf for keys of type T.
+ */
+//                                                           header        extra pageNo and count                   key        pageNo          count
+template <class T>
+constexpr int nonLeafArraySize() { return ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::uint32_t ) ) / ( sizeof( T ) + sizeof( PageId ) + sizeof( std::uint32_t ) ); }
+
+/**
+ * @brief Keys of type T in one 64-byte cache line, the block size of blocked non-leaf nodes.
+ */
+template <class T>
+constexpr int nonLeafBlockKeys() { return 64 / sizeof( T ); }
+
+/**
+ * @brief Number of key slots in a blocked non-leaf node for keys of type T. The key slots after them
+ * hold the block directory, the last key of every block of nonLeafBlockKeys keys.
+ */
+template <class T>
+constexpr int blockedNonLeafSize() { return nonLeafArraySize<T>() * nonLeafBlockKeys<T>() / ( nonLeafBlockKeys<T>() + 1 ); }
+
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+const  int INTARRAYLEAFSIZE = leafArraySize<int>();
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYNONLEAFSIZE = nonLeafArraySize<int>();
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYLEAFSIZE = leafArraySize<double>();
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYNONLEAFSIZE = nonLeafArraySize<double>();
+
+/**
+ * @brief Number of key slots in a blocked B+Tree non-leaf for INTEGER key.
+ */
+const  int INTBLOCKEDNONLEAFSIZE = blockedNonLeafSize<int>();
+
+/**
+ * @brief Number of key slots in a blocked B+Tree non-leaf for DOUBLE key.
+ */
+const  int DOUBLEBLOCKEDNONLEAFSIZE = blockedNonLeafSize<double>();
+
+static_assert(INTBLOCKEDNONLEAFSIZE + ( INTBLOCKEDNONLEAFSIZE + nonLeafBlockKeys<int>() - 1 ) / nonLeafBlockKeys<int>() <= INTARRAYNONLEAFSIZE,
+		"The block directory of an INTEGER non-leaf must fit in its key array");
+static_assert(DOUBLEBLOCKEDNONLEAFSIZE + ( DOUBLEBLOCKEDNONLEAFSIZE + nonLeafBlockKeys<double>() - 1 ) / nonLeafBlockKeys<double>() <= DOUBLEARRAYNONLEAFSIZE,
+		"The block directory of a DOUBLE non-leaf must fit in its key array");
+
+/**
+ * @brief Width of a STRING key. Strings are indexed on up to this many bytes.
+ */
+const  int STRINGSIZE = 64;
+
+/**
+ * @brief Most columns of a composite key.
+ */
+const  int MAX_KEY_COLUMNS = 8;
+
+/**
+ * @brief Default fraction of each node filled when an index is bulk loaded.
+ * Leaves some room in every node so that later inserts do not split immediately.
+ */
+const double BULKLOAD_FILL_FACTOR = 0.9;
+
+/**
+ * @brief Default low-water fill of a node. deleteEntry only borrows from or merges with a sibling
+ * once a node holds less than this fraction of its capacity, or nothing at all.
+ */
+const double DELETE_LOW_WATER_FILL = 0.25;
+
+/**
+ * @brief Default largest number of leaves a range scan reads ahead of itself in the background.
+ */
+const int READ_AHEAD_MAX_PAGES = 16;
+
+/**
+ * @brief Default largest number of upper non-leaf nodes an index keeps pinned for its descents.
+ */
+const int UPPER_CACHE_MAX_PAGES = 16;
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -79,13 +208,135 @@ class PageKeyPair{
 public:
 	PageId pageNo;
 	T key;
-	void set( int p, T k)
+	///entries in the subtree under pageNo, set by the code that makes the node for the count its parent keeps
+	std::uint32_t count;
+	void set( int p, T k, std::uint32_t c = 0)
 	{
 		pageNo = p;
 		key = k;
+		count = c;
+	}
+};
+
+/**
+ * @brief A key and the record it points to, as passed to BTreeIndex::insertEntries.
+ */
+struct KeyRidPair{
+  /**
+   * Key to insert, pointer to integer/double/char string like the key of BTreeIndex::insertEntry.
+   */
+	const void* key;
+
+  /**
+   * Record ID of the record whose entry is getting inserted into the index.
+   */
+	RecordId rid;
+};
+
+/**
+ * @brief One column of a composite key, see the BTreeIndex constructor that takes a list of them.
+ */
+struct KeyColumn{
+  /**
+   * Offset of the attribute inside the record.
+   */
+	int offset;
+
+  /**
+   * Datatype of the attribute.
+   */
+	Datatype type;
+};
+
+/**
+ * @brief One range of a multi-range scan, as passed to BTreeIndex::openScan. The bounds are pointers
+ * to integer/double/char string like the bounds of a single range scan, and are only read while the
+ * scan is opened.
+ */
+struct ScanRange{
+	const void* lowVal;
+	Operator lowOp;
+	const void* highVal;
+	Operator highOp;
+
+	void set(const void* low, Operator lop, const void* high, Operator hop)
+	{
+		lowVal = low;
+		lowOp = lop;
+		highVal = high;
+		highOp = hop;
+	}
+
+  /**
+   * The range of the entries of a single key, for IN lists.
+   */
+	void setPoint(const void* key)
+	{
+		set(key, GTE, key, LTE);
+	}
+};
+
+/**
+ * @brief Work a scan has done to get to its ranges and leaves, see BTreeScanCursor::rangeScanStats.
+ */
+struct RangeScanStats{
+  /**
+   * Ranges the scan has started.
+   */
+	size_t ranges;
+
+  /**
+   * Ranges that started on the leaf the scan was already on, with no descent.
+   */
+	size_t leafHits;
+
+  /**
+   * Descents, each from the lowest node of the one before that covers its range, or from the root.
+   */
+	size_t descents;
+
+  /**
+   * Non-leaf nodes read by the descents.
+   */
+	size_t nodeReads;
+
+  /**
+   * Leaves read, at the end of a descent or by moving on to a sibling.
+   */
+	size_t leafReads;
+
+  /**
+   * Leaves the scan asked the read-ahead worker to read before it got to them, each counted once.
+   */
+	size_t readAheadLeaves;
+};
+
+/**
+ * @brief Normalized STRING key. The string is cut at its terminating null or at STRINGSIZE bytes and
+ * zero-padded to STRINGSIZE bytes, so comparing the raw bytes gives the same order as strcmp on the
+ * original strings and keys can be compared without looking for the terminator.
+ */
+struct StringKey{
+	unsigned char bytes[STRINGSIZE];
+
+  /**
+   * Normalize a null-terminated string, or a field of at most maxLen bytes.
+   */
+	void set(const char* str, size_t maxLen = STRINGSIZE)
+	{
+		size_t len = strnlen(str, std::min<size_t>(maxLen, STRINGSIZE));
+		memcpy(bytes, str, len);
+		memset(bytes + len, 0, STRINGSIZE - len);
 	}
 };
 
+inline bool operator<( const StringKey& k1, const StringKey& k2 ) { return memcmp(k1.bytes, k2.bytes, STRINGSIZE) < 0; }
+inline bool operator>( const StringKey& k1, const StringKey& k2 ) { return k2 < k1; }
+inline bool operator<=( const StringKey& k1, const StringKey& k2 ) { return !(k2 < k1); }
+inline bool operator>=( const StringKey& k1, const StringKey& k2 ) { return !(k1 < k2); }
+inline bool operator==( const StringKey& k1, const StringKey& k2 ) { return memcmp(k1.bytes, k2.bytes, STRINGSIZE) == 0; }
+inline bool operator!=( const StringKey& k1, const StringKey& k2 ) { return !(k1 == k2); }
+
 /**
  * @brief Overloaded operator to compare the key values of two rid-key pairs
  * and if they are the same compares to see if the first pair has
@@ -133,196 +384,1695 @@ struct IndexMetaInfo{
      * Whether or not the root is also a leaf node
      */
     bool isRootALeaf;
+
+  /**
+   * INDEX_FORMAT_VERSION the file was written with. Files from before versioning read as 0.
+   */
+	int formatVersion;
+
+  /**
+   * First page of the list of pages freed by deleteEntry, 0 if there are none.
+   */
+	PageId freePageNo;
+
+  /**
+   * Whether the leaves are PackedLeafNode pages.
+   */
+	bool packedLeaves;
+
+  /**
+   * Whether the non-leaf nodes are blocked, see BLOCKED_NONLEAF_NODE.
+   */
+	bool blockedNonLeaves;
+
+  /**
+   * Number of columns of a composite key, 0 for an index on one attribute.
+   */
+	int keyColumnCount;
+
+  /**
+   * Columns of a composite key, in order.
+   */
+	KeyColumn keyColumns[MAX_KEY_COLUMNS];
 };
 
 /*
 Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
+node they are. Every node starts with a NodeHeader, so the number of used slots is always known and only the first
+header.keyCount keys (and header.keyCount + 1 child pages of a non-leaf) are meaningful.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, templated for the key type.
+ *
+ * A BLOCKED_NONLEAF_NODE holds at most blockedNonLeafSize keys and keeps a block directory in the key
+ * slots after them: the last key of every cache line of keys. A search reads the directory, then only
+ * the one cache line of keys it points to, instead of a cache line per step of a binary search.
 */
-struct NonLeafNodeInt{
+template <class T>
+struct NonLeafNode{
   /**
-   * Level of the node in the tree.
+   * Key count, level and node type.
    */
-	int level;
+	NodeHeader header;
 
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	T keyArray[ nonLeafArraySize<T>() ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ nonLeafArraySize<T>() + 1 ];
+
+  /**
+   * Number of entries in the subtree under each child, countArray[i] for pageNoArray[i].
+   */
+	std::uint32_t countArray[ nonLeafArraySize<T>() + 1 ];
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all leaf nodes, templated for the key type.
 */
-struct LeafNodeInt{
-  /**
-   * Stores keys.
-   */
-	int keyArray[ INTARRAYLEAFSIZE ];
-
+template <class T>
+struct LeafNode{
   /**
-   * Stores RecordIds.
+   * Key count, level and node type.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	NodeHeader header;
 
   /**
    * Page number of the leaf on the right side.
 	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
    */
 	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, 0 for the leftmost leaf.
+   * Descending scans move from one leaf to the one before it through this link.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Stores keys.
+   */
+	T keyArray[ leafArraySize<T>() ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ leafArraySize<T>() ];
 };
 
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
 */
-class BTreeIndex {
+typedef LeafNode<int> LeafNodeInt;
 
- private:
+/**
+ * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+*/
+typedef NonLeafNode<double> NonLeafNodeDouble;
 
-  /**
-   * File object for the index file.
-   */
-	File		*file;
+/**
+ * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+*/
+typedef LeafNode<double> LeafNodeDouble;
 
+/**
+ * @brief A page freed by node merges. Free pages are chained through nextFreePageNo, starting
+ * at IndexMetaInfo::freePageNo, and are handed out again before the file grows.
+*/
+struct FreeNode{
   /**
-   * Buffer Manager Instance.
+   * Node type FREE_NODE.
    */
-	BufMgr	*bufMgr;
+	NodeHeader header;
 
   /**
-   * Page number of meta page.
+   * Next free page, 0 at the end of the list.
    */
-	PageId	headerPageNum;
+	PageId nextFreePageNo;
+};
 
+/**
+ * @brief Bytes of a posting list page left for record ids after its header.
+ */
+const int POSTINGDATASIZE = Page::SIZE - sizeof(NodeHeader) - sizeof(PageId) - 2 * sizeof(std::uint32_t);
+
+/**
+ * @brief A page of the posting list of one key of an INTEGER or DOUBLE index.
+ * A leaf entry whose record id has slot number Page::INVALID_SLOT, which no record has, stands for
+ * every entry in a chain of these pages, its page number being the first of them. The chain holds
+ * the record ids in ascending order, each stored as the varint-encoded difference to the one
+ * before it, so the ids of records on the same or nearby pages take a byte or two each.
+*/
+struct PostingNode{
   /**
-   * page number of root page of B+ tree inside index file.
+   * Node type POSTING_NODE, keyCount is the number of record ids on this page.
    */
-	PageId	rootPageNum;
+	NodeHeader header;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Next page of the posting list, 0 on the last one.
    */
-	Datatype	attributeType;
+	PageId nextPageNo;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Number of record ids in the whole posting list. Only kept on its first page.
    */
-	int 		attrByteOffset;
+	std::uint32_t totalCount;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Number of bytes of data in use.
    */
-	int			leafOccupancy;
+	std::uint32_t usedBytes;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Encoded record ids. The first is a difference to page 0 slot 0.
    */
-	int			nodeOccupancy;
-    
-    /**
-     * Whether or not the root is also a leaf node
-     */
-    bool isRootALeaf;
-    
-  
+	unsigned char data[POSTINGDATASIZE];
+};
 
+static_assert(sizeof(PostingNode) <= Page::SIZE, "PostingNode must fit in a page");
 
-	// MEMBERS SPECIFIC TO SCANNING
+/**
+ * @brief Bytes of a packed leaf page left for entries after its header.
+ */
+const int PACKEDLEAFDATASIZE = Page::SIZE - sizeof(NodeHeader) - 4 * sizeof(std::uint32_t) - sizeof(std::uint16_t) - 3 * sizeof(std::uint8_t);
 
+/**
+ * @brief A leaf of an INTEGER index built with packed leaves.
+ * Keys and record ids are stored as offsets from the smallest of them in the leaf, each field cut
+ * to the fewest bits that hold its largest offset: the keys first, then the page numbers, then the
+ * slot numbers, every section starting on a byte. Dense keys and records that share a few heap
+ * pages then take a handful of bits per entry instead of the 10 bytes of a LeafNodeInt entry.
+ * The siblings sit where they do in LeafNode, so sibling walks need not look at the type.
+*/
+struct PackedLeafNode{
   /**
-   * True if an index scan has been started.
+   * Node type PACKED_LEAF_NODE, keyCount is the number of entries.
    */
-	bool		scanExecuting;
+	NodeHeader header;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Page number of the leaf on the right side, as in LeafNode.
    */
-	int			nextEntry;
+	PageId rightSibPageNo;
 
   /**
-   * Page number of current page being scanned.
+   * Page number of the leaf on the left side, as in LeafNode.
    */
-	PageId	currentPageNum;
+	PageId leftSibPageNo;
 
   /**
-   * Current Page being scanned.
+   * Smallest key of the leaf.
    */
-	Page		*currentPageData;
+	std::int32_t keyBase;
 
   /**
-   * Low INTEGER value for scan.
+   * Smallest page number of a record id in the leaf.
    */
-	int			lowValInt;
+	PageId pageBase;
 
   /**
-   * Low DOUBLE value for scan.
+   * Smallest slot number of a record id in the leaf.
    */
-	double	lowValDouble;
+	std::uint16_t slotBase;
 
   /**
-   * Low STRING value for scan.
+   * Bits per key, page number and slot number offset.
    */
-	std::string	lowValString;
+	std::uint8_t keyBits;
+	std::uint8_t pageBits;
+	std::uint8_t slotBits;
 
   /**
-   * High INTEGER value for scan.
+   * Packed offsets.
    */
-	int			highValInt;
+	unsigned char data[PACKEDLEAFDATASIZE];
+};
+
+static_assert(sizeof(PackedLeafNode) <= Page::SIZE, "PackedLeafNode must fit in a page");
+static_assert(offsetof(PackedLeafNode, rightSibPageNo) == offsetof(LeafNodeInt, rightSibPageNo), "Leaves must keep the right sibling at one offset");
+static_assert(offsetof(PackedLeafNode, leftSibPageNo) == offsetof(LeafNodeInt, leftSibPageNo), "Leaves must keep the left sibling at one offset");
 
+/**
+ * @brief A node on the path of an optimistic descent, with the version of its latch it was read at.
+*/
+struct LatchedNode{
   /**
-   * High DOUBLE value for scan.
+   * Page number of the node.
    */
-	double	highValDouble;
+	PageId pageNum;
 
   /**
-   * High STRING value for scan.
+   * Version the node was read at.
    */
-	std::string highValString;
-	
+	std::uint64_t version;
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Whether the node takes one more entry without splitting.
    */
-	Operator	lowOp;
+	bool hasRoom;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Position of the next node of the path among the children of this one. Unused for the leaf.
    */
-	Operator	highOp;
-
-		
-bool compK(int lowValInt,const Operator lowOp,int highValInt,const Operator highOp, int key);
+	int child;
+};
 
+/**
+ * @brief A node of the upper levels cache, pinned in the buffer pool for as long as it is cached.
+*/
+struct CachedNode{
+  /**
+   * Page number of the node.
+   */
+	PageId pageNum;
 
- public:
+  /**
+   * Frame of the node in the buffer pool.
+   */
+	Page* page;
+
+  /**
+   * Whether the node was changed since it was cached. Passed on to the buffer pool when it is unpinned.
+   */
+	bool dirty;
+};
+
+/**
+ * @brief Orders rid-key pairs by key, then by record id, so copies of one entry sit together.
+ */
+template <class T>
+struct MessageOrder{
+	bool operator()(const RIDKeyPair<T>& m1, const RIDKeyPair<T>& m2) const
+	{
+		if(m1.key != m2.key) return m1.key < m2.key;
+		if(m1.rid.page_number != m2.rid.page_number) return m1.rid.page_number < m2.rid.page_number;
+		return m1.rid.slot_number < m2.rid.slot_number;
+	}
+};
+
+/**
+ * @brief Inserts and deletes an index in write-optimized mode has taken but not applied to its leaves
+ * yet, see BTreeIndex::setWriteBuffer. A message goes into copies in O(log n). The sorted lists of
+ * inserts and deletes are built from it when they are next read, see BTreeIndex::sortedMessages.
+*/
+template <class T>
+struct WriteBuffer{
+  /**
+   * Copies of each entry the leaves are to gain, negative for copies they are to lose. An insert and
+   * a delete of the same entry cancel out as they come in, and no entry is kept at 0.
+   */
+	std::map<RIDKeyPair<T>, int, MessageOrder<T> > copies;
+
+  /**
+   * Messages held back, the sum of the counts of copies without their signs.
+   */
+	size_t size;
+
+  /**
+   * Entries inserted but not in the leaves yet, sorted by key, then by record id.
+   */
+	std::vector<RIDKeyPair<T> > inserts;
+
+  /**
+   * Entries deleted but still in the leaves, in the same order. Each one stands for a different entry
+   * of the leaves.
+   */
+	std::vector<RIDKeyPair<T> > deletes;
+
+  /**
+   * Whether inserts and deletes are as copies has them.
+   */
+	bool sorted;
+
+	WriteBuffer() : size(0), sorted(true) {}
+};
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE, "NonLeafNodeInt must fit in a page");
+static_assert(sizeof(LeafNodeInt) <= Page::SIZE, "LeafNodeInt must fit in a page");
+static_assert(sizeof(NonLeafNodeDouble) <= Page::SIZE, "NonLeafNodeDouble must fit in a page");
+static_assert(sizeof(LeafNodeDouble) <= Page::SIZE, "LeafNodeDouble must fit in a page");
+
+/**
+ * @brief Bytes of a STRING node page left for slots after the node header, prefix and sibling pointers.
+ */
+const int STRINGNODEDATASIZE = Page::SIZE - sizeof(NodeHeader) - 2 * sizeof(PageId) - 2 * sizeof(std::uint16_t) - STRINGSIZE;
+
+/**
+ * @brief Structure for leaf nodes when the key is of STRING type.
+ * The bytes every key of the leaf has in common are stored once in prefix. Each entry is then a
+ * RecordId followed by the next slotWidth bytes of the key, which is wide enough for the longest
+ * key of the leaf without its zero padding. Slots are all the same width, so entry i is at
+ * slots + i * (sizeof(RecordId) + slotWidth) and the leaf holds more keys the more they share.
+*/
+struct StringLeafNode{
+  /**
+   * Key count, level and node type.
+   */
+	NodeHeader header;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Number of bytes of prefix in use.
+   */
+	std::uint16_t prefixLen;
+
+  /**
+   * Number of key bytes stored in each slot, after the prefix.
+   */
+	std::uint16_t slotWidth;
+
+  /**
+   * Leading bytes shared by every key of the leaf.
+   */
+	unsigned char prefix[STRINGSIZE];
+
+  /**
+   * Entries, each a RecordId followed by slotWidth key bytes.
+   */
+	unsigned char slots[STRINGNODEDATASIZE];
+};
+
+/**
+ * @brief Structure for non-leaf nodes when the key is of STRING type.
+ * Separators are cut to the shortest prefix of the right node's first key that is still greater than
+ * the left node's last key, and share a node prefix the same way leaf keys do. slots holds the
+ * keyCount + 1 child page numbers, the keyCount + 1 entry counts of their subtrees and then keyCount
+ * separators of slotWidth bytes each.
+*/
+struct StringNonLeafNode{
+  /**
+   * Key count, level and node type.
+   */
+	NodeHeader header;
+
+  /**
+   * Unused. Keeps the prefix at the same offset as in StringLeafNode.
+   */
+	PageId reserved[2];
+
+  /**
+   * Number of bytes of prefix in use.
+   */
+	std::uint16_t prefixLen;
+
+  /**
+   * Number of separator bytes stored in each slot, after the prefix.
+   */
+	std::uint16_t slotWidth;
+
+  /**
+   * Leading bytes shared by every separator of the node.
+   */
+	unsigned char prefix[STRINGSIZE];
+
+  /**
+   * Child page numbers, subtree entry counts and then the separators.
+   */
+	unsigned char slots[STRINGNODEDATASIZE];
+};
+
+static_assert(sizeof(StringNonLeafNode) <= Page::SIZE, "StringNonLeafNode must fit in a page");
+static_assert(sizeof(StringLeafNode) <= Page::SIZE, "StringLeafNode must fit in a page");
+static_assert(offsetof(StringLeafNode, leftSibPageNo) == offsetof(LeafNodeInt, leftSibPageNo), "Leaves must keep the left sibling at one offset");
+static_assert(offsetof(LeafNodeDouble, leftSibPageNo) == offsetof(LeafNodeInt, leftSibPageNo), "Leaves must keep the left sibling at one offset");
+
+
+class BTreeIndex;
+class ReadAhead;
+
+/**
+ * @brief An open range scan over a BTreeIndex, returned by BTreeIndex::openScan.
+ * Each cursor keeps its own bounds and position and holds the leaf it is on pinned, so any number of
+ * cursors can scan one index at once, each moving on its own. Cursors can be moved but not copied, and
+ * must be ended or destroyed before their index is.
+ * Cursors take no locks. Outside thread-safe mode, see BTreeIndex::setThreadSafe, cursors used from
+ * different threads need their calls serialized, and the index must not be changed while a cursor is open.
+ * In thread-safe mode each thread can open its own cursors and call scanNext, scanNextBatch and endScan on
+ * them while other threads scan, call lookup or insertEntry. The buffer manager can be called from several
+ * threads, and a cursor keeps a copy of its leaf rather than a pin, which it checks against the latch of
+ * the leaf. One cursor is still used by one thread at a time, and no cursor may be open while deleteEntry or
+ * insertEntries runs.
+*/
+class BTreeScanCursor {
+
+	friend class BTreeIndex;
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if the cursor has been opened and not ended.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned. A descending scan counts down
+   * and is done with the leaf at -1.
+   */
+	int			nextEntry;
+
+  /**
+   * Whether the scan returns entries from the high bound down, walking leaves to the left. Descending
+   * scans take every entry through mergeNext.
+   */
+	bool		descending;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	StringKey	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	StringKey	highValString;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Private copy of the current leaf in thread-safe mode, where no leaf stays pinned between calls.
+   */
+	Page		*leafCopy;
+
+  /**
+   * Whether currentPageData is the pinned leaf in the buffer pool rather than leafCopy.
+   */
+	bool		leafPinned;
+
+  /**
+   * Number of leaves the last read-ahead request asked for.
+   */
+	int			readAheadWindow;
+
+  /**
+   * Leaves requested ahead that the scan has not reached yet.
+   */
+	int			readAheadLeft;
+
+  /**
+   * Whether the cursor is part way through the posting list of entry nextEntry.
+   */
+	bool		inPosting;
+
+  /**
+   * Record ids of the posting list page being returned.
+   */
+	std::vector<RecordId>	postingRids;
+
+  /**
+   * Index of the next record id of postingRids to return.
+   */
+	size_t		postingNext;
+
+  /**
+   * Page of the posting list after the one in postingRids, 0 if it was the last.
+   */
+	PageId	postingNextPage;
+
+  /**
+   * Next record id of the posting list starting at firstPageNum, which entry nextEntry points to.
+   * Once the list is done nextEntry moves past it, in the direction of the scan.
+   *
+   * @return				false, with outRid unchanged, if the list had no record ids left
+   */
+	bool nextPostingRid(PageId firstPageNum, RecordId& outRid);
+
+  /**
+   * Whether the index held back inserts or deletes in the range when the scan was opened. Entries are
+   * then merged from the leaves and the write buffer by mergeNext.
+   */
+	bool		merging;
+
+  /**
+   * Next and end position of the buffered inserts in range.
+   */
+	size_t		insertNext;
+	size_t		insertEnd;
+
+  /**
+   * First and end position of the buffered deletes in range.
+   */
+	size_t		deleteFirst;
+	size_t		deleteEnd;
+
+  /**
+   * Which of the buffered deletes in range have already hidden an entry of the leaves.
+   */
+	std::vector<bool>	deleteUsed;
+
+  /**
+   * Whether heldRid is the next entry of a merged scan, found when the scan was opened.
+   */
+	bool		heldValid;
+	RecordId	heldRid;
+
+  /**
+   * Bounds of the ranges of a multi-range scan, low and high of each range in turn, for INTEGER,
+   * DOUBLE and STRING keys. Empty for a single range scan.
+   */
+	std::vector<int>	rangeValsInt;
+	std::vector<double>	rangeValsDouble;
+	std::vector<StringKey>	rangeValsString;
+
+  /**
+   * Low and high operator of each range of a multi-range scan.
+   */
+	std::vector<Operator>	rangeOps;
+
+  /**
+   * Index of the range of a multi-range scan to start once the current one is done.
+   */
+	size_t		rangeNext;
+
+  /**
+   * Non-leaf nodes of a multi-range scan's last descent, root first. The next range that starts beyond
+   * the current leaf is found from the lowest of them whose subtree holds its low bound.
+   */
+	std::vector<PageId>	descentPath;
+
+  /**
+   * Counts of the last multi-range scan opened on this cursor. Kept after the scan ends.
+   */
+	RangeScanStats	rangeStats;
+
+  /**
+   * Range bounds of a multi-range scan for keys of type T.
+   */
+	template <class T>
+	std::vector<T>& rangeVals();
+
+  /**
+   * Start the next range of a multi-range scan that has an entry, skipping empty ones.
+   *
+   * @return				false if no range is left, or if the scan has a single range
+   */
+	bool nextRange();
+
+  /**
+   * nextRange for keys of type T.
+   */
+	template <class T>
+	bool nextRangeFor();
+
+  /**
+   * Put the cursor on the first entry of the range in the bounds, which starts at or after the
+   * current position. A range that starts in the current leaf is found there, so ranges close together
+   * share their leaves, otherwise the index skips ahead to its leaf.
+   *
+   * @return				false if the range has no entries
+   */
+	template <class T>
+	bool seekRange();
+
+  /**
+   * Next entry of a merged scan, whichever of the next leaf entry not deleted and the next buffered
+   * insert has the smaller key, or the larger one in a descending scan.
+   *
+   * @return				false if the scan has no more entries
+   */
+	template <class T>
+	bool mergeNext(RecordId& outRid);
+
+  /**
+   * mergeNext for the key type of the index, starting with heldRid.
+   */
+	bool mergedNext(RecordId& outRid);
+
+  /**
+   * Move on to the next leaf entry in range without taking it, across leaves if needed. Descending
+   * scans move to left siblings.
+   *
+   * @return				false if the leaves have no more entries in range
+   */
+	template <class T>
+	bool treeHasNext();
+
+  /**
+   * Whether a leaf entry is one of the buffered deletes in range not used yet, which it then uses.
+   */
+	template <class T>
+	bool takeDelete(const T& key, const RecordId& rid);
+
+  /**
+   * Unpin the current leaf and move on to its right sibling. In thread-safe mode the sibling is
+   * copied instead, at a version no writer was changing it.
+   */
+	void moveRight(PageId nextPageNum);
+
+  /**
+   * Unpin the current leaf and move on to its left sibling, at the last entry. In thread-safe mode the
+   * leaf now left of the current one is copied, which is the sibling or a leaf split off from it since.
+   */
+	void moveLeft(PageId prevPageNum);
+
+  /**
+   * Ask for the leaves after the current one to be read in the background, once the scan has used
+   * up half of its last request. The window doubles with every request up to the limit of the index,
+   * and is cut to the number of leaves the scan is estimated to still need.
+   */
+	template <class T>
+	void readAheadLeaves();
+
+  /**
+   * Estimated number of leaves after the current one that still hold keys in range. 0 if the range
+   * ends in the current leaf. For INTEGER and DOUBLE keys this assumes the keys of the rest of the
+   * range are spread like the keys of the current leaf. STRING keys give no estimate beyond the
+   * current leaf, so any number of leaves may be needed.
+   */
+	template <class T>
+	int leavesLeft() const;
+
+  /**
+   * Whether a key lies beyond the high end of the scan range.
+   */
+	template <class T>
+	bool pastHighBound(const T& key) const;
+
+  /**
+   * Whether a key lies beyond the low end of the scan range.
+   */
+	template <class T>
+	bool pastLowBound(const T& key) const;
+
+  /**
+   * Whether entry i of a STRING leaf lies beyond the high end of the scan range.
+   */
+	bool pastHighBoundString(const StringLeafNode* leafNode, int i) const;
+
+  /**
+   * High value of the scan for keys of type T.
+   */
+	template <class T>
+	T scanHighVal() const;
+
+  /**
+   * Low value of the scan for keys of type T.
+   */
+	template <class T>
+	T scanLowVal() const;
+
+  /**
+   * Store the bounds of the scan in the members for keys of type T.
+   */
+	template <class T>
+	void setScanRange(T lowVal, T highVal);
+
+  /**
+   * scanNext for keys of type T.
+   */
+	template <class T>
+	void scanNextEntry(RecordId& outRid);
+
+  /**
+   * scanNextBatch for keys of type T.
+   */
+	template <class T>
+	size_t scanNextBatchEntries(RecordId* out, size_t max);
+
+ public:
+
+  /**
+   * A cursor with no scan open.
+   */
+	BTreeScanCursor();
+
+  /**
+   * Take over the scan of another cursor, which is left with no scan open.
+   */
+	BTreeScanCursor(BTreeScanCursor&& other);
+
+  /**
+   * End the scan of this cursor, if any, and take over the scan of another cursor.
+   */
+	BTreeScanCursor& operator=(BTreeScanCursor&& other);
+
+	BTreeScanCursor(const BTreeScanCursor&) = delete;
+	BTreeScanCursor& operator=(const BTreeScanCursor&) = delete;
+
+  /**
+   * Unpin the current leaf if the scan is still open. Does not throw.
+   */
+	~BTreeScanCursor();
+
+  /**
+   * Whether a scan is open on this cursor.
+   */
+	bool isOpen() const;
+
+  /**
+   * Position, among the ranges passed to openScan, of the range the entry scanNext returned last
+   * belongs to. Ranges of one key that leave the key out hold nothing and are not counted.
+   * Only meaningful for a multi-range scan.
+   */
+	size_t rangeIndex() const;
+
+  /**
+   * Counts of the last multi-range scan opened on this cursor, of the ranges it started and of how
+   * it got to them. Kept after the scan ends.
+   */
+	const RangeScanStats& rangeScanStats() const;
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan, moving on to the right sibling
+	 * once the current leaf is done, or to the left sibling in a descending scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record ids of up to max next entries that match the scan. The entries of a leaf that are
+	 * in range are found with one search for the high bound and copied in one loop, and the scan moves on
+	 * to right siblings until out is full or the range ends. A multi-range scan then goes on with its
+	 * next range. The end of the scan is a return value of 0, not an exception.
+   * @param out			Array of at least max record ids the entries are returned in
+   * @param max			Most entries to return
+   * @return				Number of record ids written to out. 0 once the scan has no more entries.
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	**/
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+  /**
+	 * End the scan and unpin its leaf.
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	**/
+	void endScan();
+
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single INTEGER, DOUBLE or STRING attribute of a
+ * relation. Scans run through BTreeScanCursor objects, any number at a time. startScan, scanNext and
+ * endScan drive one cursor kept by the index.
+ * The node code is written once as member templates over the key type. The public methods
+ * switch on attributeType once per call and run the instantiation for that type.
+*/
+class BTreeIndex {
+
+	friend class BTreeScanCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Columns of a composite key, empty for an index on one attribute. Composite indexes are STRING
+   * indexes over keys encoded by compositekey.
+   */
+	std::vector<KeyColumn>	keyColumns;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+    
+    /**
+     * Whether or not the root is also a leaf node
+     */
+    bool isRootALeaf;
+
+  /**
+   * Fraction of each node filled by bulk loads and by the group splits of insertEntries.
+   */
+	double		fillFactor;
+
+  /**
+   * Fill below which deleteEntry rebalances a node with its sibling.
+   */
+	double		lowWaterFill;
+
+  /**
+   * First page of the free page list, same as in the meta page.
+   */
+	PageId	freePageNum;
+
+  /**
+   * Most leaves a scan reads ahead of itself. 0 turns read-ahead off.
+   */
+	int			readAheadPages;
+
+  /**
+   * Background reader for scan read-ahead, started by the first request.
+   */
+	ReadAhead	*readAhead;
+
+  /**
+   * Queue background reads of numPages leaves starting at pageNum.
+   */
+	void requestReadAhead(PageId pageNum, int numPages);
+
+  /**
+   * Root and upper non-leaf nodes, top-down, kept pinned so descents do not go through the buffer pool
+   * for them. Sized to upperCachePages and never reallocated, threads look nodes up while new roots are
+   * appended.
+   */
+	std::vector<CachedNode>	upperCache;
+
+  /**
+   * Number of nodes in upperCache.
+   */
+	int			upperCacheSize;
+
+  /**
+   * Most nodes kept in upperCache. 0 turns the cache off.
+   */
+	int			upperCachePages;
+
+  /**
+   * Whether upperCache no longer holds the upper levels, after a root change it could not take in.
+   */
+	bool		upperCacheStale;
+
+  /**
+   * Pin a node page, from upperCache if it is there and from the buffer pool otherwise.
+   */
+	void readNode(PageId pageNum, Page*& page);
+
+  /**
+   * Unpin a node page read with readNode. Nodes of upperCache stay pinned.
+   */
+	void unPinNode(PageId pageNum, bool dirty);
+
+  /**
+   * Frame of a node of upperCache, NULL if the node is not cached.
+   */
+	Page* cachedNode(PageId pageNum);
+
+  /**
+   * Unpin all nodes of upperCache and empty it.
+   */
+	void releaseUpperCache();
+
+  /**
+   * Fill upperCache again from the current root, top-down.
+   * Only called while no other thread uses the index and no node read with readNode is still pinned.
+   */
+	void refreshUpperCache();
+
+  /**
+   * Refresh upperCache if it is stale and the index is not in thread-safe mode.
+   */
+	void checkUpperCache();
+
+  /**
+   * refreshUpperCache for keys of type T.
+   */
+	template <class T>
+	void fillUpperCache();
+
+  /**
+   * Whether the index may be used from several threads at once. See setThreadSafe.
+   */
+	bool		threadSafe;
+
+  /**
+   * Version latches of the nodes, allocated when thread-safe mode is turned on.
+   */
+	NodeLatchTable	*nodeLatches;
+
+  /**
+   * Latch of rootPageNum and isRootALeaf. Taken by inserts that split the root.
+   */
+	VersionLatch	rootLatch;
+
+  /**
+   * Taken by deleteEntry and insertEntries, which change the tree without node latches. Optimistic
+   * reads check it along with the latch of their node.
+   */
+	VersionLatch	treeLatch;
+
+  /**
+   * Number of inserts working under node latches. Holders of treeLatch wait for them to finish.
+   */
+	std::atomic<int>	activeWriters;
+
+  /**
+   * Serializes allocNode and freeNode.
+   */
+	std::mutex	allocLatch;
+
+  /**
+   * Number of entries of one key at which they are moved to a posting list. 0 turns posting lists off.
+   */
+	int			postingMinDuplicates;
+
+  /**
+   * Whether the leaves are PackedLeafNode pages. Only INTEGER indexes have packed leaves.
+   */
+	bool		packedLeaves;
+
+  /**
+   * Whether new non-leaf nodes are blocked. Only INTEGER and DOUBLE indexes have blocked non-leaves.
+   */
+	bool		blockedNonLeaves;
+
+  /**
+   * Page numbers of the nodes from the root down to the rightmost leaf, as found by the first append
+   * since the shape of the tree last changed. Emptied by allocNode and freeNode.
+   */
+	std::vector<PageId>	rightEdgePath;
+
+  /**
+   * Messages held back in write-optimized mode, one buffer for each key type. Only the one of
+   * attributeType is used.
+   */
+	WriteBuffer<int>	intMessages;
+	WriteBuffer<double>	doubleMessages;
+	WriteBuffer<StringKey>	stringMessages;
+
+  /**
+   * Most messages held back before some are applied. 0 turns write-optimized mode off.
+   */
+	int			writeBufferMessages;
+
+  /**
+   * Write buffer for keys of type T.
+   */
+	template <class T>
+	WriteBuffer<T>& writeBuffer();
+
+  /**
+   * Whether inserts and deletes go to the write buffer.
+   */
+	bool buffering() const;
+
+  /**
+   * Hold back an insert. It cancels a buffered delete of the same entry, if there is one.
+   */
+	template <class T>
+	void bufferInsert(const void* key, const RecordId rid);
+
+  /**
+   * Hold back a delete. It cancels a buffered insert of the same entry, if there is one. Otherwise the
+   * entry is looked for in the leaves, which are read but not changed.
+   *
+   * @throws NoSuchKeyFoundException If neither the leaves nor the buffer hold the entry.
+   */
+	template <class T>
+	void bufferDelete(const void* key, const RecordId rid);
+
+  /**
+   * Apply buffered messages to the tree, deletes one by one and inserts as one sorted batch. Unless all
+   * is set only the messages bound for the children of the root with the most of them are applied,
+   * at least half of the buffer.
+   */
+	template <class T>
+	void applyMessages(bool all);
+
+  /**
+   * Apply every buffered message to the tree.
+   */
+	void flushWriteBuffer();
+
+  /**
+   * Whether the leaves hold at least the given number of entries of key with record id rid. Only the
+   * entries of key are read, and the search stops once enough are found.
+   */
+	template <class T>
+	bool leafHolds(const T& key, const RecordId& rid, size_t copies);
+
+  /**
+   * The write buffer for keys of type T, with its sorted inserts and deletes brought up to date.
+   */
+	template <class T>
+	const WriteBuffer<T>& sortedMessages();
+
+  /**
+   * Buffered inserts less buffered deletes with keys in a range.
+   */
+	template <class T>
+	long bufferedInRange(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp);
+
+  /**
+   * lookup for keys of type T, with the write buffer merged in.
+   */
+	template <class T>
+	size_t lookupMerged(const T& key, RecordId* out, size_t max);
+
+  /**
+   * Smallest or largest key with an entry the buffered deletes leave. The leaves are walked from the
+   * leftmost one right for the smallest, from the rightmost one left for the largest, and the walk stops
+   * at the first key the deletes leave live. Its cost grows with the number of deleted edge keys, not
+   * with the size of the index.
+   *
+   * @return				false if the buffered deletes leave no entry
+   */
+	template <class T>
+	bool liveEdgeKey(bool max, T& key);
+
+  /**
+   * Set up a cursor positioned in the leaves to merge the messages in its range, if there are any.
+   */
+	template <class T>
+	void mergeMessages(BTreeScanCursor& cursor, const T& lowVal, const T& highVal);
+
+  /**
+   * Insert an entry that goes after every entry of the rightmost leaf straight into that leaf, if it
+   * has room, without searching the nodes above it.
+   *
+   * @return				false if the entry was not inserted and has to go through findandInsert
+   */
+	template <class T>
+	bool appendInsert(const RIDKeyPair<T>& dataEntry);
+
+  /**
+   * Copy a node page while no writer changes it.
+   *
+   * @param version			Version of the node latch the copy has to match
+   * @param treeVersion	Version of treeLatch the copy has to match
+   * @return						false if the node or the tree changed, and the copy cannot be used
+   */
+	bool copyNode(PageId pageNum, std::uint64_t version, std::uint64_t treeVersion, Page* copy);
+
+  /**
+   * Find the child of a non-leaf node for key by reading the node where it sits in the buffer pool,
+   * with no copy. Writers may change the node meanwhile. The count is kept within the node, so the
+   * search stays inside the page, but its results hold only if the node latch validates afterwards.
+   *
+   * @param node				Receives whether the node has room and the position of the child
+   * @param childNum		Receives the page number of the child
+   * @return						false, with nothing read, if the node is a leaf or holds StringKey keys and
+   *										has to be copied instead
+   */
+	template <class T>
+	bool searchInPlace(PageId pageNum, const T& key, bool lower, LatchedNode& node, PageId& childNum);
+
+  /**
+   * Descend from the root to the leaf for key without taking any latch, noting the version each node
+   * was read at. Separators equal to key send the descent left if lower is set, right otherwise.
+   *
+   * @param path				Nodes from the root down to the leaf
+   * @param rootVersion	Version of rootLatch the root was found at
+   * @param treeVersion	Version of treeLatch the whole path was read at
+   * @param leafCopy		If not NULL, receives a copy of the leaf at its version in path
+   * @return						false if a writer got in the way and the descent has to start over
+   */
+	template <class T>
+	bool optimisticPath(const T& key, bool lower, std::vector<LatchedNode>& path, std::uint64_t& rootVersion, std::uint64_t& treeVersion, Page* leafCopy);
+
+  /**
+   * Put a cursor on a copy of the leaf for lowVal in thread-safe mode.
+   */
+	template <class T>
+	void positionShared(BTreeScanCursor& cursor, const T& lowVal, bool lower);
+
+  /**
+   * The part of positionScan for a descending cursor. The cursor is put on the last entry in range,
+   * taken as its held entry.
+   */
+	template <class T>
+	void positionDescending(BTreeScanCursor& cursor, const T& lowVal, const T& highVal);
+
+  /**
+   * Whether a node takes one more entry, of any key, without splitting.
+   */
+	template <class T>
+	bool nodeHasRoom(const Page* node) const;
+
+  /**
+   * insertEntry in thread-safe mode. Finds the leaf optimistically, then latches only the nodes the
+   * insert changes: the leaf, the full nodes above it that split with it and the first node that takes
+   * their separator. A root split also takes rootLatch.
+   */
+	template <class T>
+	void insertShared(const void* key, const RecordId rid);
+
+  /**
+   * Insert an entry into the subtree of a node that does not split from it.
+   */
+	template <class T>
+	void insertBelow(PageId pageNum, const RIDKeyPair<T>& dataEntry);
+
+  /**
+   * Take treeLatch, and in thread-safe mode wait for the inserts already under node latches. Every
+   * write outside thread-safe mode takes it too, which stops a read-ahead of the leaves it changes.
+   */
+	void beginExclusive();
+
+  /**
+   * Release treeLatch.
+   */
+	void endExclusive();
+    
+  
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor behind startScan, scanNext and endScan.
+   */
+	BTreeScanCursor	scanCursor;
+
+  /**
+   * Check the operators and bounds of a scan, end the scan the cursor had open, if any, and position
+   * the cursor on the first entry in range, or the last one for a descending scan.
+   */
+	void openCursor(BTreeScanCursor& cursor, const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const bool descending);
+
+  /**
+   * Read every tuple of the base relation and bulk load an entry for each of them.
+   *
+   * @param relationName	Name of the base relation
+   */
+	template <class T>
+	void loadRelation(const std::string & relationName);
+
+  /**
+   * Build the tree bottom-up from a set of entries. The entries are sorted, packed into
+   * leaves starting at the root page up to fillFactor, and the non-leaf levels are then built
+   * one level at a time on top of the leaves. Pages are allocated in order, so the whole build
+   * is a single pass of sequential writes.
+   *
+   * @param entries			Key-rid pairs of every tuple in the relation. Sorted in place.
+   */
+	template <class T>
+	void bulkLoad(std::vector<RIDKeyPair<T> >& entries);
+
+  /**
+   * Build non-leaf levels on top of a level of nodes until a single root node is left.
+   *
+   * @param level			Page number and lowest key of every node of the level, left to right.
+   *									Holds only the root on return.
+   * @param nodeLevel		Level of the first non-leaf level to build
+   * @return					Page number of the root
+   */
+	template <class T>
+	PageId buildUpperLevels(std::vector<PageKeyPair<T> >& level, int nodeLevel);
+
+  /**
+   * Number of keys to place in a node of the given occupancy according to fillFactor.
+   */
+	int nodeFill(int occupancy);
+
+  /**
+   * Make pageNum the root of the tree and record it in the meta page.
+   */
+	void setRoot(PageId pageNum, bool isLeaf);
+
+  /**
+   * Allocate a page for a node, reusing a page from the free list if there is one. The page is pinned.
+   */
+	void allocNode(PageId& pageNum, Page*& page);
+
+  /**
+   * Put a pinned node page on the free list and unpin it.
+   */
+	void freeNode(PageId pageNum, Page* page);
+
+  /**
+   * NodeType of new non-leaf nodes: BLOCKED_NONLEAF_NODE if blockedNonLeaves is set, NONLEAF_NODE otherwise.
+   */
+	std::int16_t nonLeafNodeType() const;
+
+  /**
+   * Record the head of the free list in the meta page.
+   */
+	void setFreeList(PageId pageNum);
+
+  /**
+   * deleteEntry for keys of type T.
+   */
+	template <class T>
+	void deleteKey(const void* key, const RecordId rid);
+
+  /**
+   * Remove the entry of key and rid from the subtree rooted at pageNum and rebalance the nodes
+   * below pageNum that fell under lowWaterFill.
+   *
+   * @param underflow		Set if the node at pageNum itself fell under lowWaterFill
+   * @return						Whether the entry was found
+   */
+	template <class T>
+	bool deleteFrom(PageId pageNum, const T& key, const RecordId& rid, bool& underflow);
+
+  /**
+   * Fix up child i of a non-leaf node after it fell under lowWaterFill, by merging it with a
+   * neighbour if the two fit in one node and otherwise by moving entries over from the neighbour.
+   */
+	template <class T>
+	void rebalanceChild(NonLeafNode<T>* parent, int i);
+
+  /**
+   * rebalanceChild for STRING nodes.
+   */
+	void rebalanceChildString(StringNonLeafNode* parent, int i);
+
+  /**
+   * insertEntry for keys of type T.
+   */
+	template <class T>
+	void insertKey(const void* key, const RecordId rid);
+
+  /**
+   * insertEntries for keys of type T.
+   */
+	template <class T>
+	void insertKeys(const KeyRidPair* pairs, size_t n);
+
+  /**
+   * Insert a sorted run of entries into the subtree rooted at pageNum. Each child is
+   * visited once with every entry bound for it.
+   *
+   * @param pageNum			Root of the subtree
+   * @param entries			Entries sorted by key, all belonging in this subtree
+   * @param n						Number of entries
+   * @param newSiblings	Nodes split off to the right of pageNum, with the key to insert in the parent for each
+   */
+	template <class T>
+	void batchInsert(PageId pageNum, const RIDKeyPair<T>* entries, size_t n, std::vector<PageKeyPair<T> >& newSiblings);
+
+  /**
+   * Merge a sorted run of entries into a leaf with a single shift. If they do not fit, the
+   * merged entries are spread over the leaf and as many new right siblings as needed.
+   *
+   * @param pageNum			Page number of the leaf, for the left sibling link of the first new leaf
+   */
+	template <class T>
+	void leafMerge(PageId pageNum, LeafNode<T>* leafNode, const RIDKeyPair<T>* entries, size_t n, std::vector<PageKeyPair<T> >& newSiblings);
+
+  /**
+   * Add the new siblings of split children to a non-leaf node, splitting it into as many
+   * nodes as needed.
+   *
+   * @param childSplits	New right sibling of a child, tagged with the index of the child that split, in order
+   */
+	template <class T>
+	void nonLeafMerge(NonLeafNode<T>* nonLeafNode, const std::vector<std::pair<int, PageKeyPair<T> > >& childSplits, std::vector<PageKeyPair<T> >& newSiblings);
+
+  /**
+   * leafMerge for STRING leaves. The leaf is decoded, merged with the entries and encoded again,
+   * as several leaves if the entries no longer fit.
+   */
+	void leafMergeString(PageId pageNum, StringLeafNode* leafNode, const RIDKeyPair<StringKey>* entries, size_t n, std::vector<PageKeyPair<StringKey> >& newSiblings);
+
+  /**
+   * nonLeafMerge for STRING non-leaf nodes.
+   */
+	void nonLeafMergeString(StringNonLeafNode* nonLeafNode, const std::vector<std::pair<int, PageKeyPair<StringKey> > >& childSplits, std::vector<PageKeyPair<StringKey> >& newSiblings);
+
+  /**
+   * openCursor for keys of type T, once the operators have been checked.
+   */
+	template <class T>
+	void positionScan(BTreeScanCursor& cursor, const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * The part of the constructors after the key has been set up: open the index file, or create it and
+   * bulk load the relation.
+   */
+	void openIndex(const std::string & relationName, std::string & outIndexName, BufMgr *bufMgrIn,
+						const int attrByteOffset, const Datatype attrType, const double fillFactor,
+						const int postingMinDuplicates, const bool packedLeaves, const bool blockedNonLeaves);
+
+  /**
+   * openScan of several ranges for keys of type T. Checks the ranges, stores their bounds in the cursor
+   * and puts it on the first range with an entry.
+   */
+	template <class T>
+	void positionRanges(BTreeScanCursor& cursor, const ScanRange* ranges, size_t numRanges);
+
+  /**
+   * Put a multi-range scan cursor on the leaf for key, which lies beyond the current leaf. The descent
+   * starts from the lowest node of the cursor's last descent that holds key in a child other than its
+   * last one, and so in its own subtree, or from the root on the first descent and in thread-safe mode.
+   *
+   * @param lower			Whether separators equal to key send the descent left
+   */
+	template <class T>
+	void skipTo(BTreeScanCursor& cursor, const T& key, bool lower);
+
+  /**
+   * lookup for keys of type T.
+   */
+	template <class T>
+	size_t lookupKey(const T& key, RecordId* out, size_t max);
+
+  /**
+   * Pin the leaf a descent for key ends at, or in thread-safe mode copy it into copy.
+   *
+   * @param lower			Whether separators equal to key send the descent left
+   * @param pageNum		Page number of the leaf
+   * @param leaf			The pinned leaf, or copy
+   */
+	template <class T>
+	void readLeaf(const T& key, bool lower, PageId& pageNum, Page*& leaf, Page* copy);
+
+  /**
+   * Release a leaf from readLeaf and read its right sibling the same way, or its left sibling if left
+   * is set. The leaf must have one.
+   */
+	void nextLeaf(PageId& pageNum, Page*& leaf, Page* copy, bool left = false);
+
+  /**
+   * Unpin a leaf from readLeaf or nextLeaf, unless it is a copy.
+   */
+	void releaseLeaf(PageId pageNum);
+
+  /**
+   * countRange for keys of type T, once the operators have been checked.
+   */
+	template <class T>
+	size_t countKeys(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * minKey, or maxKey if max is set, for keys of type T.
+   */
+	template <class T>
+	bool edgeKey(bool max, void* out);
+
+  /**
+   * estimateRange for keys of type T, once the operators have been checked.
+   */
+	template <class T>
+	double estimateKeys(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * Estimated number of entries before the position of key in the index, the position of its first
+   * entry if lower is set and the one after its last entry otherwise. Reads only non-leaf nodes.
+   *
+   * @return				false if a thread-safe descent met a node being changed and has to start over
+   */
+	template <class T>
+	bool estimateRank(const T& key, bool lower, double& rank);
+
+
+  /**
+   * Number of entries in the subtree under a node. A leaf counts the record ids of its posting lists,
+   * a non-leaf node adds up the counts of its children.
+   */
+	template <class T>
+	std::uint32_t subtreeEntries(const Page* node);
+
+  /**
+   * Write sorted record ids to a new posting list.
+   *
+   * @return				Page number of the first page of the list
+   */
+	PageId createPosting(const RecordId* rids, size_t n);
+
+  /**
+   * Add a record id to the posting list starting at firstPageNum. A page that overflows is split in
+   * two.
+   */
+	void postingAdd(PageId firstPageNum, const RecordId& rid);
+
+  /**
+   * Remove a record id from the posting list starting at firstPageNum. Pages left empty are freed.
+   *
+   * @param empty			Set if the list lost its last record id and was freed altogether
+   * @return					Whether the record id was in the list
+   */
+	bool postingRemove(PageId firstPageNum, const RecordId& rid, bool& empty);
+
+  /**
+   * Number of record ids in the posting list starting at firstPageNum.
+   */
+	std::uint32_t postingSize(PageId firstPageNum);
+
+  /**
+   * Read the record ids of one posting list page into rids. In thread-safe mode the read is done
+   * again if an exclusive operation ran during it. A page that is no longer part of a posting list
+   * reads as empty.
+   *
+   * @return				The next page of the list, 0 if there is none
+   */
+	PageId loadPosting(PageId pageNum, std::vector<RecordId>& rids);
+
+  /**
+   * Number of entries in slots first to last - 1 of a leaf, counting every record id of their
+   * posting lists.
+   */
+	template <class T>
+	size_t leafEntries(const Page* leaf, int first, int last);
+
+  /**
+   * Copy the record ids of slots first to last - 1 of a leaf to out, expanding posting lists.
+   *
+   * @return				Number of record ids written, at most max
+   */
+	template <class T>
+	size_t copyLeafRids(const Page* leaf, int first, int last, RecordId* out, size_t max);
+
+  /**
+   * Insert an entry into a leaf through a posting list: added to the list of its key if there is
+   * one, or with the entries of its key moved to a new list once they reach postingMinDuplicates.
+   *
+   * @return				false if the entry was not inserted and goes into the leaf as usual
+   */
+	template <class T>
+	bool postingInsert(LeafNode<T>* leafNode, const RIDKeyPair<T>& dataEntry);
+
+  /**
+   * Whether postingInsert would handle an entry of key in a leaf.
+   */
+	template <class T>
+	bool touchesPosting(const Page* leaf, const T& key) const;
+
+  /**
+   * Replace each run of at least postingMinDuplicates entries of one key in sorted entries with a
+   * single entry pointing to a posting list of them. ids gets the number of ids each entry stands for.
+   */
+	template <class T>
+	void foldPostings(std::vector<RIDKeyPair<T> >& entries, std::vector<std::uint32_t>& ids);
+
+  /**
+   * bulkLoad for an index with packed leaves. The entries are cut into leaves by their packed size.
+   * ids is as foldPostings leaves it, empty if no lists were folded. Like the other packed leaf methods it
+   * is only written for INTEGER keys, and throws BadIndexInfoException for any other type.
+   */
+	template <class T>
+	void bulkLoadPacked(std::vector<RIDKeyPair<T> >& entries, const std::vector<std::uint32_t>& ids);
+
+  /**
+   * leafMerge for a packed leaf. The leaf is decoded, merged with the entries and encoded again,
+   * as several leaves if the entries no longer fit.
+   */
+	template <class T>
+	void leafMergePacked(PageId pageNum, Page* leaf, const RIDKeyPair<T>* entries, size_t n, std::vector<PageKeyPair<T> >& newSiblings);
+
+  /**
+   * The leaf case of deleteFrom for a packed leaf. The leaf at pageNum is pinned, and unpinned on return.
+   */
+	template <class T>
+	bool deleteFromPacked(PageId pageNum, Page* leaf, const T& key, const RecordId& rid, bool& underflow);
+
+  /**
+   * The leaf case of rebalanceChild for packed leaves. The entries of both leaves are merged into the
+   * left one if they fit, and spread over the two otherwise. Leaves whose entries do not fit in two
+   * leaves at all are left as they are.
+   *
+   * @param separator		Key in the parent between the two leaves, set to the new first key of the right one
+   * @return						Whether the right leaf was merged into the left one
+   */
+	template <class T>
+	bool rebalancePacked(Page* leftPage, Page* rightPage, T& separator);
+
+  /**
+   * Add one to the count of the child for key in each node above level topLevel, once the insert has
+   * released its latches. The nodes may have split or changed since the insert's descent, so a new
+   * optimistic descent for key finds them. Each node is latched at the version it was read at while its
+   * count changes, and the descent starts over from the levels still to count if one has moved on.
+   * Only one latch is held at a time and it is never waited for, so this cannot deadlock with inserts.
+   */
+	template <class T>
+	void addPathCounts(const T& key, int topLevel);
+
+  /**
+   * Put a new root of the given level above the old root and newNodeInfo, its new right sibling.
+   *
+   * @param rootCount		Entries left under the old root
+   */
+	template <class T>
+	void rootSplit(PageKeyPair<T> newNodeInfo, std::uint32_t rootCount, int level);
+
+  /**
+   * Split a full non-leaf node while adding the new right sibling of its child pos. The sibling goes
+   * next to that child rather than after every separator equal to its key, which with duplicate keys
+   * may be further right.
+   *
+   * @param rightEdge		Whether the node is the last of its level. Its last child splitting is then
+   *										taken for appends, and the node keeps as many keys as nodeFill gives it
+   */
+	template <class T>
+	void nonLeafSplit(NonLeafNode<T>* nonleafNode, PageKeyPair<T>& newNonLeafPage, PageKeyPair<T> pageEntry, int pos, bool rightEdge);
+
+  /**
+   * Split a full leaf in two while adding an entry. An entry past the end of the rightmost leaf leaves
+   * the leaf with as many entries as nodeFill gives it, the rest go to the new leaf.
+   *
+   * @param pageNum			Page number of the leaf, for the left sibling link of the new leaf
+   */
+	template <class T>
+	void leafSplit(PageId pageNum, LeafNode<T>* leafNode, PageKeyPair<T>& newLeafPage, RIDKeyPair<T> dataEntry);
+
+	template <class T>
+	void leafInsert(LeafNode<T> * leafNode, RIDKeyPair<T> dataEntry);
+
+  /**
+   * Point the left sibling link of the leaf at pageNum to leftPageNum, after the leaves between them
+   * changed. Nothing is done for pageNum 0, the end of the leaf level.
+   */
+	void setLeftSibling(PageId pageNum, PageId leftPageNum);
+
+	template <class T>
+	void rootLeafInsert(LeafNode<T> * rootNode, RIDKeyPair<T> dataEntry, bool split);
+
+  /**
+   * @param rightEdge		Whether curPageNum is the last node of its level
+   */
+	template <class T>
+	void findandInsert(RIDKeyPair<T> dataEntry, PageId curPageNum, PageKeyPair<T>& splitEntry, bool rightEdge);
+
+  /**
+   * Add the new right sibling of child i to a non-leaf node with room for it.
+   */
+	template <class T>
+	void nonLeafInsert(NonLeafNode<T> * nonLeafNode, PageKeyPair<T> pageEntry, int i);
+
+
+ public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it and bulk load entries for every tuple in the base relation using FileScan class.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param fillFactor					Fraction of each node filled when a new index is bulk loaded
+   * @param postingMinDuplicates	See setPostingLists. Also applies to the bulk load of a new index
+   * @param packedLeaves				Store the leaves of a new INTEGER index as PackedLeafNode pages. An existing
+   *                                    index keeps the leaves it was built with
+   * @param blockedNonLeaves		Give the non-leaf nodes of a new INTEGER or DOUBLE index a block directory, see
+   *                                    BLOCKED_NONLEAF_NODE. An existing index keeps the layout it was built with
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters,
+   *                                    or the file was written with a different INDEX_FORMAT_VERSION.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const double fillFactor = BULKLOAD_FILL_FACTOR, const int postingMinDuplicates = 0,
+						const bool packedLeaves = false, const bool blockedNonLeaves = false);
+
+
+  /**
+   * BTreeIndex Constructor for a composite key over several attributes, compared column by column in
+   * order. The file is named after the relation and the offsets of all the columns.
+   * Keys passed to the other methods, scan bounds included, are made with makeKey, and openPrefixScan
+   * finds the entries matching values of the leading columns.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param keyColumns					Offset and Datatype of every attribute of the key, see compositekey::validColumns
+   * @param fillFactor					Fraction of each node filled when a new index is bulk loaded
+   * @throws  BadIndexInfoException     If the columns cannot make up a key, or the index file already exists
+   *                                    but was built over other columns, see the other constructor.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn, const std::vector<KeyColumn>& keyColumns,
+						const double fillFactor = BULKLOAD_FILL_FACTOR);
 	
 
   /**
@@ -346,6 +2096,145 @@ bool compK(int lowValInt,const Operator lowOp,int highValInt,const Operator high
 	void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Insert a batch of entries. The batch is sorted and inserted top-down in one pass: every node on the
+	 * way is read once, all keys bound for a leaf are merged into it with one shift, and nodes that overflow
+	 * are split into as many nodes as needed at once, with their new separators carried up together.
+	 * Sorted or clustered batches touch each leaf once instead of once per key.
+   * @param pairs		Entries to insert, in any order
+   * @param n				Number of entries
+	**/
+	void insertEntries(const KeyRidPair* pairs, size_t n);
+
+
+  /**
+	 * Find the entries of one key. Descends to the leaf of the key, copies the record ids of its entries
+	 * and unpins the leaf, all in one call. No scan state is set up and a missing key is not an error.
+	 * Entries of a key that continue on the next leaves are followed there.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param out			Array of at least max record ids the entries are returned in
+   * @param max			Most entries to return
+   * @return				Number of record ids written to out, 0 if the key is not in the index.
+	 *								max if the key may have more entries than that.
+	**/
+	size_t lookup(const void* key, RecordId* out, size_t max);
+
+
+  /**
+	 * Count the entries in a range without fetching them. Leaves the range covers whole are counted by
+	 * their key count and the sizes of their posting lists, only the leaves the range starts and ends in are searched.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return				Number of entries in range, 0 if there are none
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Estimate the number of entries in a range from the entry counts non-leaf nodes keep for each
+	 * child, reading leaves only where posting lists are. Each bound is followed down one path, adding
+	 * up the counts of the children left of it, so the cost is O(height) page reads and usually none at
+	 * all with the upper levels cached. Only the leaf a bound falls in is not counted exactly: the part
+	 * of it below the bound is interpolated between the separators around it for INTEGER and DOUBLE
+	 * keys, and taken as half for STRING keys. A leaf counted with more entries than it has slots holds
+	 * posting lists, whose entries all sit at one key, so that leaf is read and counted exactly.
+	 * The estimate differs from countRange by at most the number of entries in the two leaves the
+	 * bounds fall in, so never by more than 2 * leaf capacity. In thread-safe mode an insert reaches the
+	 * counts above its leaf shortly after it returns, so inserts still in progress may be missed.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return				Estimated number of entries in range, never negative
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Smallest key of the index, found on the leftmost path down the tree.
+   * @param out			Where the key is written: an integer, a double, or STRINGSIZE + 1 bytes for a
+	 *								null-terminated string
+   * @return				false, with out unchanged, if the index is empty
+	**/
+	bool minKey(void* out);
+
+
+  /**
+	 * Largest key of the index, found on the rightmost path down the tree.
+   * @param out			Where the key is written, see minKey
+   * @return				false, with out unchanged, if the index is empty
+	**/
+	bool maxKey(void* out);
+
+
+  /**
+	 * Open a filtered scan of the index on a cursor of its own. Scans opened this way do not affect
+	 * each other or the scan of startScan.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param descending	Return the entries from the high bound down, for ORDER BY ... DESC and top-N
+   *										queries. The cursor then starts at the last entry in range and walks left.
+   * @return				Cursor positioned on the first entry in range, or the last for a descending scan
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	BTreeScanCursor openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const bool descending = false);
+
+
+  /**
+	 * Open a scan of several ranges, such as the keys of an IN list or the ranges of a disjunction, on a
+	 * cursor of its own. The ranges are scanned in one pass from left to right: the scan goes on with the
+	 * next range in the leaf where the last one ended if it starts there, and otherwise re-descends only
+	 * from the lowest node above the current leaf that covers it, instead of from the root.
+   * @param ranges	Ranges sorted by key that do not overlap, see ScanRange::setPoint for single keys
+   * @param numRanges	Number of ranges
+   * @return				Cursor positioned on the first entry in any of the ranges
+   * @throws  BadOpcodesException If an operator of a range is not one of its expected values
+   * @throws  BadScanrangeException If the low value of a range is greater than its high value, or the
+   *										ranges are out of order or overlap
+	 * @throws  NoSuchKeyFoundException If no key in the B+ tree lies in any of the ranges.
+	**/
+	BTreeScanCursor openScan(const ScanRange* ranges, size_t numRanges);
+
+  /**
+   * Datatype of the keys of the index. STRING for a composite key.
+   */
+	Datatype keyType() const;
+
+
+  /**
+	 * Make the key of a composite index for values of its leading columns. A key of every column is
+	 * passed to insertEntry, deleteEntry and lookup, keys of fewer columns sort before every key they
+	 * are a prefix of and can be scan bounds.
+   * @param values	Pointers to integer / double / char string, one for each of the first numValues columns
+   * @param numValues	Number of values, at most the number of columns
+   * @param out			At least STRINGSIZE + 1 bytes, receives the key as a null-terminated string
+   * @throws  BadScanParamException If the index does not have a composite key, or numValues is out of range
+	**/
+	void makeKey(const void* const* values, int numValues, char* out) const;
+
+
+  /**
+	 * Open a scan of the entries of a composite index whose leading numValues columns hold values, in
+	 * key order. With no values every entry is scanned.
+   * @param values	Pointers to integer / double / char string, one for each of the first numValues columns
+   * @param numValues	Number of values, at most the number of columns
+   * @return				Cursor positioned on the first matching entry
+   * @throws  BadScanParamException If the index does not have a composite key, or numValues is out of range
+	 * @throws  NoSuchKeyFoundException If no entry matches.
+	**/
+	BTreeScanCursor openPrefixScan(const void* const* values, int numValues);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -374,27 +2263,142 @@ bool compK(int lowValInt,const Operator lowOp,int highValInt,const Operator high
 	void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record ids of up to max next entries that match the scan, a leaf at a time.
+	 * See BTreeScanCursor::scanNextBatch.
+   * @param out			Array of at least max record ids the entries are returned in
+   * @param max			Most entries to return
+   * @return				Number of record ids written to out. 0 once the scan has no more entries.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	void endScan();
-    
-    
-    void rootSplit(PageKeyPair<int> newNodeInfo, int level);
-    
-    void nonLeafSplit(NonLeafNodeInt* nonleafNode, PageKeyPair<int>& newNonLeafPage, PageKeyPair<int> pageEntry);
-    
-    void leafSplit(LeafNodeInt* leafNode, PageKeyPair<int>& newLeafPage, RIDKeyPair<int> dataEntry);
-    
-    void leafInsert(LeafNodeInt * leafNode, RIDKeyPair<int> dataEntry);
-    
-    void rootLeafInsert(LeafNodeInt * rootNode, RIDKeyPair<int> dataEntry, bool split);
-    
-    void findandInsert(RIDKeyPair<int> dataEntry, PageId curPageNum, PageKeyPair<int>& splitEntry);
-    
-    void nonLeafInsert(NonLeafNodeInt * nonLeafNode, PageKeyPair<int> pageEntry);
+
+
+  /**
+	 * Delete the entry of a key and the record it points to.
+	 * Nodes are left underfull until they hold less than the low-water fill of their capacity. Then the node
+	 * merges with a sibling if both fit in one node, or takes entries from it otherwise. Pages freed by merges
+	 * go on a free list in the index file and are used for the next nodes allocated.
+	 * Entries must not be deleted while a scan is executing.
+   * @param key			Key of the entry, pointer to integer/double/char string
+   * @param rid			Record ID of the entry
+	 * @throws NoSuchKeyFoundException If the index holds no entry for this key and record ID.
+	**/
+	void deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Keep the entries of INTEGER and DOUBLE keys with many duplicates in posting lists: the leaf holds
+	 * the key once, pointing to a chain of pages with its record ids sorted and delta-encoded. Once an
+	 * insert brings a key in a leaf to minDuplicates entries they are moved to a list, and later
+	 * entries of the key go to it. Lists already in the index are kept and used whatever the setting.
+	 * insertEntries merges its entries into leaves as usual, next to any list of their key.
+	 * STRING keys are not affected.
+   * @param minDuplicates	Entries of one key that start a posting list, 0 for none
+	**/
+	void setPostingLists(int minDuplicates);
+
+
+  /**
+	 * Turn write-optimized mode on or off. In write-optimized mode insertEntry and deleteEntry only add
+	 * a message to a buffer the index keeps for the root, so random inserts do not each dirty a random
+	 * leaf. Once the buffer holds maxMessages messages, those bound for the children of the root with the
+	 * most of them, at least half of the buffer, are applied to the tree as one sorted batch, which
+	 * changes each leaf once per batch rather than once per message. Lookups, counts, estimates, minKey, maxKey and scans merge
+	 * the buffered messages with the leaves, so they see every change. deleteEntry still reads the
+	 * leaves to find the entry, but leaves them as they are. The buffer is applied when the mode is
+	 * turned off, when thread-safe mode is turned on and when the index is closed. insertEntries and
+	 * thread-safe mode do not buffer.
+   * @param maxMessages	Most messages buffered, 0 to turn write-optimized mode off
+	**/
+	void setWriteBuffer(int maxMessages);
+
+
+  /**
+	 * Set the low-water fill used by deleteEntry. 0 only rebalances nodes once they are empty,
+	 * 0.5 keeps every node but the root at least half full like a textbook B+ tree.
+   * @param fill		Fraction of node capacity, between 0 and 0.5
+	**/
+	void setLowWaterFill(double fill);
+
+
+  /**
+	 * Set how far range scans read ahead. When a scan moves to a new leaf it has the next leaves read
+	 * into the buffer pool by a background thread, so they are resident by the time the scan gets
+	 * there. How many depends on how much of the range seems to be left, up to maxPages. Turning it off
+	 * stops the background thread once the reads it has started are done. Must not be called while
+	 * other threads use the index.
+   * @param maxPages	Most leaves read ahead of a scan, 0 to turn read-ahead off
+	**/
+	void setReadAhead(int maxPages);
+
+
+  /**
+	 * Set how many of the upper non-leaf nodes the index keeps pinned. Descents through these nodes
+	 * find them without a buffer pool lookup, only leaves and the lower non-leaf levels go through the
+	 * buffer pool. The root is cached first, then the levels below it as far as they fit. A new root
+	 * from a root split is added to the cache, and the cache is filled again once it no longer fits.
+	 * Must not be called while other threads use the index.
+   * @param maxPages	Most nodes kept pinned, 0 to turn the cache off
+	**/
+	void setUpperCache(int maxPages);
+
+
+  /**
+	 * Turn thread-safe mode on or off. Must not be called while other threads use the index.
+	 * In thread-safe mode any number of threads can call insertEntry and scan through their own cursors
+	 * from openScan at the same time. Readers take no latches: they read nodes at a version and start
+	 * over if a writer changed the node meanwhile. Inserts latch only the nodes they change, so inserts
+	 * into different leaves run side by side. deleteEntry and insertEntries are also safe to call, but
+	 * they run alone, after the inserts in progress, and no cursor may be open while they run, the same
+	 * as without threads. startScan, scanNext and endScan share one cursor and stay single-threaded.
+	 * Cursors copy the leaf they are on instead of keeping it pinned, and they see each leaf as it was
+	 * when they reached it.
+   * @param on			true for thread-safe mode
+	**/
+	void setThreadSafe(bool on);
 
 };
+
+/**
+ * STRING nodes are not arrays of fixed-size keys. These specializations handle them through
+ * stringnode in place of the generic node code.
+ */
+template <>
+void BTreeIndex::bulkLoad<StringKey>(std::vector<RIDKeyPair<StringKey> >& entries);
+
+template <>
+PageId BTreeIndex::buildUpperLevels<StringKey>(std::vector<PageKeyPair<StringKey> >& level, int nodeLevel);
+
+template <>
+void BTreeIndex::insertKey<StringKey>(const void* key, const RecordId rid);
+
+template <>
+void BTreeIndex::batchInsert<StringKey>(PageId pageNum, const RIDKeyPair<StringKey>* entries, size_t n, std::vector<PageKeyPair<StringKey> >& newSiblings);
+
+template <>
+void BTreeIndex::positionScan<StringKey>(BTreeScanCursor& cursor, const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+template <>
+void BTreeScanCursor::scanNextEntry<StringKey>(RecordId& outRid);
+
+template <>
+size_t BTreeScanCursor::scanNextBatchEntries<StringKey>(RecordId* out, size_t max);
+
+template <>
+int BTreeScanCursor::leavesLeft<StringKey>() const;
+
+template <>
+void BTreeIndex::insertBelow<StringKey>(PageId pageNum, const RIDKeyPair<StringKey>& dataEntry);
+
+template <>
+bool BTreeIndex::deleteFrom<StringKey>(PageId pageNum, const StringKey& key, const RecordId& rid, bool& underflow);
 	
 }
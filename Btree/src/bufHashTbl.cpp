@@ -15,7 +15,7 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+int BufHashTbl::hash(const File* file, const PageId pageNo) const
 {
   int tmp, value;
   tmp = (long)file;  // cast of pointer to the file object to an integer
@@ -24,8 +24,10 @@ int BufHashTbl::hash(const File* file, const PageId pageNo)
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(htSize), numLatches(htSize < 64 ? htSize : 64)
 {
+  latches = new std::mutex[numLatches];
+
   // allocate an array of pointers to hashBuckets
   ht = new hashBucket* [htSize];
   for(int i=0; i < HTSIZE; i++)
@@ -43,6 +45,7 @@ BufHashTbl::~BufHashTbl()
     }
   }
   delete [] ht;
+  delete [] latches;
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
@@ -68,6 +71,12 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!find(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::find(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
   int index = hash(file, pageNo);
   hashBucket* tmpBuc = ht[index];
@@ -75,12 +84,11 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+      return true;
     }
     tmpBuc = tmpBuc->next;
   }
-
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "file.h"
 
 namespace badgerdb {
@@ -40,7 +41,8 @@ struct hashBucket {
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* @warning The table does no locking of its own. The buckets are split into parts, each with a latch, and a
+* caller holds the latch of a page, see latch, around every call for that page.
 */
 class BufHashTbl
 {
@@ -54,6 +56,16 @@ class BufHashTbl
 	 */
   hashBucket**  ht;
 
+	/**
+	 * Number of parts the buckets are split into, each guarded by one latch
+	 */
+  int numLatches;
+
+	/**
+	 * Latches of the parts. Bucket i belongs to part i % numLatches
+	 */
+  std::mutex* latches;
+
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
 	 *
@@ -61,7 +73,7 @@ class BufHashTbl
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const File* file, const PageId pageNo) const;
 
  public:
 	/**
@@ -73,6 +85,18 @@ class BufHashTbl
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
+
+	/**
+   * Latch of the part of the table that (file, pageNo) hashes to. Entries of different parts can be
+   * looked up, inserted and removed at the same time.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 */
+  std::mutex& latch(const File* file, const PageId pageNo)
+  {
+    return latches[hash(file, pageNo) % numLatches];
+  }
 	
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
@@ -96,6 +120,17 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Like lookup, but reports a page that is not in the buffer pool by its return value. Misses are
+   * common on the read path, where an exception per miss would cost more than the lookup.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set if the page is found
+   * @return				true if the page entry is found in the hash table
+	 */
+  bool find(const File* file, const PageId pageNo, FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <iostream>
+#include <thread>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -54,105 +55,205 @@ BufMgr::~BufMgr() {
   delete [] bufPool;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FrameId & frame, std::unique_lock<std::mutex>& guard) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
   std::uint32_t numScanned = 0;
   bool found = 0;
+  FrameId chosen = 0;
 
   while (numScanned < 2*numBufs)	//Need to scn twice
   {
     // advance the clock
     advanceClock();
     numScanned++;
+    BufDesc* tmpbuf = &bufDescTable[clockHand];
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    // if invalid, use frame. A pinned invalid frame is being set up by another thread
+    if (! tmpbuf->valid)
     {
-      break;
-    }
-
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
-    {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      if (tmpbuf->pinCnt == 0)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+        chosen = clockHand;
         found = true;
         break;
       }
+      continue;
     }
-    else
+
+    // is valid, check referenced bit
+    if (tmpbuf->refbit)
     {
       // has been referenced, clear the bit
       bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      tmpbuf->refbit = false;
+      continue;
+    }
+
+    // check to see if someone has it pinned
+    if (tmpbuf->pinCnt != 0)
+    {
+      continue;
     }
+
+    if (tmpbuf->dirty)
+    {
+      // write the page back with the latch released. The pin keeps the frame, and the page stays
+      // in the hash table, so a thread that wants it meanwhile finds it here and not on disk
+      tmpbuf->pinCnt++;
+      tmpbuf->dirty = false;
+      guard.unlock();
+      try
+      {
+        std::lock_guard<std::mutex> io(ioLatch);
+        bufStats.diskwrites++;
+        tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[tmpbuf->frameNo]);
+      }
+      catch(...)
+      {
+        guard.lock();
+        tmpbuf->dirty = true;
+        tmpbuf->pinCnt--;
+        throw;
+      }
+      guard.lock();
+      tmpbuf->pinCnt--;
+
+      // pinned or changed again while it was written, leave it for a later round of the clock
+      if (tmpbuf->pinCnt != 0 || tmpbuf->dirty || tmpbuf->refbit)
+      {
+        continue;
+      }
+    }
+
+    // hasn't been referenced and is not pinned, use it
+    // remove previous entry from hash table. Hits pin the frame under its part latch without bufLatch,
+    // so it is only free if it is still unpinned under that latch
+    {
+      std::lock_guard<std::mutex> part(hashTable->latch(tmpbuf->file, tmpbuf->pageNo));
+      if (tmpbuf->pinCnt != 0 || tmpbuf->dirty || tmpbuf->refbit)
+      {
+        continue;
+      }
+      hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+    }
+    chosen = tmpbuf->frameNo;
+    found = true;
+    break;
   }
   
   // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (!found)
   {
     throw BufferExceededException();
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
-  {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
-  }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+	//Reset all the BufDesc entry for the frame before returning the frame, pinned by the caller
+  bufDescTable[chosen].Clear();
+  bufDescTable[chosen].pinCnt = 1;
 
   // return new frame number
-  frame = clockHand;
+  frame = chosen;
 } // end allocBuf
 
+bool BufMgr::waitForRead(FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  while (tmpbuf->ioPending.load(std::memory_order_acquire))
+  {
+    std::this_thread::yield();
+  }
+
+  // a failed read takes the page out of the frame before it clears ioPending
+  if (tmpbuf->valid)
+  {
+    return true;
+  }
+  tmpbuf->pinCnt--;
+  return false;
+}
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  bufStats.pins++;
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  while (!pinPage(file, pageNo, frameNo)) {}
+  page = &bufPool[frameNo];
+}
+
+bool BufMgr::pinPage(File* file, const PageId pageNo, FrameId& frameNo)
+{
+  // check to see if it is already in the buffer pool. A hit takes only the latch of its part of the
+  // hash table, a frame does not leave the table while that latch is held
+  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  bool hit;
+  {
+    std::lock_guard<std::mutex> part(hashTable->latch(file, pageNo));
+    hit = hashTable->find(file, pageNo, frameNo);
+    if (hit)
+    {
+      // set the referenced bit
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+    }
+  }
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+  // the page may still be on its way in. If that read failed, try it again from the start
+  if (hit)
+  {
+    return waitForRead(frameNo);
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+
+  //not in the buffer pool, must allocate a new page
+  std::unique_lock<std::mutex> guard(bufLatch);
+  allocBuf(frameNo, guard);
+
+  // another thread may have read the page in while allocBuf had the latch released
+  std::unique_lock<std::mutex> part(hashTable->latch(file, pageNo));
+  FrameId otherFrame;
+  if (hashTable->find(file, pageNo, otherFrame))
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    bufDescTable[frameNo].Clear();
+    return false;
+  }
 
+  // set up the entry properly, the page is read in with the latches released
+  bufDescTable[frameNo].Set(file, pageNo);
+  bufDescTable[frameNo].ioPending = true;
+  hashTable->insert(file, pageNo, frameNo);
+  part.unlock();
+  guard.unlock();
+
+  try
+  {
     // read the page into the new frame
+    std::lock_guard<std::mutex> io(ioLatch);
     bufStats.diskreads++;
     //status = file->readPage(pageNo, &bufPool[frameNo]);
     bufPool[frameNo] = file->readPage(pageNo);
-
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
-
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
   }
+  catch(...)
+  {
+    // threads waiting on the frame drop their pins when they see it is not valid
+    guard.lock();
+    part.lock();
+    hashTable->remove(file, pageNo);
+    bufDescTable[frameNo].valid = false;
+    bufDescTable[frameNo].file = NULL;
+    bufDescTable[frameNo].pinCnt--;
+    bufDescTable[frameNo].ioPending.store(false, std::memory_order_release);
+    throw;
+  }
+  bufDescTable[frameNo].ioPending.store(false, std::memory_order_release);
+  return true;
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  // the caller's pin keeps the frame, the part latch is enough to find it
+  std::lock_guard<std::mutex> part(hashTable->latch(file, pageNo));
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
@@ -169,25 +270,40 @@ void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::unique_lock<std::mutex> guard(bufLatch);
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(frameNo, guard);
+  guard.unlock();
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  try
+  {
+    std::lock_guard<std::mutex> io(ioLatch);
+    bufPool[frameNo] = file->allocatePage(pageNo);
+  }
+  catch(...)
+  {
+    guard.lock();
+    bufDescTable[frameNo].Clear();
+    throw;
+  }
   page = &bufPool[frameNo];
 
   // set up the entry properly
+  guard.lock();
   bufDescTable[frameNo].Set(file, pageNo);
 
   // insert in the hash table
+  std::lock_guard<std::mutex> part(hashTable->latch(file, pageNo));
   hashTable->insert(file, pageNo, frameNo);
 }
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::unique_lock<std::mutex> guard(bufLatch);
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
@@ -196,13 +312,37 @@ void BufMgr::flushFile(const File* file)
 	    if (tmpbuf->pinCnt > 0)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
-	    if (tmpbuf->dirty == true)
+	    // written with the latch released, the pin keeps the frame and the page in the pool meanwhile.
+	    // A write to the page in that time marks it dirty again
+	    while (tmpbuf->dirty == true)
 			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+				tmpbuf->pinCnt++;
 				tmpbuf->dirty = false;
+				guard.unlock();
+				try
+				{
+					std::lock_guard<std::mutex> io(ioLatch);
+					bufStats.diskwrites++;
+					//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
+					tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+				}
+				catch(...)
+				{
+					guard.lock();
+					tmpbuf->dirty = true;
+					tmpbuf->pinCnt--;
+					throw;
+				}
+				guard.lock();
+				tmpbuf->pinCnt--;
+				if (tmpbuf->pinCnt > 0)
+					throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
     	}
 
+    	// a hit may have pinned the page since, it leaves the hash table only unpinned
+    	std::lock_guard<std::mutex> part(hashTable->latch(file, tmpbuf->pageNo));
+    	if (tmpbuf->pinCnt > 0)
+    		throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
     	hashTable->remove(file,tmpbuf->pageNo);
     	tmpbuf->Clear();
   	}
@@ -213,22 +353,28 @@ void BufMgr::flushFile(const File* file)
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  {
+    std::lock_guard<std::mutex> guard(bufLatch);
+    std::lock_guard<std::mutex> part(hashTable->latch(file, pageNo));
+    //Deallocate from file altogether
+    //See if it is in the buffer pool
+    FrameId frameNo = 0;
+    hashTable->lookup(file, pageNo, frameNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+    // clear the page
+    bufDescTable[frameNo].Clear();
 
-	hashTable->remove(file, pageNo);
+    hashTable->remove(file, pageNo);
+  }
 
   // deallocate it in the file	
+  std::lock_guard<std::mutex> io(ioLatch);
   file->deletePage(pageNo);
 }
 
 void BufMgr::printSelf(void) 
 {
+  std::lock_guard<std::mutex> guard(bufLatch);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
@@ -9,6 +9,8 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include <atomic>
+#include <mutex>
 #include <iostream>
 
 namespace badgerdb {
@@ -42,14 +44,15 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. Pins of a page in the hash table are taken under the
+   * latch of its part of the table, without bufLatch
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
@@ -59,7 +62,13 @@ class BufDesc {
 	/**
    * Has this buffer frame been reference recently
 	 */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+	/**
+   * True while the page is being read from disk into the frame. Threads that find the frame in the
+   * hash table pin it and wait for this to clear before they look at the page
+	 */
+  std::atomic<bool> ioPending;
 
 	/**
    * Initialize buffer frame for a new user
@@ -72,6 +81,7 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+		ioPending = false;
   };
 
 	/**
@@ -102,9 +112,9 @@ class BufDesc {
 			std::cout << "file:NULL ";
 
 		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "pinCnt:" << pinCnt.load() << " ";
+		std::cout << "dirty:" << dirty.load() << " ";
+		std::cout << "refbit:" << refbit.load() << "\n";
   }
 
 	/**
@@ -127,6 +137,12 @@ struct BufStats
 	 */
   int accesses;
 
+	/**
+   * Number of pages pinned by readPage, whether they were in the buffer pool or not. Counted without
+   * bufLatch, which hits do not take
+	 */
+  std::atomic<int> pins;
+
 	/**
    * Number of pages read from disk (including allocs)
 	 */
@@ -142,7 +158,7 @@ struct BufStats
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = pins = diskreads = diskwrites = 0;
   }
       
 	/**
@@ -156,7 +172,15 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file.
+* Calls may come from several threads. A page already in the buffer pool is pinned and unpinned under the
+* latch of its part of the hash table alone, with an atomic pin count, so hits on different pages do not wait
+* for each other. Frame allocation, the clock and the frame table are kept under bufLatch, which is taken
+* before a part latch and is never held during disk I/O. A frame leaves the hash table only under its part
+* latch with no pins, so a hit either pins it first or does not find it. A frame whose page is still being
+* read is pinned by its reader, so it cannot be taken by another page, and threads that find it wait for the
+* read to finish. A dirty page that is written back to make room stays in the hash table until the write is
+* done, so no thread reads its old contents from the file meanwhile.
 */
 class BufMgr 
 {
@@ -186,6 +210,17 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Guards frame allocation, the clock hand and the setting up and clearing of frames. Not held during disk
+   * I/O, and not taken by hits, see BufHashTbl::latch
+	 */
+  std::mutex bufLatch;
+
+	/**
+   * Serializes disk I/O. Files share one stream per file name, which is not safe to use from two threads
+	 */
+  std::mutex ioLatch;
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
@@ -195,12 +230,29 @@ class BufMgr
   }
 
 	/**
-	 * Allocate a free frame.  
+	 * Allocate a free frame. The frame is returned pinned once and out of the hash table, so nothing else
+	 * takes it before the caller sets it up. A dirty page is written back with the latch released.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param guard			Holds bufLatch, on entry and on return
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, std::unique_lock<std::mutex>& guard);
+
+	/**
+	 * Pin a page, reading it into a new frame if it is not in the buffer pool.
+	 *
+	 * @param frameNo		Frame the page is pinned in
+	 * @return				false, with nothing pinned, if another thread got in the way and the caller has to try again
+	 */
+  bool pinPage(File* file, const PageId pageNo, FrameId& frameNo);
+
+	/**
+	 * Wait for the read of a frame the caller has pinned to finish.
+	 *
+	 * @return				false, with the pin dropped, if the read failed and the frame holds no page
+	 */
+  bool waitForRead(FrameId frame);
 
  public:
 	/**
@@ -0,0 +1,123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "composite_key.h"
+
+namespace badgerdb
+{
+namespace compositekey
+{
+
+///bits of a value carried by every byte of a key
+static const int DIGITBITS = 7;
+
+///top bit set on every byte written, which keeps zero bytes out of the key
+static const unsigned char DIGITMARK = 0x80;
+
+static int digitsFor(const int bits)
+{
+    return (bits + DIGITBITS - 1) / DIGITBITS;
+}
+
+/**
+ * Write the low bits bits of value most significant first, seven to a byte.
+ */
+static void writeDigits(std::uint64_t value, const int bits, unsigned char* out)
+{
+    int n = digitsFor(bits);
+    for(int i = n - 1; i >= 0; i--){
+        out[i] = DIGITMARK | (unsigned char)(value & 0x7f);
+        value >>= DIGITBITS;
+    }
+}
+
+int columnBytes(const Datatype type)
+{
+    switch(type){
+    case INTEGER: return digitsFor(32);
+    case DOUBLE: return digitsFor(64);
+    case STRING: return 0;
+    }
+    return 0;
+}
+
+bool validColumns(const KeyColumn* columns, const int numColumns)
+{
+    if(numColumns < 1 || numColumns > MAX_KEY_COLUMNS) return false;
+    int bytes = 0;
+    for(int c = 0; c < numColumns; c++){
+        if(columns[c].type == STRING){
+            if(c != numColumns - 1) return false;
+            bytes++;
+        }
+        bytes += columnBytes(columns[c].type);
+    }
+    return bytes <= STRINGSIZE;
+}
+
+/**
+ * Encode one value at out, with at most room bytes for a STRING value of at most maxLen bytes.
+ *
+ * @return				Bytes written
+ */
+static int encodeColumn(const Datatype type, const char* value, const size_t maxLen, unsigned char* out, const int room)
+{
+    switch(type){
+    case INTEGER:{
+        ///flipping the sign bit puts negative values below positive ones
+        std::int32_t v;
+        memcpy(&v, value, sizeof(v));
+        writeDigits((std::uint32_t)v ^ 0x80000000u, 32, out);
+        return columnBytes(INTEGER);
+    }
+    case DOUBLE:{
+        ///positive doubles order like their bits once the sign bit is set, negative ones once every
+        ///bit is flipped. -0.0 is written as 0.0, the index treats them as one key
+        double v;
+        memcpy(&v, value, sizeof(v));
+        if(v == 0) v = 0;
+        std::uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        bits = (bits >> 63) ? ~bits : bits | (std::uint64_t(1) << 63);
+        writeDigits(bits, 64, out);
+        return columnBytes(DOUBLE);
+    }
+    case STRING:{
+        size_t len = 0;
+        while(len < maxLen && len < (size_t)room && value[len] != '\0') len++;
+        memcpy(out, value, len);
+        return (int)len;
+    }
+    }
+    return 0;
+}
+
+void encodeValues(const KeyColumn* columns, const int numValues, const void* const* values, char* out)
+{
+    unsigned char* key = (unsigned char*)out;
+    int used = 0;
+    for(int c = 0; c < numValues; c++){
+        used += encodeColumn(columns[c].type, (const char*)values[c], STRINGSIZE, key + used, STRINGSIZE - used);
+    }
+    key[used] = '\0';
+}
+
+void encodeRecord(const KeyColumn* columns, const int numColumns, const char* record, const size_t recordSize, char* out)
+{
+    unsigned char* key = (unsigned char*)out;
+    int used = 0;
+    for(int c = 0; c < numColumns; c++){
+        used += encodeColumn(columns[c].type, record + columns[c].offset, recordSize - columns[c].offset, key + used, STRINGSIZE - used);
+    }
+    key[used] = '\0';
+}
+
+}
+}
@@ -0,0 +1,57 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Encoding of composite keys into STRING keys.
+ *
+ * The columns of a composite key are written one after the other into one byte string that compares
+ * with memcmp in the order of the columns. INTEGER and DOUBLE values are turned into unsigned integers
+ * of the same order and written most significant bits first, seven bits to a byte with the top bit set,
+ * so every column has a fixed width and no byte is zero. A STRING column can only be the last one and
+ * takes the bytes that are left. The whole key is then an ordinary null-terminated string, and a
+ * composite index is a STRING index over these strings, with the prefix compression of its nodes.
+ * A key made of the leading columns only is a prefix of the keys it matches.
+ */
+namespace compositekey
+{
+
+/**
+ * Bytes a column of type type takes in a key. STRING columns take the bytes left and give 0.
+ */
+int columnBytes(const Datatype type);
+
+/**
+ * Whether columns can make up a key: one to MAX_KEY_COLUMNS of them, a STRING column only as the last
+ * one, and at least one byte left for it within STRINGSIZE.
+ */
+bool validColumns(const KeyColumn* columns, const int numColumns);
+
+/**
+ * Encode values of the first numValues columns into out, null-terminated.
+ *
+ * @param values		Pointers to integer / double / char string, one per column
+ * @param out				At least STRINGSIZE + 1 bytes
+ */
+void encodeValues(const KeyColumn* columns, const int numValues, const void* const* values, char* out);
+
+/**
+ * Encode the columns of a record into out, null-terminated. A STRING column ends at its terminator or
+ * at the end of the record.
+ *
+ * @param out				At least STRINGSIZE + 1 bytes
+ */
+void encodeRecord(const KeyColumn* columns, const int numColumns, const char* record, const size_t recordSize, char* out);
+
+}
+}
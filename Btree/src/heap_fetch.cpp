@@ -0,0 +1,108 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "heap_fetch.h"
+#include "file.h"
+#include "exceptions/end_of_file_exception.h"
+
+namespace badgerdb {
+
+///record ids in the order of the file: by page, then by slot within the page
+static bool ridLess(const RecordId& a, const RecordId& b)
+{
+  if(a.page_number != b.page_number) return a.page_number < b.page_number;
+  return a.slot_number < b.slot_number;
+}
+
+HeapFetch::HeapFetch(const std::string &name, BufMgr *bufferMgr, BTreeScanCursor& cursor)
+{
+	bufMgr = bufferMgr;
+  ///a leaf at a time, the cursor keeps no more than one leaf pinned while the ids are collected
+  RecordId batch[512];
+  size_t n;
+  while((n = cursor.scanNextBatch(batch, 512)) > 0)
+  {
+    rids.insert(rids.end(), batch, batch + n);
+  }
+  open(name);
+}
+
+HeapFetch::HeapFetch(const std::string &name, BufMgr *bufferMgr, const RecordId* ridsIn, const size_t n)
+{
+	bufMgr = bufferMgr;
+  rids.assign(ridsIn, ridsIn + n);
+  open(name);
+}
+
+void HeapFetch::open(const std::string &name)
+{
+  std::sort(rids.begin(), rids.end(), ridLess);
+  file = new PageFile(name, false);	//dont create new file
+  nextRid = 0;
+  curPage = NULL;
+  curPageNum = 0;
+  numPagesRead = 0;
+}
+
+HeapFetch::~HeapFetch()
+{
+  if (curPage != NULL)
+  {
+    bufMgr->unPinPage(file, curPageNum, false);
+    curPage = NULL;
+  }
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void HeapFetch::scanNext(RecordId& outRid)
+{
+  if (nextRid == rids.size())
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPageNum, false);
+      curPage = NULL;
+    }
+    throw EndOfFileException();
+  }
+
+  // the ids are sorted, so a page is left for good once the next id is on another one
+  const RecordId& rid = rids[nextRid];
+  if (curPage == NULL || rid.page_number != curPageNum)
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPageNum, false);
+      curPage = NULL;
+    }
+    bufMgr->readPage(file, rid.page_number, curPage);
+    curPageNum = rid.page_number;
+    numPagesRead++;
+  }
+
+  outRid = rid;
+  nextRid++;
+}
+
+std::string HeapFetch::getRecord()
+{
+  return curPage->getRecord(rids[nextRid - 1]);
+}
+
+size_t HeapFetch::size() const
+{
+  return rids.size();
+}
+
+size_t HeapFetch::pagesRead() const
+{
+  return numPagesRead;
+}
+
+}
@@ -0,0 +1,112 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Reads the records of an index scan from the relation in page order.
+ *
+ * The record ids of the scan are collected first and sorted by page and slot. scanNext then moves
+ * through them, so each heap page is pinned once for all of its matching records and the pages are
+ * read in file order, instead of one pin per entry in key order. Records come back in page order,
+ * not key order.
+ */
+class HeapFetch
+{
+ public:
+
+  /**
+   * Collect the record ids of every entry left in cursor. The cursor ends up exhausted.
+   *
+   * @param name			Relation the index was built on
+   * @param bufMgr		Buffer Manager instance
+   * @param cursor		Open scan of the index
+   */
+  HeapFetch(const std::string &name, BufMgr *bufMgr, BTreeScanCursor& cursor);
+
+  /**
+   * Fetch the records of n record ids, in any order.
+   */
+  HeapFetch(const std::string &name, BufMgr *bufMgr, const RecordId* rids, const size_t n);
+
+  ~HeapFetch();
+
+  /**
+   * Move to the next record, in page order.
+   *
+   * @param outRid		Record id of the record
+   * @throws EndOfFileException	If every record has been returned
+   */
+  void scanNext(RecordId& outRid);
+
+  /**
+   * Current record. Its page stays pinned until scanNext moves to another page.
+   */
+  std::string getRecord();
+
+  /**
+   * Number of records the fetch returns in all.
+   */
+  size_t size() const;
+
+  /**
+   * Number of heap pages pinned so far, once each.
+   */
+  size_t pagesRead() const;
+
+ private:
+  /**
+   * Sort rids by page and slot and open the relation.
+   */
+  void open(const std::string &name);
+
+  /**
+   * File of the relation.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Record ids to fetch, sorted by page number, then slot number.
+   */
+  std::vector<RecordId> rids;
+
+  /**
+   * Position in rids of the next record to return.
+   */
+  size_t        nextRid;
+
+  /**
+   * Page of the current record, pinned. NULL before the first record and after the last.
+   */
+  Page*         curPage;
+
+  /**
+   * Page number of curPage.
+   */
+  PageId        curPageNum;
+
+  /**
+   * Number of pages pinned so far.
+   */
+  size_t        numPagesRead;
+};
+
+}
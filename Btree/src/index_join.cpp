@@ -0,0 +1,191 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "index_join.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+namespace badgerdb {
+
+///bytes of the join attribute in a record, for a key of the given type
+static size_t joinKeySize(Datatype type)
+{
+  switch(type){
+  case INTEGER: return sizeof(int);
+  case DOUBLE: return sizeof(double);
+  case STRING: return STRINGSIZE;
+  }
+  return 0;
+}
+
+template <class T>
+static T joinKey(const std::string& bytes)
+{
+  T key;
+  memcpy(&key, bytes.data(), sizeof(T));
+  return key;
+}
+
+template <>
+StringKey joinKey<StringKey>(const std::string& bytes)
+{
+  StringKey key;
+  key.set(bytes.data(), bytes.size());
+  return key;
+}
+
+///a key and the position of its tuple in the batch, in key order and then in the order read
+template <class T>
+static bool keyPosLess(const std::pair<T, size_t>& a, const std::pair<T, size_t>& b)
+{
+  if(a.first != b.first) return a.first < b.first;
+  return a.second < b.second;
+}
+
+IndexJoin::IndexJoin(const std::string &outerName, BufMgr *bufferMgr, const int attrOffset, BTreeIndex* inner, const size_t outerBatch)
+{
+  outerScan = new FileScan(outerName, bufferMgr);
+  innerIndex = inner;
+  attrByteOffset = attrOffset;
+  batchSize = std::max<size_t>(outerBatch, 1);
+  nextPair = 0;
+}
+
+IndexJoin::~IndexJoin()
+{
+  delete outerScan;
+}
+
+void IndexJoin::joinNext(RecordId& outerRid, RecordId& innerRid)
+{
+  // a batch may join nothing, so keep reading until one does or the outer relation runs out
+  while(nextPair == pairs.size())
+  {
+    if(!nextBatch()) throw EndOfFileException();
+  }
+  outerRid = pairs[nextPair].first;
+  innerRid = pairs[nextPair].second;
+  nextPair++;
+}
+
+const std::vector<JoinBatchStats>& IndexJoin::batchStats() const
+{
+  return stats;
+}
+
+bool IndexJoin::nextBatch()
+{
+  pairs.clear();
+  nextPair = 0;
+  if(outerScan == NULL) return false;
+
+  outerRids.clear();
+  outerKeys.clear();
+  const size_t keySize = joinKeySize(innerIndex->keyType());
+  try
+  {
+    while(outerRids.size() < batchSize)
+    {
+      RecordId rid;
+      outerScan->scanNext(rid);
+      std::string record = outerScan->getRecord();
+      outerRids.push_back(rid);
+      outerKeys.push_back(record.substr(attrByteOffset, keySize));
+    }
+  }
+  catch(EndOfFileException e)
+  {
+    // the scan unpins its last page once it runs out
+    delete outerScan;
+    outerScan = NULL;
+  }
+  if(outerRids.empty()) return false;
+
+  JoinBatchStats batch = JoinBatchStats();
+  batch.outerTuples = outerRids.size();
+  switch(innerIndex->keyType()){
+  case INTEGER: joinBatch<int>(batch); break;
+  case DOUBLE: joinBatch<double>(batch); break;
+  case STRING: joinBatch<StringKey>(batch); break;
+  }
+  stats.push_back(batch);
+  return true;
+}
+
+template <class T>
+void IndexJoin::joinBatch(JoinBatchStats& batch)
+{
+  std::vector<std::pair<T, size_t> > sorted;
+  sorted.reserve(outerKeys.size());
+  for(size_t i = 0; i < outerKeys.size(); i++)
+  {
+    sorted.push_back(std::make_pair(joinKey<T>(outerKeys[i]), i));
+  }
+  std::sort(sorted.begin(), sorted.end(), keyPosLess<T>);
+
+  // one probe per distinct key. groupStart[g] is where the tuples of the g-th key start in sorted
+  std::vector<T> keys;
+  std::vector<size_t> groupStart;
+  for(size_t i = 0; i < sorted.size(); i++)
+  {
+    if(keys.empty() || keys.back() != sorted[i].first)
+    {
+      keys.push_back(sorted[i].first);
+      groupStart.push_back(i);
+    }
+  }
+  groupStart.push_back(sorted.size());
+  batch.probes = keys.size();
+
+  std::vector<ScanRange> ranges(keys.size());
+  for(size_t g = 0; g < keys.size(); g++)
+  {
+    ranges[g].setPoint(&keys[g]);
+  }
+
+  BTreeScanCursor cursor;
+  try
+  {
+    cursor = innerIndex->openScan(&ranges[0], ranges.size());
+  }
+  catch(NoSuchKeyFoundException e)
+  {
+    // none of the keys is in the index, the scan ended without leaving its counts
+    return;
+  }
+
+  // a point range holds only its key, so the range of an entry is the group it joins
+  try
+  {
+    while(true)
+    {
+      RecordId innerRid;
+      cursor.scanNext(innerRid);
+      const size_t g = cursor.rangeIndex();
+      for(size_t i = groupStart[g]; i < groupStart[g + 1]; i++)
+      {
+        pairs.push_back(std::make_pair(outerRids[sorted[i].second], innerRid));
+      }
+    }
+  }
+  catch(IndexScanCompletedException e)
+  {
+  }
+
+  const RangeScanStats& scanStats = cursor.rangeScanStats();
+  batch.matches = pairs.size();
+  batch.leafHits = scanStats.leafHits;
+  batch.descents = scanStats.descents;
+  batch.nodeReads = scanStats.nodeReads;
+  batch.leafReads = scanStats.leafReads;
+  if(cursor.isOpen()) cursor.endScan();
+}
+
+}
@@ -0,0 +1,157 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Number of outer tuples an IndexJoin probes the inner index for at a time.
+ */
+const size_t JOIN_BATCH_SIZE = 1024;
+
+/**
+ * @brief What one batch of an IndexJoin read and did.
+ */
+struct JoinBatchStats{
+  /**
+   * Outer tuples in the batch.
+   */
+	size_t outerTuples;
+
+  /**
+   * Probes of the inner index, one per distinct join key of the batch.
+   */
+	size_t probes;
+
+  /**
+   * Pairs of outer and inner tuples the batch joined.
+   */
+	size_t matches;
+
+  /**
+   * Probes that started on the leaf the probe before ended on, with no descent.
+   */
+	size_t leafHits;
+
+  /**
+   * Probes that descended, from the lowest node covering the key or from the root.
+   */
+	size_t descents;
+
+  /**
+   * Non-leaf nodes of the inner index read by the descents.
+   */
+	size_t nodeReads;
+
+  /**
+   * Leaves of the inner index read.
+   */
+	size_t leafReads;
+};
+
+/**
+ * @brief Index nested-loop join of a relation with the relation of a BTreeIndex, on equal keys.
+ *
+ * The outer relation is read with a FileScan, batchSize tuples at a time. The join keys of a batch
+ * are sorted and deduplicated, and the inner index is probed for all of them with one multi-range
+ * scan in key order. Probes whose key is on the leaf the previous probe ended on reuse that pinned
+ * leaf, and the others re-descend only from the lowest node covering both keys, instead of from
+ * the root for every outer tuple. Within a batch, pairs come back in join key order.
+ */
+class IndexJoin
+{
+ public:
+
+  /**
+   * @param outerName			Outer relation
+   * @param bufMgr				Buffer Manager instance
+   * @param attrByteOffset	Byte offset of the join attribute in the outer records. It must have
+   *                      the key type of the inner index
+   * @param inner					Index of the inner relation on its join attribute
+   * @param batchSize			Outer tuples probed for at a time
+   */
+  IndexJoin(const std::string &outerName, BufMgr *bufMgr, const int attrByteOffset, BTreeIndex* inner, const size_t batchSize = JOIN_BATCH_SIZE);
+
+  ~IndexJoin();
+
+  /**
+   * Move to the next pair of an outer and an inner tuple with equal keys.
+   *
+   * @param outerRid		Record id of the outer tuple
+   * @param innerRid		Record id of the inner tuple
+   * @throws EndOfFileException	If every pair has been returned
+   */
+  void joinNext(RecordId& outerRid, RecordId& innerRid);
+
+  /**
+   * Statistics of every batch read so far, in order.
+   */
+  const std::vector<JoinBatchStats>& batchStats() const;
+
+ private:
+  /**
+   * Read the next batch of outer tuples and join it. The batch may have no pairs.
+   *
+   * @return False if the outer relation has no tuples left
+   */
+  bool nextBatch();
+
+  /**
+   * Join a batch whose keys are of type T.
+   */
+  template <class T>
+  void joinBatch(JoinBatchStats& stats);
+
+  /**
+   * Scan of the outer relation. NULL once it is exhausted.
+   */
+  FileScan      *outerScan;
+
+  /**
+   * Index of the inner relation.
+   */
+  BTreeIndex    *innerIndex;
+
+  /**
+   * Byte offset of the join attribute in the outer records.
+   */
+  int           attrByteOffset;
+
+  /**
+   * Outer tuples read at a time.
+   */
+  size_t        batchSize;
+
+  /**
+   * Record ids and join attributes of the outer tuples of the current batch, as read.
+   */
+  std::vector<RecordId> outerRids;
+  std::vector<std::string> outerKeys;
+
+  /**
+   * Pairs of the current batch, and the position of the next one to return.
+   */
+  std::vector<std::pair<RecordId, RecordId> > pairs;
+  size_t        nextPair;
+
+  /**
+   * One entry per batch read.
+   */
+  std::vector<JoinBatchStats> stats;
+};
+
+}
@@ -5,10 +5,14 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cmath>
+#include <thread>
 #include <vector>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "heap_fetch.h"
+#include "index_join.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -17,6 +21,7 @@
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
 
@@ -42,8 +47,8 @@ using namespace badgerdb;
 int testNum = 1;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
-const int	relationSize = 5000;
-std::string intIndexName, doubleIndexName, stringIndexName;
+int	relationSize = 5000;
+std::string intIndexName, doubleIndexName, stringIndexName, compositeIndexName;
 
 // This is the structure for tuples in the base relation
 
@@ -69,6 +74,30 @@ void createRelationBackward();
 void createRelationRandom();
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int heapScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int selfJoin(BTreeIndex *index, size_t batchSize);
+int cursorScan(BTreeIndex *index, int lowVal1, int highVal1, int lowVal2, int highVal2);
+int readAheadLeaves(BTreeIndex *index, int lowVal, int highVal, int& leafReads);
+int lookupPins(BTreeIndex *index, int key);
+int maxKeyPins(BTreeIndex *index, int& key);
+int batchScan(BTreeIndex *index, const void* lowVal, Operator lowOp, const void* highVal, Operator highOp);
+int descendingScan(BTreeIndex *index, const void* lowVal, Operator lowOp, const void* highVal, Operator highOp);
+int multiScan(BTreeIndex *index, const ScanRange* ranges, size_t numRanges);
+int concurrentInserts(BTreeIndex *index, int numThreads, int lowVal, int highVal);
+int duplicateLookup(BTreeIndex *index, int key, int numCopies);
+int duplicateDelete(BTreeIndex *index, int key, int numCopies);
+int postingChain(BTreeIndex *index, int key, int numIds);
+int appendKeys(BTreeIndex *index, int lowVal, int highVal);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests();
+void deleteTests();
+void packedTests();
+void compositeTests();
+void blockedTests();
+int prefixScan(BTreeIndex *index, const void* const* values, int numValues);
+int deleteRange(BTreeIndex *index, int lowVal, int highVal);
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void indexTests();
 void test1();
 void test2();
@@ -369,6 +398,61 @@ void indexTests()
   	catch(FileNotFoundException e)
   	{
   	}
+
+    doubleTests();
+		try
+		{
+			File::remove(doubleIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    stringTests();
+		try
+		{
+			File::remove(stringIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    deleteTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    packedTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    compositeTests();
+		try
+		{
+			File::remove(compositeIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    blockedTests();
+		try
+		{
+			File::remove(intIndexName);
+			File::remove(doubleIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
   }
 }
 
@@ -389,6 +473,565 @@ void intTests()
 	checkPassFail(intScan(&index,0,GT,1,LT), 0)
 	checkPassFail(intScan(&index,300,GT,400,LT), 99)
 	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+	// the records of a scan fetched page by page
+	checkPassFail(heapScan(&index,25,GT,40,LT), 14)
+	checkPassFail(heapScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(heapScan(&index,0,GT,1,LT), 0)
+
+	// the relation joined with itself on the integer field through the index
+	checkPassFail(selfJoin(&index,JOIN_BATCH_SIZE), relationSize)
+	checkPassFail(selfJoin(&index,1), relationSize)
+
+	// two cursors over one index, advanced in turns
+	checkPassFail(cursorScan(&index,20,35,3000,4000), 1015)
+	checkPassFail(cursorScan(&index,100,200,150,250), 200)
+
+	// the same ranges a batch at a time
+	int lowVal = 25, highVal = 40;
+	checkPassFail(batchScan(&index,&lowVal,GT,&highVal,LT), 14)
+	lowVal = 300; highVal = 400;
+	checkPassFail(batchScan(&index,&lowVal,GT,&highVal,LT), 99)
+	lowVal = 3000; highVal = 4000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+
+	// the same ranges from the high bound down
+	lowVal = 25; highVal = 40;
+	checkPassFail(descendingScan(&index,&lowVal,GT,&highVal,LT), 14)
+	lowVal = 20; highVal = 35;
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LTE), 16)
+	lowVal = 0; highVal = 1;
+	checkPassFail(descendingScan(&index,&lowVal,GT,&highVal,LT), 0)
+	lowVal = 3000; highVal = 4000;
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+
+	// several ranges and an IN list in one pass over the leaves
+	int bounds[] = {25, 40, 300, 400, 401, 410, 3000, 4000};
+	ScanRange ranges[4];
+	ranges[0].set(&bounds[0], GT, &bounds[1], LT);
+	ranges[1].set(&bounds[2], GTE, &bounds[3], LTE);
+	ranges[2].set(&bounds[4], GT, &bounds[5], LT);
+	ranges[3].set(&bounds[6], GTE, &bounds[7], LT);
+	checkPassFail(multiScan(&index,ranges,4), 1123)
+	int inKeys[] = {-7, 5, 17, 300, 301, 2999, 3000, 9000000};
+	ScanRange points[8];
+	for(int i = 0; i < 8; i++) points[i].setPoint(&inKeys[i]);
+	checkPassFail(multiScan(&index,points,8), 6)
+	checkPassFail(multiScan(&index,points,1), 0)
+
+	// counts and extremes from the index alone
+	lowVal = 25; highVal = 40;
+	checkPassFail(index.countRange(&lowVal,GT,&highVal,LT), 14)
+	lowVal = 3000; highVal = 4000;
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LT), 1000)
+	lowVal = 0; highVal = relationSize;
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LTE), relationSize)
+
+	// estimates from the subtree counts of the non-leaf nodes, off by at most two leaves
+	checkPassFail((std::fabs(index.estimateRange(&lowVal,GTE,&highVal,LTE) - relationSize) <= 2 * INTARRAYLEAFSIZE), true)
+	lowVal = 3000; highVal = 4000;
+	checkPassFail((std::fabs(index.estimateRange(&lowVal,GTE,&highVal,LT) - 1000) <= 2 * INTARRAYLEAFSIZE), true)
+	int key = -1;
+	checkPassFail(index.minKey(&key), true)
+	checkPassFail(key, 0)
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, relationSize - 1)
+
+	// point lookups, including a key with entries on both sides of a leaf boundary
+	RecordId rids[8];
+	key = 3000;
+	checkPassFail(index.lookup(&key,rids,8), 1)
+	key = -5;
+	checkPassFail(index.lookup(&key,rids,8), 0)
+	checkPassFail(duplicateLookup(&index,42,INTARRAYLEAFSIZE), INTARRAYLEAFSIZE + 1)
+
+	// the same with the entries of the key moved to a posting list once it has 8 of them
+	index.setPostingLists(8);
+	checkPassFail(duplicateLookup(&index,77,INTARRAYLEAFSIZE), INTARRAYLEAFSIZE + 1)
+	lowVal = 77; highVal = 77;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LTE), INTARRAYLEAFSIZE + 1)
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LTE), INTARRAYLEAFSIZE + 1)
+	lowVal = 70; highVal = 80;
+	checkPassFail(batchScan(&index,&lowVal,GT,&highVal,LT), INTARRAYLEAFSIZE + 9)
+	checkPassFail(duplicateDelete(&index,77,INTARRAYLEAFSIZE), 1)
+	// a list of several pages, split as it grows and freed a page at a time as it shrinks
+	checkPassFail(postingChain(&index,88,10000), 1)
+	index.setPostingLists(0);
+
+	// without read-ahead every leaf is read by the scan itself
+	int leafReads = 0, leafReadsAhead = 0;
+	index.setReadAhead(0);
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(readAheadLeaves(&index,0,relationSize,leafReads), 0)
+	checkPassFail((leafReads >= relationSize / INTARRAYLEAFSIZE), true)
+	index.setReadAhead(READ_AHEAD_MAX_PAGES);
+	// with it, the worker is asked for every leaf the scan moves on to, and for at most a window more
+	leafReadsAhead = readAheadLeaves(&index,0,relationSize,leafReads);
+	std::cout << "leaves read ahead:" << leafReadsAhead << " moved to by the scan:" << leafReads << std::endl;
+	checkPassFail((leafReadsAhead >= leafReads && leafReadsAhead <= leafReads + READ_AHEAD_MAX_PAGES), true)
+
+	// descents through the buffer pool only, and through a cache with room for just the root. A lookup
+	// pins the nodes on its path that are not cached, read-ahead would pin leaves of its own
+	index.setReadAhead(0);
+	index.setUpperCache(0);
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	int uncachedPins = lookupPins(&index,350);
+	index.setUpperCache(1);
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	checkPassFail(lookupPins(&index,350), uncachedPins - 1)
+	index.setUpperCache(UPPER_CACHE_MAX_PAGES);
+	checkPassFail(lookupPins(&index,350), 1)
+	index.setReadAhead(READ_AHEAD_MAX_PAGES);
+
+	// keys above every key in the index go straight into the rightmost leaf until it is full
+	checkPassFail(appendKeys(&index,relationSize,relationSize + 2000), 2000)
+	lowVal = relationSize; highVal = relationSize + 2000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 2000)
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LT), 2000)
+	checkPassFail((std::fabs(index.estimateRange(&lowVal,GTE,&highVal,LT) - 2000) <= 2 * INTARRAYLEAFSIZE), true)
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, relationSize + 1999)
+	lowVal = 100; highVal = relationSize;
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LT), relationSize - 100)
+
+	// inserts and deletes held back in a write buffer, applied a child of the root at a time
+	index.setWriteBuffer(100);
+	checkPassFail(appendKeys(&index,-5000,-4000), 1000)
+	lowVal = -5000; highVal = -4000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LT), 1000)
+	checkPassFail(index.minKey(&key), true)
+	checkPassFail(key, -5000)
+	key = 3000;
+	checkPassFail(index.lookup(&key,rids,8), 1)
+	RecordId deleted = rids[0];
+	index.deleteEntry(&key, deleted);
+	checkPassFail(index.lookup(&key,rids,8), 0)
+	lowVal = 3000; highVal = 4000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 999)
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LT), 999)
+	checkPassFail(multiScan(&index,points,8), 5)
+	index.insertEntry(&key, deleted);
+
+	// a buffered delete of the largest entry is looked past from the rightmost leaf, not the leftmost
+	key = relationSize + 1999;
+	checkPassFail(index.lookup(&key,rids,8), 1)
+	deleted = rids[0];
+	index.deleteEntry(&key, deleted);
+	int edgePins = maxKeyPins(&index,key);
+	std::cout << "pages pinned by maxKey past a buffered delete:" << edgePins << std::endl;
+	checkPassFail(key, relationSize + 1998)
+	checkPassFail((edgePins <= 8), true)
+	key = relationSize + 1999;
+	index.insertEntry(&key, deleted);
+	index.setWriteBuffer(0);
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+	// threads inserting keys below the relation while another thread scans. Every insert reaches the
+	// subtree counts above the leaves, so the estimate of the whole index grows by exactly their number
+	lowVal = -1000000; highVal = 1000000;
+	double wholeIndex = index.estimateRange(&lowVal,GTE,&highVal,LT);
+	index.setThreadSafe(true);
+	checkPassFail(concurrentInserts(&index,4,-2000,-1000), 1000)
+	checkPassFail(index.estimateRange(&lowVal,GTE,&highVal,LT) - wholeIndex, 1000)
+	lowVal = -2000; highVal = -1000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+	index.setThreadSafe(false);
+}
+
+int duplicateLookup(BTreeIndex * index, int key, int numCopies)
+{
+	// adds numCopies more entries of key, more than fit in one leaf, and looks all of them up.
+	// Returns -1 if a lookup with a smaller limit does not stop at the limit
+	RecordId rid;
+	rid.page_number = 1;
+	for(int i = 0; i < numCopies; i++)
+	{
+		rid.slot_number = (SlotId)(i + 1);
+		index->insertEntry(&key, rid);
+	}
+
+	std::vector<RecordId> rids(numCopies + 10);
+	if(index->lookup(&key, &rids[0], 3) != 3) return -1;
+	return index->lookup(&key, &rids[0], rids.size());
+}
+
+int duplicateDelete(BTreeIndex * index, int key, int numCopies)
+{
+	// deletes the entries added by duplicateLookup and returns how many entries of key are left
+	RecordId rid;
+	rid.page_number = 1;
+	for(int i = 0; i < numCopies; i++)
+	{
+		rid.slot_number = (SlotId)(i + 1);
+		index->deleteEntry(&key, rid);
+	}
+
+	RecordId rids[8];
+	return index->lookup(&key, rids, 8);
+}
+
+int postingChain(BTreeIndex * index, int key, int numIds)
+{
+	// adds numIds entries of key, each on its own heap page past those of the relation so the posting
+	// list takes several pages, then deletes them, the first half from the front and the rest from the
+	// back. Returns how many entries of key are left, -1 if a lookup, count or estimate on the way is wrong
+	const PageId firstPage = 1000000;
+	RecordId rid;
+	rid.slot_number = 1;
+	for(int i = 0; i < numIds; i++)
+	{
+		rid.page_number = firstPage + i;
+		index->insertEntry(&key, rid);
+	}
+
+	// the entry of the relation comes first, its page is below firstPage
+	std::vector<RecordId> rids(numIds + 10);
+	int lowVal = key, highVal = key;
+	if(index->lookup(&key, &rids[0], rids.size()) != (size_t)numIds + 1) return -1;
+	if(index->countRange(&lowVal, GTE, &highVal, LTE) != numIds + 1) return -1;
+	for(int i = 0; i < numIds; i++)
+	{
+		if(rids[i + 1].page_number != firstPage + i) return -1;
+	}
+
+	// estimates with a bound next to the list stay within two leaves, its entries all count at key
+	int zero = 0;
+	for(highVal = std::max(key - 100, 0); highVal <= key + 100; highVal++)
+	{
+		double estimate = index->estimateRange(&zero, GTE, &highVal, LTE);
+		if(std::fabs(estimate - index->countRange(&zero, GTE, &highVal, LTE)) > 2 * INTARRAYLEAFSIZE) return -1;
+	}
+	highVal = key;
+
+	for(int i = 0; i < numIds / 2; i++)
+	{
+		rid.page_number = firstPage + i;
+		index->deleteEntry(&key, rid);
+	}
+	if(index->lookup(&key, &rids[0], rids.size()) != (size_t)(numIds - numIds / 2) + 1) return -1;
+	if(rids[1].page_number != firstPage + numIds / 2) return -1;
+	for(int i = numIds - 1; i >= numIds / 2; i--)
+	{
+		rid.page_number = firstPage + i;
+		index->deleteEntry(&key, rid);
+	}
+	if(index->countRange(&lowVal, GTE, &highVal, LTE) != 1) return -1;
+
+	return (int)index->lookup(&key, &rids[0], rids.size());
+}
+
+int appendKeys(BTreeIndex * index, int lowVal, int highVal)
+{
+	// inserts every key of [lowVal, highVal) in ascending order and returns how many were inserted
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	for(int key = lowVal; key < highVal; key++)
+	{
+		index->insertEntry(&key, rid);
+	}
+	return highVal - lowVal;
+}
+
+int concurrentInserts(BTreeIndex * index, int numThreads, int lowVal, int highVal)
+{
+	// inserts every key of [lowVal, highVal) spread over numThreads threads while one more thread keeps
+	// scanning [3000, 4000). Returns -1 if a scan does not see exactly those 1000 entries
+	bool done = false;
+	int scanErrors = 0;
+	std::thread scanner([&]() {
+		int low = 3000, high = 4000;
+		RecordId rids[64];
+		while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE))
+		{
+			BTreeScanCursor cursor = index->openScan(&low, GTE, &high, LT);
+			int found = 0;
+			while(size_t n = cursor.scanNextBatch(rids, 64)) found += n;
+			if(found != 1000) scanErrors++;
+		}
+	});
+
+	std::vector<std::thread> inserters;
+	for(int t = 0; t < numThreads; t++)
+	{
+		inserters.push_back(std::thread([=]() {
+			for(int key = lowVal + t; key < highVal; key += numThreads)
+			{
+				RecordId rid;
+				rid.page_number = 1;
+				rid.slot_number = (SlotId)(t + 1);
+				index->insertEntry(&key, rid);
+			}
+		}));
+	}
+	for(size_t t = 0; t < inserters.size(); t++) inserters[t].join();
+	__atomic_store_n(&done, true, __ATOMIC_RELEASE);
+	scanner.join();
+
+	if(scanErrors != 0) return -1;
+	return highVal - lowVal;
+}
+
+int batchScan(BTreeIndex * index, const void* lowVal, Operator lowOp, const void* highVal, Operator highOp)
+{
+	// a batch size that does not divide the leaves, so batches end both mid-leaf and on leaf boundaries
+	RecordId rids[37];
+	int numResults = 0;
+
+	try
+	{
+		index->startScan(lowVal, lowOp, highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	while(size_t n = index->scanNextBatch(rids, 37))
+	{
+		numResults += n;
+	}
+
+	// the end of a batch scan is sticky
+	if(index->scanNextBatch(rids, 37) != 0) numResults = -1;
+	index->endScan();
+
+	return numResults;
+}
+
+int descendingScan(BTreeIndex * index, const void* lowVal, Operator lowOp, const void* highVal, Operator highOp)
+{
+	// returns -1 if the records do not come in descending order. The records of every index of the
+	// relation hold the same number in i, d and s, so their order is checked on i
+	BTreeScanCursor cursor;
+	try
+	{
+		cursor = index->openScan(lowVal, lowOp, highVal, highOp, true);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	RecordId scanRid;
+	Page *curPage;
+	int numResults = 0;
+	int lastKey = 0;
+	try
+	{
+		while(1)
+		{
+			cursor.scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			if(numResults > 0 && myRec.i > lastKey) return -1;
+			lastKey = myRec.i;
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+
+	return numResults;
+}
+
+int multiScan(BTreeIndex * index, const ScanRange* ranges, size_t numRanges)
+{
+	// returns -1 if the records do not come in ascending order across the ranges
+	BTreeScanCursor cursor;
+	try
+	{
+		cursor = index->openScan(ranges, numRanges);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	RecordId scanRid;
+	Page *curPage;
+	int numResults = 0;
+	int lastKey = 0;
+	try
+	{
+		while(1)
+		{
+			cursor.scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			if(numResults > 0 && myRec.i < lastKey) return -1;
+			lastKey = myRec.i;
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+
+	return numResults;
+}
+
+int cursorScan(BTreeIndex * index, int lowVal1, int highVal1, int lowVal2, int highVal2)
+{
+	// both ranges are [low, high). Returns -1 if a cursor returns a record outside its range
+	BTreeScanCursor cursor1 = index->openScan(&lowVal1, GTE, &highVal1, LT);
+	BTreeScanCursor cursor2 = index->openScan(&lowVal2, GTE, &highVal2, LT);
+	BTreeScanCursor* cursors[2] = {&cursor1, &cursor2};
+	int lowVals[2] = {lowVal1, lowVal2};
+	int highVals[2] = {highVal1, highVal2};
+	bool done[2] = {false, false};
+	RecordId scanRid;
+	Page *curPage;
+	int numResults = 0;
+
+	while(!done[0] || !done[1])
+	{
+		for(int c = 0; c < 2; c++)
+		{
+			if(done[c]) continue;
+			try
+			{
+				cursors[c]->scanNext(scanRid);
+			}
+			catch(IndexScanCompletedException e)
+			{
+				cursors[c]->endScan();
+				done[c] = true;
+				continue;
+			}
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			if(myRec.i < lowVals[c] || myRec.i >= highVals[c]) return -1;
+			numResults++;
+		}
+	}
+
+	return numResults;
+}
+
+int lookupPins(BTreeIndex * index, int key)
+{
+	// looks up key and returns how many pages the lookup pinned
+	RecordId rids[8];
+	int pins = bufMgr->getBufStats().pins;
+	index->lookup(&key, rids, 8);
+	return bufMgr->getBufStats().pins - pins;
+}
+
+int maxKeyPins(BTreeIndex * index, int& key)
+{
+	// finds the largest key and returns how many pages that pinned
+	int pins = bufMgr->getBufStats().pins;
+	index->maxKey(&key);
+	return bufMgr->getBufStats().pins - pins;
+}
+
+int readAheadLeaves(BTreeIndex * index, int lowVal, int highVal, int& leafReads)
+{
+	// scans [low, high). Returns the leaves asked of the read-ahead worker, leafReads the leaves moved to
+	BTreeScanCursor cursor = index->openScan(&lowVal, GTE, &highVal, LT);
+	RecordId scanRid;
+	try
+	{
+		while(1) cursor.scanNext(scanRid);
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	leafReads = (int)cursor.rangeScanStats().leafReads;
+	int leaves = (int)cursor.rangeScanStats().readAheadLeaves;
+	if(cursor.isOpen()) cursor.endScan();
+	return leaves;
+}
+
+int heapScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// returns -1 if a record is out of range, or if the records are not in page order
+	BTreeScanCursor cursor;
+	try
+	{
+		cursor = index->openScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	HeapFetch fetch(relationName, bufMgr, cursor);
+	RecordId scanRid, lastRid;
+	int numResults = 0;
+	while(1)
+	{
+		try
+		{
+			fetch.scanNext(scanRid);
+		}
+		catch(EndOfFileException e)
+		{
+			break;
+		}
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(fetch.getRecord().data()));
+		if((lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal) || (highOp == LT ? myRec.i >= highVal : myRec.i > highVal)) return -1;
+		if(numResults > 0 && (scanRid.page_number < lastRid.page_number
+				|| (scanRid.page_number == lastRid.page_number && scanRid.slot_number < lastRid.slot_number))) return -1;
+		lastRid = scanRid;
+		numResults++;
+	}
+
+	std::cout << "Heap fetch of " << numResults << " records read " << fetch.pagesRead() << " pages" << std::endl;
+	return numResults;
+}
+
+int selfJoin(BTreeIndex * index, size_t batchSize)
+{
+	// returns -1 if a pair has different keys, or if a batch did not probe once per key
+	IndexJoin join(relationName, bufMgr, offsetof(tuple,i), index, batchSize);
+	RecordId outerRid, innerRid;
+	Page *curPage;
+	int numResults = 0;
+	while(1)
+	{
+		try
+		{
+			join.joinNext(outerRid, innerRid);
+		}
+		catch(EndOfFileException e)
+		{
+			break;
+		}
+		bufMgr->readPage(file1, outerRid.page_number, curPage);
+		RECORD outerRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outerRid).data()));
+		bufMgr->unPinPage(file1, outerRid.page_number, false);
+		bufMgr->readPage(file1, innerRid.page_number, curPage);
+		RECORD innerRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(innerRid).data()));
+		bufMgr->unPinPage(file1, innerRid.page_number, false);
+		if(outerRec.i != innerRec.i) return -1;
+		numResults++;
+	}
+
+	size_t probes = 0, leafHits = 0, descents = 0;
+	const std::vector<JoinBatchStats>& stats = join.batchStats();
+	for(size_t b = 0; b < stats.size(); b++)
+	{
+		if(stats[b].probes != stats[b].outerTuples || stats[b].leafHits + stats[b].descents != stats[b].probes) return -1;
+		if(b < 3)
+		{
+			std::cout << "Join batch " << b << ": " << stats[b].outerTuples << " tuples, " << stats[b].probes << " probes, "
+				<< stats[b].leafHits << " leaf hits, " << stats[b].descents << " descents, " << stats[b].nodeReads
+				<< " node reads, " << stats[b].leafReads << " leaf reads" << std::endl;
+		}
+		probes += stats[b].probes;
+		leafHits += stats[b].leafHits;
+		descents += stats[b].descents;
+	}
+	std::cout << "Join of " << numResults << " pairs in " << stats.size() << " batches: " << probes << " probes, "
+		<< leafHits << " leaf hits, " << descents << " descents" << std::endl;
+	return numResults;
 }
 
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
@@ -452,6 +1095,390 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 }
 
 
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests()
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,40.5,LT), 16)
+
+	double key = 3000;
+	RecordId rids[8];
+	checkPassFail(index.lookup(&key,rids,8), 1)
+	key = 2999.5;
+	checkPassFail(index.lookup(&key,rids,8), 0)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests()
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+
+	char lowValStr[100], highValStr[100];
+	sprintf(lowValStr,"%05d string record",300);
+	sprintf(highValStr,"%05d string record",3300);
+	checkPassFail(batchScan(&index,lowValStr,GT,highValStr,LTE), 3000)
+
+	checkPassFail(index.countRange(lowValStr,GT,highValStr,LTE), 3000)
+	checkPassFail((std::fabs(index.estimateRange(lowValStr,GT,highValStr,LTE) - 3000) <= 2 * STRINGNODEDATASIZE / sizeof(RecordId)), true)
+	char keyStr[STRINGSIZE + 1];
+	checkPassFail(index.minKey(keyStr), true)
+	checkPassFail(std::string(keyStr), "00000 string record")
+
+	RecordId rids[8];
+	checkPassFail(index.lookup(highValStr,rids,8), 1)
+	checkPassFail(index.lookup("03300 string recor",rids,8), 0)
+
+	// a buffered delete hides its entry until it is applied, inserting the entry again cancels it
+	index.setWriteBuffer(64);
+	checkPassFail(index.lookup(highValStr,rids,8), 1)
+	RecordId deleted = rids[0];
+	index.deleteEntry(highValStr, deleted);
+	checkPassFail(index.lookup(highValStr,rids,8), 0)
+	checkPassFail(batchScan(&index,lowValStr,GT,highValStr,LTE), 2999)
+	checkPassFail(index.countRange(lowValStr,GT,highValStr,LTE), 2999)
+	index.insertEntry(highValStr, deleted);
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	index.setWriteBuffer(0);
+
+	checkPassFail(descendingScan(&index,lowValStr,GT,highValStr,LTE), 3000)
+
+	char inStr[3][100];
+	ScanRange points[3];
+	sprintf(inStr[0],"%05d string record",250);
+	sprintf(inStr[1],"%05d string recor",251);
+	sprintf(inStr[2],"%05d string record",4000);
+	for(int i = 0; i < 3; i++) points[i].setPoint(inStr[i]);
+	checkPassFail(multiScan(&index,points,3), 2)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	
+	try
+	{
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+
+// -----------------------------------------------------------------------------
+// deleteTests
+// -----------------------------------------------------------------------------
+
+void deleteTests()
+{
+  std::cout << "Delete entries from a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	checkPassFail(deleteRange(&index,26,39), 14)
+	checkPassFail(intScan(&index,25,GT,40,LT), 0)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 6)
+
+	// empty most of the leaves so that they merge
+	checkPassFail(deleteRange(&index,0,2999), 2986)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 0)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	int lowVal = 0, highVal = 4000;
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+
+	// entries that are gone cannot be deleted again
+	int key = 30;
+	RecordId missing;
+	missing.page_number = 1;
+	missing.slot_number = 1;
+	try
+	{
+		index.deleteEntry(&key, missing);
+		std::cout << "Deleting a missing entry should throw NoSuchKeyFoundException" << std::endl;
+		exit(1);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+	}
+
+	// shrink the tree to a root leaf, then split it again. The new root is cached as it is made, so a
+	// lookup pins only its leaf
+	checkPassFail(deleteRange(&index,3000,relationSize - 11), relationSize - 3010)
+	index.setUpperCache(0);
+	checkPassFail(lookupPins(&index,relationSize - 1), 1)
+	index.setUpperCache(UPPER_CACHE_MAX_PAGES);
+	checkPassFail(appendKeys(&index,relationSize,relationSize + INTARRAYLEAFSIZE), INTARRAYLEAFSIZE)
+	checkPassFail(lookupPins(&index,relationSize - 1), 1)
+	checkPassFail(lookupPins(&index,relationSize + INTARRAYLEAFSIZE - 1), 1)
+	index.setUpperCache(0);
+	checkPassFail(lookupPins(&index,relationSize - 1), 2)
+}
+
+// -----------------------------------------------------------------------------
+// packedTests
+// -----------------------------------------------------------------------------
+
+void packedTests()
+{
+  std::cout << "Create a B+ Tree index with packed leaves on the integer field" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULKLOAD_FILL_FACTOR, 0, true);
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	int lowVal = 300, highVal = 400;
+	checkPassFail(batchScan(&index,&lowVal,GT,&highVal,LT), 99)
+	lowVal = 0; highVal = relationSize;
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LTE), relationSize)
+	int key = -1;
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, relationSize - 1)
+
+	// every insert and delete encodes its leaf again
+	checkPassFail(duplicateLookup(&index,42,INTARRAYLEAFSIZE), INTARRAYLEAFSIZE + 1)
+	checkPassFail(duplicateDelete(&index,42,INTARRAYLEAFSIZE), 1)
+	checkPassFail(deleteRange(&index,0,2999), 3000)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	lowVal = 0; highVal = 4000;
+	checkPassFail(descendingScan(&index,&lowVal,GTE,&highVal,LT), 1000)
+	int bounds[] = {0, 100, 2990, 3010, 3500, 3600};
+	ScanRange ranges[3];
+	ranges[0].set(&bounds[0], GTE, &bounds[1], LT);
+	ranges[1].set(&bounds[2], GT, &bounds[3], LTE);
+	ranges[2].set(&bounds[4], GT, &bounds[5], LT);
+	checkPassFail(multiScan(&index,ranges,3), 110)
+  }
+
+  // an existing index keeps the leaf layout it was built with
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 0)
+}
+
+// -----------------------------------------------------------------------------
+// blockedTests
+// -----------------------------------------------------------------------------
+
+void blockedTests()
+{
+  std::cout << "Create B+ Tree indexes with blocked non-leaf nodes" << std::endl;
+  {
+    // a low fill factor gives the tree several levels of non-leaf nodes
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.1, 0, false, true);
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	int lowVal = 0, highVal = relationSize;
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LTE), relationSize)
+
+	// splits of full non-leaf nodes and merges of emptied ones rewrite their block directories
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	for(int key = relationSize; key < relationSize + 20000; key++)
+	{
+		index.insertEntry(&key, rid);
+	}
+	lowVal = relationSize; highVal = relationSize + 20000;
+	checkPassFail(batchScan(&index,&lowVal,GTE,&highVal,LT), 20000)
+	checkPassFail(duplicateLookup(&index,42,INTARRAYLEAFSIZE), INTARRAYLEAFSIZE + 1)
+	checkPassFail(duplicateDelete(&index,42,INTARRAYLEAFSIZE), 1)
+	checkPassFail(deleteRange(&index,0,2999), 3000)
+	checkPassFail(intScan(&index,2990,GT,3010,LTE), 11)
+	lowVal = 0; highVal = relationSize + 20000;
+	checkPassFail(index.countRange(&lowVal,GTE,&highVal,LT), relationSize + 17000)
+  }
+
+  // an existing index keeps the non-leaf layout it was built with
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	int key = relationSize + 12345;
+	RecordId rids[4];
+	checkPassFail(index.lookup(&key,rids,4), 1)
+  }
+
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, 0.1, 0, false, true);
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+  }
+}
+
+int deleteRange(BTreeIndex * index, int lowVal, int highVal)
+{
+	// collect the entries first, the scan cannot run while they are deleted
+	std::vector<RecordId> rids;
+	RecordId scanRid;
+	try
+	{
+		index->startScan(&lowVal, GTE, &highVal, LTE);
+		while(1)
+		{
+			index->scanNext(scanRid);
+			rids.push_back(scanRid);
+		}
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	index->endScan();
+
+	Page *curPage;
+	for(size_t i = 0; i < rids.size(); i++)
+	{
+		bufMgr->readPage(file1, rids[i].page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+		bufMgr->unPinPage(file1, rids[i].page_number, false);
+		index->deleteEntry(&myRec.i, rids[i]);
+	}
+
+	return rids.size();
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -584,3 +1611,117 @@ void deleteRelation()
 	{
 	}
 }
+
+// -----------------------------------------------------------------------------
+// compositeTests
+// -----------------------------------------------------------------------------
+
+void compositeTests()
+{
+  std::cout << "Create a B+ Tree index on the integer and double fields together" << std::endl;
+  std::vector<KeyColumn> columns(2);
+  columns[0].offset = offsetof(tuple,i);
+  columns[0].type = INTEGER;
+  columns[1].offset = offsetof(tuple,d);
+  columns[1].type = DOUBLE;
+  int i = 3000;
+  const void* prefix[] = {&i};
+  {
+    BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+
+	checkPassFail(prefixScan(&index,prefix,1), 1)
+	checkPassFail(prefixScan(&index,prefix,0), relationSize)
+
+	// more entries under i = 3000, on both sides of 0.0 and of the record's own d, and one under i = -5
+	double ds[] = {-2.5, 1000000.0};
+	char key[STRINGSIZE + 1];
+	const void* values[] = {&i, &ds[0]};
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	for(int k = 0; k < 2; k++)
+	{
+		values[1] = &ds[k];
+		index.makeKey(values, 2, key);
+		index.insertEntry(key, rid);
+	}
+	int negative = -5;
+	values[0] = &negative;
+	index.makeKey(values, 1, key);
+	index.insertEntry(key, rid);
+	checkPassFail(prefixScan(&index,prefix,1), 3)
+	prefix[0] = &negative;
+	checkPassFail(prefixScan(&index,prefix,1), 1)
+	prefix[0] = &i;
+
+	// whole keys, and ranges of the second column under one value of the first
+	double d = 3000.0;
+	values[0] = &i;
+	values[1] = &d;
+	index.makeKey(values, 2, key);
+	RecordId rids[8];
+	checkPassFail(index.lookup(key,rids,8), 1)
+	char lowKey[STRINGSIZE + 1], highKey[STRINGSIZE + 1];
+	double lowD = -10.0, highD = 0.0;
+	values[1] = &lowD;
+	index.makeKey(values, 2, lowKey);
+	values[1] = &highD;
+	index.makeKey(values, 2, highKey);
+	checkPassFail(batchScan(&index,lowKey,GTE,highKey,LTE), 1)
+	values[1] = &d;
+	index.makeKey(values, 2, lowKey);
+	highD = 10000000.0;
+	values[1] = &highD;
+	index.makeKey(values, 2, highKey);
+	checkPassFail(batchScan(&index,lowKey,GTE,highKey,LT), 2)
+
+	// keys of the first column alone bound every entry under them
+	int lowI = -10, highI = 0;
+	values[0] = &lowI;
+	index.makeKey(values, 1, lowKey);
+	values[0] = &highI;
+	index.makeKey(values, 1, highKey);
+	checkPassFail(batchScan(&index,lowKey,GTE,highKey,LT), 1)
+  }
+
+  // an existing index is opened over the same columns, and only over them
+  {
+    BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+	checkPassFail(prefixScan(&index,prefix,1), 3)
+  }
+  std::vector<KeyColumn> badColumns(2);
+  badColumns[0].offset = offsetof(tuple,s);
+  badColumns[0].type = STRING;
+  badColumns[1] = columns[0];
+  bool badKey = false;
+  try
+  {
+    BTreeIndex index(relationName, compositeIndexName, bufMgr, badColumns);
+  }
+  catch(BadIndexInfoException e)
+  {
+    badKey = true;
+  }
+  checkPassFail(badKey, true)
+}
+
+int prefixScan(BTreeIndex * index, const void* const* values, int numValues)
+{
+	RecordId rids[37];
+	int numResults = 0;
+	BTreeScanCursor cursor;
+	try
+	{
+		cursor = index->openPrefixScan(values, numValues);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	while(size_t n = cursor.scanNextBatch(rids, 37))
+	{
+		numResults += n;
+	}
+	return numResults;
+}
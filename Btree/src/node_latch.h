@@ -0,0 +1,150 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "types.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Version latch for optimistic lock coupling.
+ *
+ * Readers take no lock. They note the version before reading what the latch protects and check
+ * afterwards that it is unchanged, and start over if it is not. Writers set the lock bit, which also
+ * makes readers wait, and every write moves the version on. A reader that started from a version
+ * can upgrade to the lock only if nothing was written since, so a writer never acts on a stale read.
+ */
+class VersionLatch
+{
+ public:
+
+	VersionLatch() : version(0) {}
+
+  /**
+   * Version to read under. Waits while a writer holds the latch.
+   */
+	std::uint64_t readLock() const
+	{
+		std::uint64_t v;
+		while((v = version.load(std::memory_order_acquire)) & LOCKED){
+			std::this_thread::yield();
+		}
+		return v;
+	}
+
+  /**
+   * Version to read under, without waiting for a writer.
+   *
+   * @return				false if a writer holds the latch
+   */
+	bool tryReadLock(std::uint64_t& v) const
+	{
+		v = version.load(std::memory_order_acquire);
+		return !(v & LOCKED);
+	}
+
+  /**
+   * Whether nothing has been written since readLock returned v. Call after the reads it covers.
+   */
+	bool validate(const std::uint64_t v) const
+	{
+		///keeps the reads before it from moving past the version check
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return version.load(std::memory_order_relaxed) == v;
+	}
+
+  /**
+   * Take the latch if nothing has been written since readLock returned v.
+   *
+   * @return				false, without the latch, if the version has moved on
+   */
+	bool tryUpgrade(std::uint64_t v)
+	{
+		return version.compare_exchange_strong(v, v + LOCKED);
+	}
+
+  /**
+   * Take the latch if no writer holds it, without waiting.
+   *
+   * @return				false, without the latch, if a writer holds it
+   */
+	bool tryLock()
+	{
+		std::uint64_t v = version.load(std::memory_order_acquire);
+		return !(v & LOCKED) && tryUpgrade(v);
+	}
+
+  /**
+   * Take the latch, waiting for the writer holding it.
+   */
+	void lock()
+	{
+		while(!tryUpgrade(readLock())){}
+	}
+
+  /**
+   * Release the latch. The version ends up different from every version read before the write.
+   *
+   * @return				Version the latch is at after the write, until the next writer takes it
+   */
+	std::uint64_t unlock()
+	{
+		return version.fetch_add(LOCKED, std::memory_order_release) + LOCKED;
+	}
+
+  /**
+   * Whether a writer holds the latch.
+   */
+	bool isLocked() const
+	{
+		return (version.load() & LOCKED) != 0;
+	}
+
+ private:
+
+	static const std::uint64_t LOCKED = 2;
+
+	std::atomic<std::uint64_t> version;
+};
+
+/**
+ * @brief Version latches of the nodes of one index, found by page number.
+ * Node pages move in and out of the buffer pool, so their latches live here instead of in the pages.
+ * Pages whose numbers collide share a latch, which costs some needless restarts but never correctness.
+ */
+class NodeLatchTable
+{
+ public:
+
+  /**
+   * Latch of a node page.
+   */
+	VersionLatch& latch(const PageId pageNum)
+	{
+		return latches[pageNum & (NUM_LATCHES - 1)];
+	}
+
+	const VersionLatch& latch(const PageId pageNum) const
+	{
+		return latches[pageNum & (NUM_LATCHES - 1)];
+	}
+
+ private:
+
+	static const std::size_t NUM_LATCHES = 1 << 14;
+
+	VersionLatch latches[NUM_LATCHES];
+};
+
+}
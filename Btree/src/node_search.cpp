@@ -0,0 +1,134 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <climits>
+
+#include "node_search.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define NODESEARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace badgerdb
+{
+namespace nodesearch
+{
+
+/**
+ * Once the binary search has narrowed the range down to this many keys the rest is
+ * counted with vector compares. 32 ints is two cache lines.
+ */
+static const int SIMD_WINDOW = 32;
+
+// -----------------------------------------------------------------------------
+// countLess kernels -- number of keys in keys[0..n) that are less than key.
+// Since keys are sorted, this is also the lower bound position inside the window.
+// -----------------------------------------------------------------------------
+
+static int countLessScalar(const int* keys, const int n, const int key)
+{
+    int count = 0;
+    for(int i = 0; i < n; i++){
+        count += (keys[i] < key);
+    }
+    return count;
+}
+
+#ifdef NODESEARCH_X86
+
+__attribute__((target("avx2")))
+static int countLessAvx2(const int* keys, const int n, const int key)
+{
+    const __m256i keyVec = _mm256_set1_epi32(key);
+    int count = 0;
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256i data = _mm256_loadu_si256((const __m256i*)(keys + i));
+        ///lanes where key > data, ie data < key
+        __m256i less = _mm256_cmpgt_epi32(keyVec, data);
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    return count + countLessScalar(keys + i, n - i, key);
+}
+
+__attribute__((target("sse2")))
+static int countLessSse2(const int* keys, const int n, const int key)
+{
+    const __m128i keyVec = _mm_set1_epi32(key);
+    int count = 0;
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128i data = _mm_loadu_si128((const __m128i*)(keys + i));
+        __m128i less = _mm_cmpgt_epi32(keyVec, data);
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+    return count + countLessScalar(keys + i, n - i, key);
+}
+
+#endif
+
+typedef int (*CountLessFn)(const int*, const int, const int);
+
+/**
+ * Pick the widest kernel the CPU supports. Runs once during static initialization.
+ */
+static CountLessFn selectKernel(const char*& name)
+{
+#ifdef NODESEARCH_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        name = "avx2";
+        return countLessAvx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        name = "sse2";
+        return countLessSse2;
+    }
+#endif
+    name = "scalar";
+    return countLessScalar;
+}
+
+static const char* countLessName = "scalar";
+static const CountLessFn countLess = selectKernel(countLessName);
+
+// -----------------------------------------------------------------------------
+// lowerBound
+// -----------------------------------------------------------------------------
+
+int lowerBound(const int* keys, const int n, const int key)
+{
+    ///the answer always stays within [base, base + len]
+    const int* base = keys;
+    int len = n;
+    while(len > SIMD_WINDOW){
+        int half = len / 2;
+        base = (base[half - 1] < key) ? base + half : base;
+        len -= half;
+    }
+    return (int)(base - keys) + countLess(base, len, key);
+}
+
+// -----------------------------------------------------------------------------
+// upperBound
+// -----------------------------------------------------------------------------
+
+int upperBound(const int* keys, const int n, const int key)
+{
+    ///first key > key is the first key >= key + 1, nothing is greater than INT_MAX
+    if(key == INT_MAX) return n;
+    return lowerBound(keys, n, key + 1);
+}
+
+const char* kernelName()
+{
+    return countLessName;
+}
+
+}
+}
@@ -0,0 +1,236 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Key search inside a B+Tree node.
+ *
+ * All functions take the sorted, used part of a node's key array. The search for INTEGER
+ * keys narrows the range with a branch-free binary search and finishes the last few cache
+ * lines with a vectorized compare. The vector kernel (AVX2 or SSE2) is picked once, at
+ * startup, from the features of the CPU the program runs on. Keys with a block directory are
+ * searched one cache line block at a time. STRING key bytes are compared eight at a time as
+ * big-endian words.
+ */
+namespace nodesearch
+{
+
+/**
+ * Position of the first key that is not less than the search key.
+ *
+ * @param keys		Sorted keys of the node
+ * @param n				Number of keys in use
+ * @param key			Search key
+ * @return				Index in [0, n]. n if every key is less than the search key.
+ */
+int lowerBound(const int* keys, const int n, const int key);
+
+/**
+ * Position of the first key that is greater than the search key.
+ *
+ * @param keys		Sorted keys of the node
+ * @param n				Number of keys in use
+ * @param key			Search key
+ * @return				Index in [0, n]. n if no key is greater than the search key.
+ */
+int upperBound(const int* keys, const int n, const int key);
+
+/**
+ * Branch-free binary search without the vector kernel. Used for key types without a vector
+ * kernel, on CPUs without SIMD support, and as the reference the vectorized search must agree with.
+ *
+ * @param keys		Sorted keys of the node
+ * @param n				Number of keys in use
+ * @param key			Search key
+ * @return				Index in [0, n] of the first key not less than the search key.
+ */
+template <class T>
+inline int lowerBoundScalar(const T* keys, const int n, const T& key)
+{
+	if(n <= 0) return 0;
+
+	///halve the range every step, the compare result only picks the base so there is no branch to mispredict
+	const T* base = keys;
+	int len = n;
+	while(len > 1){
+		int half = len / 2;
+		base = (base[half] < key) ? base + half : base;
+		len -= half;
+	}
+	return (int)(base - keys) + (*base < key);
+}
+
+/**
+ * Branch-free binary search for the first key greater than the search key.
+ *
+ * @param keys		Sorted keys of the node
+ * @param n				Number of keys in use
+ * @param key			Search key
+ * @return				Index in [0, n] of the first key greater than the search key.
+ */
+template <class T>
+inline int upperBoundScalar(const T* keys, const int n, const T& key)
+{
+	if(n <= 0) return 0;
+
+	const T* base = keys;
+	int len = n;
+	while(len > 1){
+		int half = len / 2;
+		base = (key < base[half]) ? base : base + half;
+		len -= half;
+	}
+	return (int)(base - keys) + !(key < *base);
+}
+
+/**
+ * DOUBLE keys have no vector kernel, they use the branch-free binary search.
+ */
+inline int lowerBound(const double* keys, const int n, const double key)
+{
+	return lowerBoundScalar(keys, n, key);
+}
+
+inline int upperBound(const double* keys, const int n, const double key)
+{
+	return upperBoundScalar(keys, n, key);
+}
+
+/**
+ * Write the block directory of keys: the last key of every block of blockSize keys.
+ *
+ * @param keys				Sorted keys of the node
+ * @param n						Number of keys in use
+ * @param blockSize		Keys per block
+ * @param directory		Room for (n + blockSize - 1) / blockSize keys
+ */
+template <class T>
+inline void buildDirectory(const T* keys, const int n, const int blockSize, T* directory)
+{
+	int blocks = (n + blockSize - 1) / blockSize;
+	for(int b = 0; b < blocks; b++){
+		int last = (b + 1) * blockSize < n ? (b + 1) * blockSize : n;
+		directory[b] = keys[last - 1];
+	}
+}
+
+/**
+ * lowerBound through a block directory written by buildDirectory. The directory picks the block and
+ * only that block of keys is searched. The position found is checked against the keys on either side
+ * of it, so a directory that is out of date costs a search of all the keys but never a wrong answer.
+ *
+ * @param keys				Sorted keys of the node
+ * @param n						Number of keys in use
+ * @param directory		Block directory of the keys
+ * @param blockSize		Keys per block
+ * @param key					Search key
+ * @return						Index in [0, n] of the first key not less than the search key.
+ */
+template <class T>
+inline int blockedLowerBound(const T* keys, const int n, const T* directory, const int blockSize, const T& key)
+{
+	int blocks = (n + blockSize - 1) / blockSize;
+	int b = lowerBound(directory, blocks, key);
+	int i = n;
+	if(b < blocks){
+		int start = b * blockSize;
+		i = start + lowerBound(keys + start, n - start < blockSize ? n - start : blockSize, key);
+	}
+	if((i == n || !(keys[i] < key)) && (i == 0 || keys[i - 1] < key)) return i;
+	return lowerBound(keys, n, key);
+}
+
+/**
+ * upperBound through a block directory written by buildDirectory, checked like blockedLowerBound.
+ *
+ * @return						Index in [0, n] of the first key greater than the search key.
+ */
+template <class T>
+inline int blockedUpperBound(const T* keys, const int n, const T* directory, const int blockSize, const T& key)
+{
+	int blocks = (n + blockSize - 1) / blockSize;
+	int b = upperBound(directory, blocks, key);
+	int i = n;
+	if(b < blocks){
+		int start = b * blockSize;
+		i = start + upperBound(keys + start, n - start < blockSize ? n - start : blockSize, key);
+	}
+	if((i == n || key < keys[i]) && (i == 0 || !(key < keys[i - 1]))) return i;
+	return upperBound(keys, n, key);
+}
+
+/**
+ * Big-endian value of 8 key bytes. Unsigned compares of these values order the bytes like memcmp.
+ */
+inline std::uint64_t loadWord(const unsigned char* bytes)
+{
+	std::uint64_t word;
+	memcpy(&word, bytes, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+/**
+ * memcmp for key bytes, eight bytes per compare.
+ *
+ * @return				Negative, zero or positive as a is less than, equal to or greater than b
+ */
+inline int compareBytes(const unsigned char* a, const unsigned char* b, const int len)
+{
+	int i = 0;
+	for(; i + 8 <= len; i += 8){
+		std::uint64_t x = loadWord(a + i);
+		std::uint64_t y = loadWord(b + i);
+		if(x != y) return x < y ? -1 : 1;
+	}
+	for(; i < len; i++){
+		if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * Number of leading bytes a and b have in common.
+ */
+inline int commonPrefix(const unsigned char* a, const unsigned char* b, const int len)
+{
+	int i = 0;
+	for(; i + 8 <= len; i += 8){
+		std::uint64_t diff = loadWord(a + i) ^ loadWord(b + i);
+		///the first differing byte is the highest set byte of the big-endian difference
+		if(diff != 0) return i + __builtin_clzll(diff) / 8;
+	}
+	while(i < len && a[i] == b[i]) i++;
+	return i;
+}
+
+/**
+ * Length of a zero-padded key without its padding.
+ */
+inline int significantLength(const unsigned char* bytes, int len)
+{
+	while(len > 0 && bytes[len - 1] == 0) len--;
+	return len;
+}
+
+/**
+ * Name of the search kernel chosen for this CPU: "avx2", "sse2" or "scalar".
+ */
+const char* kernelName();
+
+}
+
+}
@@ -0,0 +1,281 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "packed_leaf.h"
+
+namespace badgerdb
+{
+namespace packedleaf
+{
+
+///every field is read with an 8-byte load, which may run past the last byte in use
+static const int LOADSLACK = sizeof(std::uint64_t);
+
+///data bytes a leaf may fill
+static const int CAPACITY = PACKEDLEAFDATASIZE - LOADSLACK;
+
+// -----------------------------------------------------------------------------
+// Layout
+// -----------------------------------------------------------------------------
+
+static int bitsFor(std::uint32_t range)
+{
+    int bits = 0;
+    while(range != 0){
+        bits++;
+        range >>= 1;
+    }
+    return bits;
+}
+
+static size_t sectionBytes(const size_t n, const int bits)
+{
+    return (n * bits + 7) / 8;
+}
+
+static std::uint32_t fieldMask(const int bits)
+{
+    return (std::uint32_t)((std::uint64_t(1) << bits) - 1);
+}
+
+static size_t layoutBytes(const size_t n, const int keyBits, const int pageBits, const int slotBits)
+{
+    return sectionBytes(n, keyBits) + sectionBytes(n, pageBits) + sectionBytes(n, slotBits);
+}
+
+/**
+ * Smallest and largest page and slot numbers of a run of entries, widened one entry at a time.
+ */
+struct RidRange
+{
+    PageId minPage, maxPage;
+    SlotId minSlot, maxSlot;
+
+    explicit RidRange(const RecordId& rid)
+        : minPage(rid.page_number), maxPage(rid.page_number), minSlot(rid.slot_number), maxSlot(rid.slot_number) {}
+
+    void add(const RecordId& rid)
+    {
+        minPage = std::min(minPage, rid.page_number);
+        maxPage = std::max(maxPage, rid.page_number);
+        minSlot = std::min(minSlot, rid.slot_number);
+        maxSlot = std::max(maxSlot, rid.slot_number);
+    }
+};
+
+static size_t runBytes(const RIDKeyPair<int>& first, const RIDKeyPair<int>& last, const RidRange& rids, const size_t n)
+{
+    return layoutBytes(n, bitsFor((std::uint32_t)((std::int64_t)last.key - first.key)),
+                       bitsFor(rids.maxPage - rids.minPage), bitsFor(rids.maxSlot - rids.minSlot));
+}
+
+static bool bytesFit(const size_t bytes, const double fill)
+{
+    return bytes <= (size_t)std::max(0, std::min((int)(CAPACITY * fill), CAPACITY));
+}
+
+// -----------------------------------------------------------------------------
+// Bit fields
+// -----------------------------------------------------------------------------
+
+static std::uint32_t readField(const unsigned char* section, const size_t i, const int bits, const std::uint32_t mask)
+{
+    size_t bit = i * bits;
+    std::uint64_t word;
+    memcpy(&word, section + bit / 8, sizeof(word));
+    return (std::uint32_t)(word >> (bit % 8)) & mask;
+}
+
+static void writeField(unsigned char* section, const size_t i, const int bits, const std::uint32_t value)
+{
+    size_t bit = i * bits;
+    std::uint64_t word;
+    memcpy(&word, section + bit / 8, sizeof(word));
+    word |= (std::uint64_t)value << (bit % 8);
+    memcpy(section + bit / 8, &word, sizeof(word));
+}
+
+static const unsigned char* pageSection(const PackedLeafNode* node)
+{
+    return node->data + sectionBytes(node->header.keyCount, node->keyBits);
+}
+
+static const unsigned char* slotSection(const PackedLeafNode* node)
+{
+    return pageSection(node) + sectionBytes(node->header.keyCount, node->pageBits);
+}
+
+// -----------------------------------------------------------------------------
+// Leaves
+// -----------------------------------------------------------------------------
+
+bool fits(const RIDKeyPair<int>* entries, const size_t n, const double fill)
+{
+    if(n == 0) return true;
+    RidRange rids(entries[0].rid);
+    for(size_t i = 1; i < n; i++) rids.add(entries[i].rid);
+    return bytesFit(runBytes(entries[0], entries[n - 1], rids, n), fill);
+}
+
+void encodeLeaf(PackedLeafNode* node, const RIDKeyPair<int>* entries, const int n)
+{
+    node->header.nodeType = PACKED_LEAF_NODE;
+    node->header.level = 0;
+    node->header.keyCount = n;
+    memset(node->data, 0, sizeof(node->data));
+    if(n == 0){
+        node->keyBase = 0;
+        node->pageBase = 0;
+        node->slotBase = 0;
+        node->keyBits = node->pageBits = node->slotBits = 0;
+        return;
+    }
+
+    RidRange rids(entries[0].rid);
+    for(int i = 1; i < n; i++) rids.add(entries[i].rid);
+    node->keyBase = entries[0].key;
+    node->pageBase = rids.minPage;
+    node->slotBase = rids.minSlot;
+    node->keyBits = bitsFor((std::uint32_t)((std::int64_t)entries[n - 1].key - entries[0].key));
+    node->pageBits = bitsFor(rids.maxPage - rids.minPage);
+    node->slotBits = bitsFor(rids.maxSlot - rids.minSlot);
+
+    unsigned char* pages = node->data + sectionBytes(n, node->keyBits);
+    unsigned char* slots = pages + sectionBytes(n, node->pageBits);
+    for(int i = 0; i < n; i++){
+        writeField(node->data, i, node->keyBits, (std::uint32_t)((std::int64_t)entries[i].key - node->keyBase));
+        writeField(pages, i, node->pageBits, entries[i].rid.page_number - node->pageBase);
+        writeField(slots, i, node->slotBits, entries[i].rid.slot_number - node->slotBase);
+    }
+}
+
+void decodeLeaf(const PackedLeafNode* node, std::vector<RIDKeyPair<int> >& entries)
+{
+    size_t start = entries.size();
+    int n = node->header.keyCount;
+    entries.resize(start + n);
+    std::vector<int> keys(n);
+    std::vector<RecordId> rids(n);
+    leafKeys(node, 0, n, keys.data());
+    leafRids(node, 0, n, rids.data());
+    for(int i = 0; i < n; i++) entries[start + i].set(rids[i], keys[i]);
+}
+
+int leafKey(const PackedLeafNode* node, const int i)
+{
+    return (int)((std::uint32_t)node->keyBase + readField(node->data, i, node->keyBits, fieldMask(node->keyBits)));
+}
+
+RecordId leafRid(const PackedLeafNode* node, const int i)
+{
+    RecordId rid;
+    rid.page_number = node->pageBase + readField(pageSection(node), i, node->pageBits, fieldMask(node->pageBits));
+    rid.slot_number = (SlotId)(node->slotBase + readField(slotSection(node), i, node->slotBits, fieldMask(node->slotBits)));
+    return rid;
+}
+
+void leafKeys(const PackedLeafNode* node, const int first, const int last, int* out)
+{
+    const std::uint32_t base = (std::uint32_t)node->keyBase;
+    const int bits = node->keyBits;
+    const std::uint32_t mask = fieldMask(bits);
+    for(int i = first; i < last; i++){
+        out[i - first] = (int)(base + readField(node->data, i, bits, mask));
+    }
+}
+
+void leafRids(const PackedLeafNode* node, const int first, const int last, RecordId* out)
+{
+    const unsigned char* pages = pageSection(node);
+    const unsigned char* slots = slotSection(node);
+    const std::uint32_t pageMask = fieldMask(node->pageBits);
+    const std::uint32_t slotMask = fieldMask(node->slotBits);
+    for(int i = first; i < last; i++){
+        out[i - first].page_number = node->pageBase + readField(pages, i, node->pageBits, pageMask);
+        out[i - first].slot_number = (SlotId)(node->slotBase + readField(slots, i, node->slotBits, slotMask));
+    }
+}
+
+/**
+ * Position of the first entry whose key offset is not less than target, or greater than it if
+ * after is set.
+ */
+static int searchOffsets(const PackedLeafNode* node, const std::uint32_t target, const bool after)
+{
+    const int bits = node->keyBits;
+    const std::uint32_t mask = fieldMask(bits);
+    int low = 0;
+    int high = node->header.keyCount;
+    while(low < high){
+        int mid = low + (high - low) / 2;
+        std::uint32_t offset = readField(node->data, mid, bits, mask);
+        if(offset < target || (after && offset == target)) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+int leafLowerBound(const PackedLeafNode* node, const int key)
+{
+    if(node->header.keyCount == 0 || key <= node->keyBase) return 0;
+    return searchOffsets(node, (std::uint32_t)((std::int64_t)key - node->keyBase), false);
+}
+
+int leafUpperBound(const PackedLeafNode* node, const int key)
+{
+    if(node->header.keyCount == 0 || key < node->keyBase) return 0;
+    return searchOffsets(node, (std::uint32_t)((std::int64_t)key - node->keyBase), true);
+}
+
+int leafUsedBytes(const PackedLeafNode* node)
+{
+    return (int)layoutBytes(node->header.keyCount, node->keyBits, node->pageBits, node->slotBits);
+}
+
+void leafPieces(const RIDKeyPair<int>* entries, const size_t n, const double fill, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+    if(n == 0){
+        sizes.push_back(0);
+        return;
+    }
+
+    ///take as many entries as fit in each leaf. Adding an entry can only widen the fields, so the
+    ///first entry that does not fit ends the leaf
+    size_t start = 0;
+    while(start < n){
+        RidRange rids(entries[start].rid);
+        size_t end = start + 1;
+        while(end < n){
+            RidRange wider = rids;
+            wider.add(entries[end].rid);
+            if(!bytesFit(runBytes(entries[start], entries[end], wider, end + 1 - start), fill)) break;
+            rids = wider;
+            end++;
+        }
+        sizes.push_back(end - start);
+        start = end;
+    }
+
+    ///the greedy cut leaves the last leaf short. Use the same number of even leaves if they all fit
+    size_t numLeaves = sizes.size();
+    if(numLeaves == 1) return;
+    std::vector<size_t> even(numLeaves);
+    start = 0;
+    for(size_t leaf = 0; leaf < numLeaves; leaf++){
+        even[leaf] = n / numLeaves + (leaf < n % numLeaves ? 1 : 0);
+        if(!fits(entries + start, even[leaf], fill)) return;
+        start += even[leaf];
+    }
+    sizes.swap(even);
+}
+
+}
+}
@@ -0,0 +1,90 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Layout of packed INTEGER leaf pages.
+ *
+ * A packed leaf stores every key, page number and slot number as its offset from the smallest one in
+ * the leaf, bit-packed at a width chosen for that leaf (frame of reference). The widths are fixed
+ * within a leaf, so entry i is found without decoding the ones before it and lookups binary search
+ * the packed keys directly. Every field is read with one unaligned 64-bit load, a shift and a mask,
+ * with no branches, so the bulk unpack loops used by scans vectorize. Changes decode the leaf into
+ * entries and encode it again, possibly as several leaves.
+ */
+namespace packedleaf
+{
+
+/**
+ * Whether sorted entries fit into one leaf with at most fill times its data bytes in use.
+ */
+bool fits(const RIDKeyPair<int>* entries, const size_t n, const double fill);
+
+/**
+ * Write sorted entries into a leaf, choosing its bases and bit widths. Sets the node type, level and
+ * key count. The siblings are left alone. The entries must fit.
+ */
+void encodeLeaf(PackedLeafNode* node, const RIDKeyPair<int>* entries, const int n);
+
+/**
+ * Append the entries of a leaf to entries.
+ */
+void decodeLeaf(const PackedLeafNode* node, std::vector<RIDKeyPair<int> >& entries);
+
+/**
+ * Key of entry i of a leaf.
+ */
+int leafKey(const PackedLeafNode* node, const int i);
+
+/**
+ * RecordId of entry i of a leaf.
+ */
+RecordId leafRid(const PackedLeafNode* node, const int i);
+
+/**
+ * Unpack the keys of entries first to last - 1 of a leaf into out.
+ */
+void leafKeys(const PackedLeafNode* node, const int first, const int last, int* out);
+
+/**
+ * Unpack the record ids of entries first to last - 1 of a leaf into out.
+ */
+void leafRids(const PackedLeafNode* node, const int first, const int last, RecordId* out);
+
+/**
+ * Position of the first entry of a leaf that is not less than key.
+ */
+int leafLowerBound(const PackedLeafNode* node, const int key);
+
+/**
+ * Position of the first entry of a leaf that is greater than key.
+ */
+int leafUpperBound(const PackedLeafNode* node, const int key);
+
+/**
+ * Bytes of the data area of a leaf in use.
+ */
+int leafUsedBytes(const PackedLeafNode* node);
+
+/**
+ * Cut sorted entries into pieces that each fit into one leaf with at most fill times its data bytes
+ * in use, then even the pieces out so the last one is not left nearly empty.
+ *
+ * @param sizes		Set to the number of entries of every piece, in order
+ */
+void leafPieces(const RIDKeyPair<int>* entries, const size_t n, const double fill, std::vector<size_t>& sizes);
+
+}
+}
@@ -0,0 +1,81 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "posting_list.h"
+
+namespace badgerdb
+{
+namespace postinglist
+{
+
+static inline int varintBytes(std::uint64_t value)
+{
+    int bytes = 1;
+    while(value >= 0x80){
+        value >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+static inline std::uint64_t ridValue(const RecordId& rid)
+{
+    return ((std::uint64_t)rid.page_number << 16) | rid.slot_number;
+}
+
+int encode(PostingNode* node, const RecordId* rids, const int n)
+{
+    unsigned char* out = node->data;
+    unsigned char* end = node->data + POSTINGDATASIZE;
+    std::uint64_t prev = 0;
+    int i = 0;
+    while(i < n){
+        std::uint64_t value = ridValue(rids[i]);
+        std::uint64_t delta = value - prev;
+        if(end - out < varintBytes(delta)) break;
+        while(delta >= 0x80){
+            *out++ = (unsigned char)(delta | 0x80);
+            delta >>= 7;
+        }
+        *out++ = (unsigned char)delta;
+        prev = value;
+        i++;
+    }
+    node->header.nodeType = POSTING_NODE;
+    node->header.level = 0;
+    node->header.keyCount = i;
+    node->usedBytes = (std::uint32_t)(out - node->data);
+    return i;
+}
+
+void decode(const PostingNode* node, std::vector<RecordId>& rids)
+{
+    const unsigned char* in = node->data;
+    ///bounded by the page so that a page freed under a thread-safe reader cannot run it off the end
+    const unsigned char* end = node->data + std::min(node->usedBytes, (std::uint32_t)POSTINGDATASIZE);
+    std::uint64_t value = 0;
+    for(int i = 0; i < node->header.keyCount && in < end; i++){
+        std::uint64_t delta = 0;
+        int shift = 0;
+        while(in + 1 < end && (*in & 0x80)){
+            delta |= (std::uint64_t)(*in++ & 0x7f) << shift;
+            shift += 7;
+        }
+        delta |= (std::uint64_t)*in++ << shift;
+        value += delta;
+
+        RecordId rid;
+        rid.page_number = (PageId)(value >> 16);
+        rid.slot_number = (SlotId)(value & 0xffff);
+        rids.push_back(rid);
+    }
+}
+
+}
+}
@@ -0,0 +1,71 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Layout of posting list pages.
+ *
+ * Low-cardinality INTEGER and DOUBLE columns give leaves long runs of one key, each entry repeating
+ * the key next to its record id. Such a run can be replaced by a single leaf entry pointing to a
+ * posting list: a chain of PostingNode pages with the record ids of the key in ascending order,
+ * delta- and varint-encoded. These functions read and write the pages of a chain. Allocating,
+ * linking and freeing them is left to BTreeIndex.
+ */
+namespace postinglist
+{
+
+/**
+ * Whether a leaf entry stands for a posting list rather than a record.
+ */
+inline bool isList(const RecordId& rid)
+{
+	return rid.slot_number == Page::INVALID_SLOT;
+}
+
+/**
+ * Leaf entry record id for the posting list starting at pageNum.
+ */
+inline RecordId listRef(const PageId pageNum)
+{
+	RecordId rid;
+	rid.page_number = pageNum;
+	rid.slot_number = Page::INVALID_SLOT;
+	return rid;
+}
+
+/**
+ * Order of record ids in a posting list.
+ */
+inline bool ridLess(const RecordId& a, const RecordId& b)
+{
+	return a.page_number < b.page_number || (a.page_number == b.page_number && a.slot_number < b.slot_number);
+}
+
+/**
+ * Write as many of the sorted record ids as fit into one page. Sets the node type, key count and
+ * bytes used. The next page and total count are left alone.
+ *
+ * @return				Number of record ids written, at least one if n > 0
+ */
+int encode(PostingNode* node, const RecordId* rids, const int n);
+
+/**
+ * Append the record ids of a page to rids.
+ */
+void decode(const PostingNode* node, std::vector<RecordId>& rids);
+
+}
+
+}
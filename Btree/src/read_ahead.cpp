@@ -0,0 +1,102 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstddef>
+
+#include "read_ahead.h"
+#include "btree.h"
+#include "exceptions/badgerdb_exception.h"
+
+namespace badgerdb
+{
+
+/**
+ * Requests waiting for the worker. A scan re-requests its window every few leaves, so older
+ * requests are mostly covered by newer ones by the time this many are queued.
+ */
+static const size_t MAX_PENDING_REQUESTS = 8;
+
+///the worker follows siblings without knowing the key type of the index
+static_assert(offsetof(LeafNodeInt, rightSibPageNo) == offsetof(LeafNodeDouble, rightSibPageNo), "leaf sibling pointers must line up");
+static_assert(offsetof(LeafNodeInt, rightSibPageNo) == offsetof(StringLeafNode, rightSibPageNo), "leaf sibling pointers must line up");
+
+ReadAhead::ReadAhead(BufMgr* bufMgr, File* file, const VersionLatch& treeLatch, const NodeLatchTable& nodeLatches)
+    : bufMgr(bufMgr), file(file), treeLatch(treeLatch), nodeLatches(nodeLatches), stopping(false)
+{
+    worker = std::thread(&ReadAhead::run, this);
+}
+
+ReadAhead::~ReadAhead()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        requests.clear();
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void ReadAhead::request(const PageId pageNum, const int numPages)
+{
+    if(pageNum == 0 || numPages <= 0) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(requests.size() >= MAX_PENDING_REQUESTS) requests.pop_front();
+        Request r;
+        r.pageNum = pageNum;
+        r.numPages = numPages;
+        requests.push_back(r);
+    }
+    wake.notify_one();
+}
+
+void ReadAhead::run()
+{
+    while(1){
+        Request r;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]{ return stopping || !requests.empty(); });
+            if(stopping) return;
+            r = requests.front();
+            requests.pop_front();
+        }
+        
+        PageId pageNum = r.pageNum;
+        try{
+            for(int i = 0; i < r.numPages && pageNum != 0; i++){
+                ///a writer is changing the tree, its leaves may be split or freed under the worker
+                std::uint64_t treeVersion, version;
+                if(!treeLatch.tryReadLock(treeVersion)) break;
+                Page* page;
+                bufMgr->readPage(file, pageNum, page);
+                const VersionLatch& latch = nodeLatches.latch(pageNum);
+                PageId nextPageNum = 0;
+                if(latch.tryReadLock(version)){
+                    const LeafNodeInt* leaf = (const LeafNodeInt*)page;
+                    ///the leaf may have been freed and reused since the scan saw its page number
+                    std::int16_t nodeType = __atomic_load_n(&leaf->header.nodeType, __ATOMIC_RELAXED);
+                    if(nodeType == LEAF_NODE || nodeType == PACKED_LEAF_NODE){
+                        nextPageNum = __atomic_load_n(&leaf->rightSibPageNo, __ATOMIC_RELAXED);
+                    }
+                    if(!latch.validate(version) || !treeLatch.validate(treeVersion)) nextPageNum = 0;
+                }
+                bufMgr->unPinPage(file, pageNum, false);
+                pageNum = nextPageNum;
+                
+                ///the index is closing, stop between pages
+                std::lock_guard<std::mutex> guard(lock);
+                if(stopping) return;
+            }
+        }catch(BadgerDbException e){
+            ///no free frame, or a page past the end of the file. Nothing to read ahead then
+        }
+    }
+}
+
+}
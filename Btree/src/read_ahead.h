@@ -0,0 +1,95 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "buffer.h"
+#include "node_latch.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Background reads of the leaves a range scan is about to reach.
+ *
+ * A request names a leaf and a number of leaves. A worker thread reads that leaf into the buffer pool,
+ * follows its rightSibPageNo to the next one, and so on, unpinning each page as soon as it has the
+ * sibling pointer. The scan then finds the pages resident when it gets there. Pages already in the pool
+ * cost one hash lookup. Read-ahead is only ever a saving, so errors such as a pool with every frame
+ * pinned end a request quietly.
+ *
+ * Other threads may be changing the leaves while the worker reads them. The worker reads the node type
+ * and the sibling pointer of a leaf under the version latches of the tree and of the leaf, the way
+ * thread-safe readers do, and ends the request instead of waiting if a writer holds either or a write
+ * happened during the read.
+ */
+class ReadAhead
+{
+ public:
+
+  /**
+   * Start the worker thread.
+   *
+   * @param bufMgr		Buffer manager the leaves are read into
+   * @param file			Index file
+   * @param treeLatch		Latch every write to the index that is not covered by node latches takes
+   * @param nodeLatches	Version latches of the nodes of the index
+   */
+	ReadAhead(BufMgr* bufMgr, File* file, const VersionLatch& treeLatch, const NodeLatchTable& nodeLatches);
+
+  /**
+   * Drop pending requests, stop the worker and wait for it. No page is pinned by it afterwards.
+   */
+	~ReadAhead();
+
+  /**
+   * Queue reads of numPages leaves, starting with pageNum and following right siblings. Returns at once.
+   * When requests come faster than the worker reads, the oldest pending ones are dropped.
+   */
+	void request(const PageId pageNum, const int numPages);
+
+ private:
+
+	struct Request
+	{
+		PageId pageNum;
+		int numPages;
+	};
+
+  /**
+   * Worker loop, runs requests until stopping is set.
+   */
+	void run();
+
+	BufMgr* bufMgr;
+
+	File* file;
+
+	const VersionLatch& treeLatch;
+
+	const NodeLatchTable& nodeLatches;
+
+	std::mutex lock;
+
+	std::condition_variable wake;
+
+  /**
+   * Requests not yet started, oldest first.
+   */
+	std::deque<Request> requests;
+
+	bool stopping;
+
+	std::thread worker;
+};
+
+}
@@ -0,0 +1,429 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "string_node.h"
+#include "node_search.h"
+
+namespace badgerdb
+{
+namespace stringnode
+{
+
+static const int RIDSIZE = sizeof(RecordId);
+
+// -----------------------------------------------------------------------------
+// Layout
+// -----------------------------------------------------------------------------
+
+int leafCapacity(const int slotWidth)
+{
+    return STRINGNODEDATASIZE / (RIDSIZE + slotWidth);
+}
+
+int nonLeafCapacity(const int slotWidth)
+{
+    ///one more child, and count, than separators
+    const int childSize = (int)(sizeof(PageId) + sizeof(std::uint32_t));
+    return (STRINGNODEDATASIZE - childSize) / (childSize + slotWidth);
+}
+
+/**
+ * Prefix and slot width for a node holding sorted keys from first to last, the longest of them
+ * maxLen bytes without padding. Every key in between shares the prefix of first and last.
+ */
+static void chooseLayout(const StringKey& first, const StringKey& last, const int maxLen, int& prefixLen, int& slotWidth)
+{
+    prefixLen = nodesearch::commonPrefix(first.bytes, last.bytes, STRINGSIZE);
+    slotWidth = std::max(0, maxLen - prefixLen);
+}
+
+static int keyLength(const StringKey& key)
+{
+    return nodesearch::significantLength(key.bytes, STRINGSIZE);
+}
+
+/**
+ * Number of keys to place in a node of the given capacity, same rounding as BTreeIndex::nodeFill.
+ */
+static int fillLimit(const int capacity, const double fill)
+{
+    return std::max(1, std::min((int)(capacity * fill), capacity));
+}
+
+StringKey separator(const StringKey& left, const StringKey& right)
+{
+    StringKey sep = right;
+    int keep = nodesearch::commonPrefix(left.bytes, right.bytes, STRINGSIZE) + 1;
+    if(keep < STRINGSIZE){
+        memset(sep.bytes + keep, 0, STRINGSIZE - keep);
+    }
+    return sep;
+}
+
+// -----------------------------------------------------------------------------
+// Search
+// -----------------------------------------------------------------------------
+
+/**
+ * Binary search over compressed slots.
+ *
+ * @param slots		First key byte of slot 0
+ * @param stride		Distance between two slots
+ * @param upper		Whether to skip slots equal to the key, ie upper instead of lower bound
+ */
+static int slotSearch(const unsigned char* prefix, const int prefixLen, const unsigned char* slots,
+                      const int stride, const int slotWidth, const int n, const unsigned char* key, const bool upper)
+{
+    ///a key outside the prefix is below or above every slot
+    int c = nodesearch::compareBytes(key, prefix, prefixLen);
+    if(c < 0) return 0;
+    if(c > 0) return n;
+
+    const unsigned char* rest = key + prefixLen;
+    ///slots are zero-padded, so a key with more bytes than the slot is greater than a slot it matches
+    int tailLen = STRINGSIZE - prefixLen - slotWidth;
+    bool longer = nodesearch::significantLength(rest + slotWidth, tailLen) > 0;
+    bool skipEqual = upper || longer;
+
+    int base = 0;
+    int len = n;
+    while(len > 0){
+        int half = len / 2;
+        int cmp = nodesearch::compareBytes(slots + (base + half) * stride, rest, slotWidth);
+        if(cmp < 0 || (cmp == 0 && skipEqual)){
+            base += half + 1;
+            len -= half + 1;
+        }else len = half;
+    }
+    return base;
+}
+
+/**
+ * Compare a stored key with a full key.
+ */
+static int compareStored(const unsigned char* prefix, const int prefixLen, const unsigned char* slot,
+                         const int slotWidth, const unsigned char* key)
+{
+    int c = nodesearch::compareBytes(prefix, key, prefixLen);
+    if(c != 0) return c;
+    c = nodesearch::compareBytes(slot, key + prefixLen, slotWidth);
+    if(c != 0) return c;
+    int tailLen = STRINGSIZE - prefixLen - slotWidth;
+    return nodesearch::significantLength(key + prefixLen + slotWidth, tailLen) > 0 ? -1 : 0;
+}
+
+static void expandKey(const unsigned char* prefix, const int prefixLen, const unsigned char* slot,
+                      const int slotWidth, StringKey& key)
+{
+    memcpy(key.bytes, prefix, prefixLen);
+    memcpy(key.bytes + prefixLen, slot, slotWidth);
+    memset(key.bytes + prefixLen + slotWidth, 0, STRINGSIZE - prefixLen - slotWidth);
+}
+
+// -----------------------------------------------------------------------------
+// Leaf
+// -----------------------------------------------------------------------------
+
+static inline unsigned char* leafEntry(StringLeafNode* node, const int i)
+{
+    return node->slots + i * (RIDSIZE + node->slotWidth);
+}
+
+static inline const unsigned char* leafEntry(const StringLeafNode* node, const int i)
+{
+    return node->slots + i * (RIDSIZE + node->slotWidth);
+}
+
+void encodeLeaf(StringLeafNode* node, const RIDKeyPair<StringKey>* entries, const int n)
+{
+    int prefixLen = 0;
+    int slotWidth = 0;
+    if(n > 0){
+        int maxLen = 0;
+        for(int i = 0; i < n; i++){
+            maxLen = std::max(maxLen, keyLength(entries[i].key));
+        }
+        chooseLayout(entries[0].key, entries[n-1].key, maxLen, prefixLen, slotWidth);
+        memcpy(node->prefix, entries[0].key.bytes, prefixLen);
+    }
+    node->header.nodeType = LEAF_NODE;
+    node->header.level = 0;
+    node->header.keyCount = n;
+    node->prefixLen = (std::uint16_t)prefixLen;
+    node->slotWidth = (std::uint16_t)slotWidth;
+
+    for(int i = 0; i < n; i++){
+        unsigned char* entry = leafEntry(node, i);
+        memcpy(entry, &entries[i].rid, RIDSIZE);
+        memcpy(entry + RIDSIZE, entries[i].key.bytes + prefixLen, slotWidth);
+    }
+}
+
+void decodeLeaf(const StringLeafNode* node, std::vector<RIDKeyPair<StringKey> >& entries)
+{
+    int n = node->header.keyCount;
+    size_t out = entries.size();
+    entries.resize(out + n);
+    for(int i = 0; i < n; i++, out++){
+        const unsigned char* entry = leafEntry(node, i);
+        memcpy(&entries[out].rid, entry, RIDSIZE);
+        expandKey(node->prefix, node->prefixLen, entry + RIDSIZE, node->slotWidth, entries[out].key);
+    }
+}
+
+void leafKey(const StringLeafNode* node, const int i, StringKey& key)
+{
+    expandKey(node->prefix, node->prefixLen, leafEntry(node, i) + RIDSIZE, node->slotWidth, key);
+}
+
+RecordId leafRid(const StringLeafNode* node, const int i)
+{
+    RecordId rid;
+    memcpy(&rid, leafEntry(node, i), RIDSIZE);
+    return rid;
+}
+
+int compareLeafKey(const StringLeafNode* node, const int i, const unsigned char* key)
+{
+    return compareStored(node->prefix, node->prefixLen, leafEntry(node, i) + RIDSIZE, node->slotWidth, key);
+}
+
+int leafLowerBound(const StringLeafNode* node, const StringKey& key)
+{
+    return slotSearch(node->prefix, node->prefixLen, node->slots + RIDSIZE, RIDSIZE + node->slotWidth,
+                      node->slotWidth, node->header.keyCount, key.bytes, false);
+}
+
+int leafUpperBound(const StringLeafNode* node, const StringKey& key)
+{
+    return slotSearch(node->prefix, node->prefixLen, node->slots + RIDSIZE, RIDSIZE + node->slotWidth,
+                      node->slotWidth, node->header.keyCount, key.bytes, true);
+}
+
+bool leafInsert(StringLeafNode* node, const RIDKeyPair<StringKey>& entry)
+{
+    int n = node->header.keyCount;
+    int prefixLen = node->prefixLen;
+    int slotWidth = node->slotWidth;
+
+    ///the key has to share the prefix and fit the slot, and the leaf needs room for one more slot
+    if(n == 0 || n + 1 > leafCapacity(slotWidth)) return false;
+    if(nodesearch::compareBytes(entry.key.bytes, node->prefix, prefixLen) != 0) return false;
+    if(keyLength(entry.key) > prefixLen + slotWidth) return false;
+
+    int pos = leafUpperBound(node, entry.key);
+    int stride = RIDSIZE + slotWidth;
+    memmove(leafEntry(node, pos + 1), leafEntry(node, pos), (n - pos) * stride);
+    unsigned char* slot = leafEntry(node, pos);
+    memcpy(slot, &entry.rid, RIDSIZE);
+    memcpy(slot + RIDSIZE, entry.key.bytes + prefixLen, slotWidth);
+    node->header.keyCount = n + 1;
+    return true;
+}
+
+void leafErase(StringLeafNode* node, const int i)
+{
+    int n = node->header.keyCount;
+    int stride = RIDSIZE + node->slotWidth;
+    memmove(leafEntry(node, i), leafEntry(node, i + 1), (n - i - 1) * stride);
+    node->header.keyCount = n - 1;
+}
+
+int leafUsedBytes(const StringLeafNode* node)
+{
+    return node->header.keyCount * (RIDSIZE + node->slotWidth);
+}
+
+// -----------------------------------------------------------------------------
+// Non-leaf
+// -----------------------------------------------------------------------------
+
+static const int CHILDSIZE = sizeof(PageId) + sizeof(std::uint32_t);
+
+static inline const unsigned char* nonLeafKeys(const StringNonLeafNode* node)
+{
+    return node->slots + (node->header.keyCount + 1) * CHILDSIZE;
+}
+
+void encodeNonLeaf(StringNonLeafNode* node, const StringKey* keys, const PageId* children, const std::uint32_t* counts, const int n)
+{
+    int prefixLen = 0;
+    int slotWidth = 0;
+    if(n > 0){
+        int maxLen = 0;
+        for(int i = 0; i < n; i++){
+            maxLen = std::max(maxLen, keyLength(keys[i]));
+        }
+        chooseLayout(keys[0], keys[n-1], maxLen, prefixLen, slotWidth);
+        memcpy(node->prefix, keys[0].bytes, prefixLen);
+    }
+    node->header.nodeType = NONLEAF_NODE;
+    node->header.keyCount = n;
+    node->prefixLen = (std::uint16_t)prefixLen;
+    node->slotWidth = (std::uint16_t)slotWidth;
+
+    memcpy(node->slots, children, (n + 1) * sizeof(PageId));
+    memcpy(childCounts(node), counts, (n + 1) * sizeof(std::uint32_t));
+    unsigned char* slot = node->slots + (n + 1) * CHILDSIZE;
+    for(int i = 0; i < n; i++, slot += slotWidth){
+        memcpy(slot, keys[i].bytes + prefixLen, slotWidth);
+    }
+}
+
+void decodeNonLeaf(const StringNonLeafNode* node, std::vector<StringKey>& keys, std::vector<PageId>& children,
+                   std::vector<std::uint32_t>& counts)
+{
+    int n = node->header.keyCount;
+    size_t out = keys.size();
+    keys.resize(out + n);
+    const unsigned char* slot = nonLeafKeys(node);
+    for(int i = 0; i < n; i++, out++, slot += node->slotWidth){
+        expandKey(node->prefix, node->prefixLen, slot, node->slotWidth, keys[out]);
+    }
+    const PageId* pageNos = (const PageId*)node->slots;
+    children.insert(children.end(), pageNos, pageNos + n + 1);
+    counts.insert(counts.end(), childCounts(node), childCounts(node) + n + 1);
+}
+
+int nonLeafUsedBytes(const StringNonLeafNode* node)
+{
+    int n = node->header.keyCount;
+    return (n + 1) * CHILDSIZE + n * node->slotWidth;
+}
+
+PageId child(const StringNonLeafNode* node, const int i)
+{
+    return ((const PageId*)node->slots)[i];
+}
+
+std::uint32_t* childCounts(StringNonLeafNode* node)
+{
+    return (std::uint32_t*)(node->slots + (node->header.keyCount + 1) * sizeof(PageId));
+}
+
+const std::uint32_t* childCounts(const StringNonLeafNode* node)
+{
+    return (const std::uint32_t*)(node->slots + (node->header.keyCount + 1) * sizeof(PageId));
+}
+
+void nonLeafKey(const StringNonLeafNode* node, const int i, StringKey& key)
+{
+    expandKey(node->prefix, node->prefixLen, nonLeafKeys(node) + i * node->slotWidth, node->slotWidth, key);
+}
+
+int nonLeafLowerBound(const StringNonLeafNode* node, const StringKey& key)
+{
+    return slotSearch(node->prefix, node->prefixLen, nonLeafKeys(node), node->slotWidth,
+                      node->slotWidth, node->header.keyCount, key.bytes, false);
+}
+
+int nonLeafUpperBound(const StringNonLeafNode* node, const StringKey& key)
+{
+    return slotSearch(node->prefix, node->prefixLen, nonLeafKeys(node), node->slotWidth,
+                      node->slotWidth, node->header.keyCount, key.bytes, true);
+}
+
+// -----------------------------------------------------------------------------
+// Splitting
+// -----------------------------------------------------------------------------
+
+/**
+ * Whether count keys from first to last, the longest maxLen bytes, fit in a node.
+ */
+static bool keysFit(const StringKey& first, const StringKey& last, const int maxLen, const size_t count,
+                    const bool leaf, const double fill)
+{
+    int prefixLen;
+    int slotWidth;
+    chooseLayout(first, last, maxLen, prefixLen, slotWidth);
+    int capacity = leaf ? leafCapacity(slotWidth) : nonLeafCapacity(slotWidth);
+    return count <= (size_t)fillLimit(capacity, fill);
+}
+
+void leafPieces(const RIDKeyPair<StringKey>* entries, const size_t n, const double fill, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+    if(n == 0){
+        sizes.push_back(0);
+        return;
+    }
+
+    ///take as many entries as fit in each leaf. Adding a key can only shorten the prefix and widen
+    ///the slots, so the first entry that does not fit ends the leaf
+    size_t start = 0;
+    while(start < n){
+        int maxLen = keyLength(entries[start].key);
+        size_t end = start + 1;
+        while(end < n){
+            int len = std::max(maxLen, keyLength(entries[end].key));
+            if(!keysFit(entries[start].key, entries[end].key, len, end + 1 - start, true, fill)) break;
+            maxLen = len;
+            end++;
+        }
+        sizes.push_back(end - start);
+        start = end;
+    }
+
+    ///the greedy cut leaves the last leaf short. Use the same number of even leaves if they all fit
+    size_t numLeaves = sizes.size();
+    if(numLeaves == 1) return;
+    std::vector<size_t> even(numLeaves);
+    start = 0;
+    for(size_t leaf = 0; leaf < numLeaves; leaf++){
+        even[leaf] = n / numLeaves + (leaf < n % numLeaves ? 1 : 0);
+        int maxLen = 0;
+        for(size_t i = start; i < start + even[leaf]; i++){
+            maxLen = std::max(maxLen, keyLength(entries[i].key));
+        }
+        if(!keysFit(entries[start].key, entries[start + even[leaf] - 1].key, maxLen, even[leaf], true, fill)) return;
+        start += even[leaf];
+    }
+    sizes.swap(even);
+}
+
+void nonLeafPieces(const StringKey* keys, const size_t numChildren, const double fill, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+
+    ///a node of children [start, end) keeps the separators keys[start .. end-2]
+    size_t start = 0;
+    while(start < numChildren){
+        int maxLen = 0;
+        size_t end = start + 1;
+        while(end < numChildren){
+            int len = std::max(maxLen, keyLength(keys[end - 1]));
+            if(!keysFit(keys[start], keys[end - 1], len, end - start, false, fill)) break;
+            maxLen = len;
+            end++;
+        }
+        sizes.push_back(end - start);
+        start = end;
+    }
+
+    size_t numNodes = sizes.size();
+    if(numNodes == 1) return;
+    std::vector<size_t> even(numNodes);
+    start = 0;
+    for(size_t node = 0; node < numNodes; node++){
+        even[node] = numChildren / numNodes + (node < numChildren % numNodes ? 1 : 0);
+        size_t numKeys = even[node] - 1;
+        if(numKeys > 0){
+            int maxLen = 0;
+            for(size_t i = start; i < start + numKeys; i++){
+                maxLen = std::max(maxLen, keyLength(keys[i]));
+            }
+            if(!keysFit(keys[start], keys[start + numKeys - 1], maxLen, numKeys, false, fill)) return;
+        }
+        start += even[node];
+    }
+    sizes.swap(even);
+}
+
+}
+}
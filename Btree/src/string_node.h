@@ -0,0 +1,172 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Layout of STRING node pages.
+ *
+ * STRING nodes do not have an array of fixed-size keys like the INTEGER and DOUBLE nodes. Every node
+ * stores the prefix its keys share once and cuts the rest of each key to a slot width chosen for that
+ * node, so how many keys fit depends on the keys. Nodes are read and written through these functions:
+ * lookups work on the compressed slots directly, and changes that do not fit the current layout decode
+ * the node into full keys and encode it again, possibly as several nodes.
+ */
+namespace stringnode
+{
+
+/**
+ * Number of entries a leaf with slots of the given width can hold.
+ */
+int leafCapacity(const int slotWidth);
+
+/**
+ * Number of separators a non-leaf node with slots of the given width can hold.
+ */
+int nonLeafCapacity(const int slotWidth);
+
+/**
+ * Shortest separator for two neighbouring nodes: the shortest prefix of right, zero-padded, that is
+ * still greater than left. Equal keys get right itself.
+ *
+ * @param left		Last key of the left node
+ * @param right		First key of the right node
+ * @return				Key sep with left < sep <= right, or sep == right if left == right
+ */
+StringKey separator(const StringKey& left, const StringKey& right);
+
+/**
+ * Write sorted entries into a leaf, choosing its prefix and slot width. Sets the node type, level and
+ * key count. The siblings are left alone.
+ */
+void encodeLeaf(StringLeafNode* node, const RIDKeyPair<StringKey>* entries, const int n);
+
+/**
+ * Append the entries of a leaf, with their full keys, to entries.
+ */
+void decodeLeaf(const StringLeafNode* node, std::vector<RIDKeyPair<StringKey> >& entries);
+
+/**
+ * Full key of entry i of a leaf.
+ */
+void leafKey(const StringLeafNode* node, const int i, StringKey& key);
+
+/**
+ * RecordId of entry i of a leaf.
+ */
+RecordId leafRid(const StringLeafNode* node, const int i);
+
+/**
+ * Compare entry i of a leaf with a full key, like memcmp.
+ *
+ * @param key			STRINGSIZE bytes of a normalized key
+ */
+int compareLeafKey(const StringLeafNode* node, const int i, const unsigned char* key);
+
+/**
+ * Position of the first entry of a leaf that is not less than key.
+ */
+int leafLowerBound(const StringLeafNode* node, const StringKey& key);
+
+/**
+ * Position of the first entry of a leaf that is greater than key.
+ */
+int leafUpperBound(const StringLeafNode* node, const StringKey& key);
+
+/**
+ * Insert an entry after any equal keys by shifting the entries behind it, if it fits the current
+ * prefix and slot width of the leaf and there is room for one more entry.
+ *
+ * @return				false, with the leaf unchanged, if the leaf has to be encoded again to take the entry
+ */
+bool leafInsert(StringLeafNode* node, const RIDKeyPair<StringKey>& entry);
+
+/**
+ * Remove entry i of a leaf. The prefix and slot width stay as they are.
+ */
+void leafErase(StringLeafNode* node, const int i);
+
+/**
+ * Bytes of the slot area of a leaf in use.
+ */
+int leafUsedBytes(const StringLeafNode* node);
+
+/**
+ * Write sorted separators and the children around them into a non-leaf node. Sets the node type
+ * and key count. The level is left alone.
+ *
+ * @param keys			n separators
+ * @param children	n + 1 child page numbers
+ * @param counts		n + 1 entry counts, one for the subtree under each child
+ */
+void encodeNonLeaf(StringNonLeafNode* node, const StringKey* keys, const PageId* children, const std::uint32_t* counts, const int n);
+
+/**
+ * Append the separators of a non-leaf node, with their full keys, its children and their entry counts
+ * to keys, children and counts.
+ */
+void decodeNonLeaf(const StringNonLeafNode* node, std::vector<StringKey>& keys, std::vector<PageId>& children,
+                   std::vector<std::uint32_t>& counts);
+
+/**
+ * Page number of child i of a non-leaf node.
+ */
+PageId child(const StringNonLeafNode* node, const int i);
+
+/**
+ * Entry counts of the subtrees under the keyCount + 1 children of a non-leaf node.
+ */
+std::uint32_t* childCounts(StringNonLeafNode* node);
+const std::uint32_t* childCounts(const StringNonLeafNode* node);
+
+/**
+ * Full key of separator i of a non-leaf node.
+ */
+void nonLeafKey(const StringNonLeafNode* node, const int i, StringKey& key);
+
+/**
+ * Bytes of the slot area of a non-leaf node in use.
+ */
+int nonLeafUsedBytes(const StringNonLeafNode* node);
+
+/**
+ * Position of the first separator of a non-leaf node that is not less than key.
+ */
+int nonLeafLowerBound(const StringNonLeafNode* node, const StringKey& key);
+
+/**
+ * Position of the first separator of a non-leaf node that is greater than key.
+ */
+int nonLeafUpperBound(const StringNonLeafNode* node, const StringKey& key);
+
+/**
+ * Cut a sorted run of entries into the fewest leaves that each take at most fill of their capacity.
+ * The run is spread evenly over those leaves when every one of them still fits.
+ *
+ * @param sizes		Number of entries of each leaf, left to right
+ */
+void leafPieces(const RIDKeyPair<StringKey>* entries, const size_t n, const double fill, std::vector<size_t>& sizes);
+
+/**
+ * Cut a sequence of children into the fewest non-leaf nodes that each take at most fill of their
+ * capacity. The separator between two of the nodes is not kept in either of them.
+ *
+ * @param keys					numChildren - 1 separators, keys[i] is between child i and child i + 1
+ * @param sizes					Number of children of each node, left to right
+ */
+void nonLeafPieces(const StringKey* keys, const size_t numChildren, const double fill, std::vector<size_t>& sizes);
+
+}
+
+}